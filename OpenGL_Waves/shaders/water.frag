@@ -0,0 +1,8 @@
+#version 330 core
+out vec4 FragColor;
+uniform sampler2D texture1;
+uniform sampler2D texture2;
+void main()
+{
+	FragColor = vec4(0.0, 0.0, 0.8, 0.2);
+}
@@ -0,0 +1,30 @@
+#version 330 core
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
+layout(location = 2) in vec2 aTexCoord;
+out vec2 TexCoord;
+const float pi = 3.14159265;
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+uniform float waveDir;
+uniform float wavelength;
+uniform float peak;
+uniform float time;
+uniform sampler2D ripples;
+uniform vec3 rippleArea;	// world x, z of the ripple grid's corner and its size
+void main()
+{
+	float a = dot(position.x, normalize(waveDir));
+	float b = peak - 1.0f;
+	float k = (2.0f * pi) / wavelength;
+	float c = sqrt(9.81f / k);
+	float wave_dx = (exp(k * b) / k) * sin(k * (a + c * time));
+	float wave_dy = -(exp(k * b) / k) * cos(k * (a + c * time));
+	vec4 displaced = model * vec4((position.x + wave_dx), (position.y + wave_dy), (position.z), 1.0f);
+	vec2 rippleCoord = (displaced.xz - rippleArea.xy) / rippleArea.z;
+	if (all(greaterThanEqual(rippleCoord, vec2(0.0))) && all(lessThanEqual(rippleCoord, vec2(1.0))))
+		displaced.y += textureLod(ripples, rippleCoord, 0.0).r;
+	gl_Position = projection * view * displaced;
+	TexCoord = vec2(aTexCoord.x, 1.0 - aTexCoord.y);
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+// Counts heap allocations made through operator new, on every thread. The replacement
+// operators live in AllocationCounter.cpp; the benchmark in main.cpp samples the count around
+// each frame to check that a steady state frame does not allocate.
+class AllocationCounter
+{
+public:
+	static unsigned long long allocations();
+	static unsigned long long bytes();
+};
+
+#endif // ALLOCATIONCOUNTER_H
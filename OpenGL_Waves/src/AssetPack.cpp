@@ -0,0 +1,324 @@
+#include "AssetPack.h"
+
+#include <cstdio>
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const unsigned int AssetPack::MAGIC;
+const unsigned int AssetPack::FORMAT_VERSION;
+
+namespace
+{
+	size_t alignUp(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	void writePadding(std::ofstream& file, size_t count)
+	{
+		static const char zeros[AssetPack::SECTION_ALIGNMENT] = {};
+		while (count > 0)
+		{
+			size_t chunk = (count < sizeof(zeros)) ? count : sizeof(zeros);
+			file.write(zeros, chunk);
+			count -= chunk;
+		}
+	}
+}
+
+AssetPack& AssetPack::instance()
+{
+	static AssetPack pack;
+	return pack;
+}
+
+unsigned long long AssetPack::checksum(const void* data, size_t size)
+{
+	// FNV-1a over 64 bit words, the byte wise version is too slow for texture sized sections
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	unsigned long long hash = 14695981039346656037ULL;
+	size_t words = size / 8;
+	for (size_t i = 0; i < words; ++i)
+	{
+		unsigned long long word;
+		memcpy(&word, bytes + i * 8, 8);
+		hash ^= word;
+		hash *= 1099511628211ULL;
+	}
+	for (size_t i = words * 8; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+bool AssetPack::open(const std::string& file, unsigned int version)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	unmap();
+	path = file;
+	contentVersion = version;
+
+	if (!map(file))
+		return false;
+
+	// anything that does not match is dropped as a whole and rebuilt on save()
+	Header header;
+	bool valid = mappedSize >= sizeof(Header);
+	if (valid)
+	{
+		memcpy(&header, mapped, sizeof(Header));
+		valid = header.Magic == MAGIC && header.FormatVersion == FORMAT_VERSION && header.ContentVersion == contentVersion
+			&& header.TocOffset + (unsigned long long)header.SectionCount * sizeof(TocEntry) <= mappedSize;
+	}
+	if (valid)
+		valid = checksum(mapped + header.TocOffset, header.SectionCount * sizeof(TocEntry)) == header.TocChecksum;
+	if (!valid)
+	{
+		std::cout << "ASSET_PACK::" << file << " is out of date, assets will be rebuilt" << std::endl;
+		unmap();
+		return false;
+	}
+
+	for (unsigned int i = 0; i < header.SectionCount; ++i)
+	{
+		TocEntry entry;
+		memcpy(&entry, mapped + header.TocOffset + i * sizeof(TocEntry), sizeof(TocEntry));
+		entry.Name[MAX_NAME_LENGTH] = '\0';
+		if (entry.Offset + entry.Size <= mappedSize)
+			toc[entry.Name] = entry;
+	}
+	return true;
+}
+
+void AssetPack::close()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	unmap();
+	pending.clear();
+}
+
+bool AssetPack::find(const std::string& name, Section& out)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	std::map<std::string, TocEntry>::const_iterator it = toc.find(name);
+	if (!readEnabled || it == toc.end())
+	{
+		misses++;
+		return false;
+	}
+
+	const TocEntry& entry = it->second;
+	if (!verified[name])
+	{
+		if (checksum(mapped + entry.Offset, (size_t)entry.Size) != entry.Checksum)
+		{
+			std::cout << "ERROR::ASSET_PACK::CHECKSUM_MISMATCH " << name << std::endl;
+			toc.erase(name);
+			misses++;
+			return false;
+		}
+		verified[name] = true;
+	}
+
+	out.Data = mapped + entry.Offset;
+	out.Size = (size_t)entry.Size;
+	memcpy(out.Info, entry.Info, INFO_BYTES);
+	hits++;
+	return true;
+}
+
+void AssetPack::add(const std::string& name, const void* data, size_t size, const void* info, size_t infoSize)
+{
+	if (name.size() > MAX_NAME_LENGTH || infoSize > INFO_BYTES)
+	{
+		std::cout << "ERROR::ASSET_PACK::SECTION_NOT_ADDED " << name << std::endl;
+		return;
+	}
+
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	std::lock_guard<std::mutex> lock(mutex);
+	Pending& section = pending[name];
+	section.Data.assign(bytes, bytes + size);
+	memset(section.Info, 0, INFO_BYTES);
+	if (info != nullptr)
+		memcpy(section.Info, info, infoSize);
+}
+
+bool AssetPack::save()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (pending.empty() || path.empty())
+		return true;
+
+	std::string temporary = path + ".tmp";
+	std::ofstream file(temporary.c_str(), std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		std::cout << "ERROR::ASSET_PACK::FILE_NOT_SUCCESFULLY_WRITTEN " << temporary << std::endl;
+		return false;
+	}
+
+	// sections replaced in this run are taken from pending, the rest from the old mapping
+	std::vector<TocEntry> entries;
+	std::vector<const unsigned char*> sources;
+	for (std::map<std::string, TocEntry>::const_iterator it = toc.begin(); it != toc.end(); ++it)
+	{
+		if (pending.count(it->first) == 0)
+		{
+			entries.push_back(it->second);
+			sources.push_back(mapped + it->second.Offset);
+		}
+	}
+	for (std::map<std::string, Pending>::const_iterator it = pending.begin(); it != pending.end(); ++it)
+	{
+		TocEntry entry;
+		memset(&entry, 0, sizeof(entry));
+		strncpy(entry.Name, it->first.c_str(), MAX_NAME_LENGTH);
+		entry.Size = it->second.Data.size();
+		entry.Checksum = checksum(it->second.Data.data(), it->second.Data.size());
+		memcpy(entry.Info, it->second.Info, INFO_BYTES);
+		entries.push_back(entry);
+		sources.push_back(it->second.Data.data());
+	}
+
+	Header header;
+	memset(&header, 0, sizeof(header));
+	header.Magic = MAGIC;
+	header.FormatVersion = FORMAT_VERSION;
+	header.ContentVersion = contentVersion;
+	header.SectionCount = (unsigned int)entries.size();
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	size_t offset = sizeof(header);
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		size_t aligned = alignUp(offset, SECTION_ALIGNMENT);
+		writePadding(file, aligned - offset);
+		entries[i].Offset = aligned;
+		file.write(reinterpret_cast<const char*>(sources[i]), (std::streamsize)entries[i].Size);
+		offset = aligned + (size_t)entries[i].Size;
+	}
+
+	size_t tocOffset = alignUp(offset, 16);
+	writePadding(file, tocOffset - offset);
+	if (!entries.empty())
+		file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(TocEntry));
+
+	header.TocOffset = tocOffset;
+	header.TocChecksum = entries.empty() ? checksum(nullptr, 0) : checksum(entries.data(), entries.size() * sizeof(TocEntry));
+	file.seekp(0);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.close();
+	if (!file)
+	{
+		std::cout << "ERROR::ASSET_PACK::FILE_NOT_SUCCESFULLY_WRITTEN " << temporary << std::endl;
+		return false;
+	}
+
+	// the old file can only be replaced once nothing maps it
+	unmap();
+	pending.clear();
+#ifdef _WIN32
+	bool moved = MoveFileExA(temporary.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	bool moved = rename(temporary.c_str(), path.c_str()) == 0;
+#endif
+	if (!moved)
+	{
+		std::cout << "ERROR::ASSET_PACK::FILE_NOT_SUCCESFULLY_WRITTEN " << path << std::endl;
+		return false;
+	}
+	std::cout << "ASSET_PACK::" << path << " written, " << entries.size() << " sections" << std::endl;
+	return true;
+}
+
+bool AssetPack::map(const std::string& file)
+{
+#ifdef _WIN32
+	HANDLE handle = CreateFileA(file.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (handle == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(handle);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+	void* view = (mapping != NULL) ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+	if (view == NULL)
+	{
+		if (mapping != NULL)
+			CloseHandle(mapping);
+		CloseHandle(handle);
+		return false;
+	}
+
+	fileHandle = handle;
+	mappingHandle = mapping;
+	mapped = static_cast<const unsigned char*>(view);
+	mappedSize = (size_t)size.QuadPart;
+#else
+	int handle = ::open(file.c_str(), O_RDONLY);
+	if (handle < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(handle, &info) != 0 || info.st_size == 0)
+	{
+		::close(handle);
+		return false;
+	}
+
+	void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, handle, 0);
+	if (view == MAP_FAILED)
+	{
+		::close(handle);
+		return false;
+	}
+	// everything in the pack is used at startup, so ask for it up front
+	madvise(view, (size_t)info.st_size, MADV_WILLNEED);
+
+	fileHandle = handle;
+	mapped = static_cast<const unsigned char*>(view);
+	mappedSize = (size_t)info.st_size;
+#endif
+	return true;
+}
+
+void AssetPack::unmap()
+{
+	toc.clear();
+	verified.clear();
+	if (mapped == nullptr)
+		return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(mapped);
+	CloseHandle(mappingHandle);
+	CloseHandle(fileHandle);
+	mappingHandle = nullptr;
+	fileHandle = nullptr;
+#else
+	munmap(const_cast<unsigned char*>(mapped), mappedSize);
+	::close(fileHandle);
+	fileHandle = -1;
+#endif
+	mapped = nullptr;
+	mappedSize = 0;
+}
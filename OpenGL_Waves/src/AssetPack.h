@@ -0,0 +1,141 @@
+#pragma once
+
+#ifndef ASSETPACK_H
+#define ASSETPACK_H
+
+#include "GL_Util.h"
+
+#include <cstring>
+#include <map>
+#include <mutex>
+
+// One versioned binary file holding everything that is generated at startup (meshes,
+// terrain, processed textures) in GPU ready form. The file is memory mapped and section
+// pointers go straight to glBufferData / glCompressedTexSubImage2D, so a warm start does
+// no generation and no parsing.
+//
+// Layout: Header | sections, each aligned to SECTION_ALIGNMENT | table of contents.
+// Every section carries a checksum that is verified on first access, plus a small info
+// block the owner uses for its own description (counts, formats, bounds).
+class AssetPack
+{
+public:
+	enum
+	{
+		SECTION_ALIGNMENT = 4096,	// page aligned, so a section never shares a page with its neighbour
+		MAX_NAME_LENGTH = 63,
+		INFO_BYTES = 32
+	};
+
+	// a mapped section, valid until close()
+	struct Section
+	{
+		const unsigned char* Data = nullptr;
+		size_t Size = 0;
+		unsigned char Info[INFO_BYTES];
+	};
+
+	static AssetPack& instance();
+
+	///<summary>
+	/// Maps the pack at path. A missing file, a different format or contentVersion, or a
+	/// damaged table of contents leave the pack empty, so every lookup misses and the
+	/// assets are regenerated and written again by save().
+	///</summary>
+	bool open(const std::string& path, unsigned int contentVersion);
+	void close();
+
+	///<summary>
+	/// Looks up a section by name. The checksum is checked the first time a section is
+	/// found; a mismatch is reported and treated as a miss.
+	///</summary>
+	bool find(const std::string& name, Section& out);
+
+	///<summary>
+	/// Copies data into a new section that is written by the next save(). info is the
+	/// owner's description and at most INFO_BYTES long. Thread safe.
+	///</summary>
+	void add(const std::string& name, const void* data, size_t size, const void* info = nullptr, size_t infoSize = 0);
+
+	///<summary>
+	/// Rewrites the file when sections were added since open(). Unchanged sections are
+	/// copied from the mapping, then the mapping is closed and the new file moved in place.
+	///</summary>
+	bool save();
+
+	// the info block as the owner's POD description
+	template<typename T>
+	static T info(const Section& section)
+	{
+		static_assert(sizeof(T) <= INFO_BYTES, "section info too large");
+		T value;
+		memcpy(&value, section.Info, sizeof(T));
+		return value;
+	}
+
+	static unsigned long long checksum(const void* data, size_t size);
+
+	// with reads disabled every lookup misses, so everything is rebuilt and saved again
+	void setReadEnabled(bool enabled) { readEnabled = enabled; }
+
+	unsigned int getHits() const { return hits; }
+	unsigned int getMisses() const { return misses; }
+	bool isOpen() const { return mapped != nullptr; }
+
+private:
+	static const unsigned int MAGIC = 0x4B415047;	// "GPAK"
+	static const unsigned int FORMAT_VERSION = 1;
+
+	struct Header
+	{
+		unsigned int Magic;
+		unsigned int FormatVersion;
+		unsigned int ContentVersion;
+		unsigned int SectionCount;
+		unsigned long long TocOffset;
+		unsigned long long TocChecksum;
+	};
+
+	struct TocEntry
+	{
+		char Name[MAX_NAME_LENGTH + 1];
+		unsigned long long Offset;
+		unsigned long long Size;
+		unsigned long long Checksum;
+		unsigned char Info[INFO_BYTES];
+	};
+
+	struct Pending
+	{
+		std::vector<unsigned char> Data;
+		unsigned char Info[INFO_BYTES];
+	};
+
+	std::mutex mutex;
+	std::string path;
+	unsigned int contentVersion = 0;
+
+	const unsigned char* mapped = nullptr;
+	size_t mappedSize = 0;
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#else
+	int fileHandle = -1;
+#endif
+
+	std::map<std::string, TocEntry> toc;
+	std::map<std::string, bool> verified;
+	std::map<std::string, Pending> pending;
+	bool readEnabled = true;
+	unsigned int hits = 0;
+	unsigned int misses = 0;
+
+	AssetPack() {}
+	~AssetPack() { close(); }
+
+	bool map(const std::string& file);
+	void unmap();
+};
+
+#endif // ASSETPACK_H
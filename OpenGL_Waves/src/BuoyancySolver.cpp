@@ -0,0 +1,119 @@
+#include "BuoyancySolver.h"
+#include "JobSystem.h"
+
+const float BuoyancySolver::WATER_DENSITY = 1000.0f;
+const float BuoyancySolver::WATER_DRAG = 5.0f;
+
+namespace
+{
+	// hull points along the diameter in the direction the waves vary, in radii from the center
+	const float HULL_OFFSETS[BuoyancySolver::HULL_POINTS] = { -0.75f, -0.25f, 0.25f, 0.75f };
+}
+
+size_t BuoyancySolver::addBody(const glm::vec3& position, float radius, float density)
+{
+	// grow by a whole batch, unused slots float at the origin and are never read back
+	if (count % 4 == 0)
+	{
+		size_t padded = count + 4;
+		positionX.resize(padded, 0.0f);
+		positionY.resize(padded, 0.0f);
+		positionZ.resize(padded, 0.0f);
+		previousX.resize(padded, 0.0f);
+		previousY.resize(padded, 0.0f);
+		previousZ.resize(padded, 0.0f);
+		velocityX.resize(padded, 0.0f);
+		velocityY.resize(padded, 0.0f);
+		velocityZ.resize(padded, 0.0f);
+		radii.resize(padded, 1.0f);
+		densityRatio.resize(padded, 2.0f);
+	}
+
+	size_t body = count++;
+	positionX[body] = previousX[body] = position.x;
+	positionY[body] = previousY[body] = position.y;
+	positionZ[body] = previousZ[body] = position.z;
+	velocityX[body] = velocityY[body] = velocityZ[body] = 0.0f;
+	radii[body] = radius;
+	densityRatio[body] = WATER_DENSITY / density;
+	return body;
+}
+
+void BuoyancySolver::clear()
+{
+	count = 0;
+	positionX.clear();
+	positionY.clear();
+	positionZ.clear();
+	previousX.clear();
+	previousY.clear();
+	previousZ.clear();
+	velocityX.clear();
+	velocityY.clear();
+	velocityZ.clear();
+	radii.clear();
+	densityRatio.clear();
+}
+
+void BuoyancySolver::step(const WaveField& waves, float time, float stepSeconds)
+{
+	size_t batches = (count + 3) / 4;
+	JobSystem::instance().parallelFor(batches, MIN_BATCHES_PER_JOB, [&](size_t begin, size_t end)
+	{
+		for (size_t batch = begin; batch < end; ++batch)
+			stepBatch(batch * 4, waves, time, stepSeconds);
+	});
+}
+
+void BuoyancySolver::stepBatch(size_t first, const WaveField& waves, float time, float stepSeconds)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 dt = _mm_set1_ps(stepSeconds);
+	const __m128 gravity = _mm_set1_ps(waves.Gravity);
+	const __m128 drag = _mm_set1_ps(WATER_DRAG);
+
+	__m128 x = _mm_loadu_ps(&positionX[first]);
+	__m128 y = _mm_loadu_ps(&positionY[first]);
+	__m128 z = _mm_loadu_ps(&positionZ[first]);
+	__m128 vx = _mm_loadu_ps(&velocityX[first]);
+	__m128 vy = _mm_loadu_ps(&velocityY[first]);
+	__m128 vz = _mm_loadu_ps(&velocityZ[first]);
+	__m128 r = _mm_loadu_ps(&radii[first]);
+	_mm_storeu_ps(&previousX[first], x);
+	_mm_storeu_ps(&previousY[first], y);
+	_mm_storeu_ps(&previousZ[first], z);
+
+	// submerged volume fraction and the water velocity it feels, averaged over the hull points
+	__m128 bottom = _mm_sub_ps(y, r);
+	__m128 diameter = _mm_add_ps(r, r);
+	__m128 threeR = _mm_add_ps(diameter, r);
+	__m128 capScale = _mm_div_ps(_mm_set1_ps(1.0f / HULL_POINTS), _mm_mul_ps(_mm_set1_ps(4.0f), _mm_mul_ps(r, _mm_mul_ps(r, r))));
+	__m128 submerged = zero;
+	__m128 flowX = zero, flowY = zero;
+	for (int i = 0; i < HULL_POINTS; ++i)
+	{
+		__m128 height, waterX, waterY;
+		waves.sample4(_mm_add_ps(x, _mm_mul_ps(r, _mm_set1_ps(HULL_OFFSETS[i]))), time, height, waterX, waterY);
+
+		// sphere cap below the surface: d^2 (3r - d) / 4r^3 of the volume
+		__m128 depth = _mm_min_ps(_mm_max_ps(_mm_sub_ps(height, bottom), zero), diameter);
+		__m128 fraction = _mm_mul_ps(_mm_mul_ps(depth, depth), _mm_mul_ps(_mm_sub_ps(threeR, depth), capScale));
+		submerged = _mm_add_ps(submerged, fraction);
+		flowX = _mm_add_ps(flowX, _mm_mul_ps(fraction, waterX));
+		flowY = _mm_add_ps(flowY, _mm_mul_ps(fraction, waterY));
+	}
+
+	// v' = (v + dt * (a + drag * flow)) / (1 + dt * drag * submerged), then x' = x + dt * v'
+	__m128 buoyancy = _mm_mul_ps(gravity, _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(&densityRatio[first]), submerged), _mm_set1_ps(1.0f)));
+	__m128 damping = _mm_div_ps(_mm_set1_ps(1.0f), _mm_add_ps(_mm_set1_ps(1.0f), _mm_mul_ps(dt, _mm_mul_ps(drag, submerged))));
+	vx = _mm_mul_ps(_mm_add_ps(vx, _mm_mul_ps(dt, _mm_mul_ps(drag, flowX))), damping);
+	vy = _mm_mul_ps(_mm_add_ps(vy, _mm_mul_ps(dt, _mm_add_ps(buoyancy, _mm_mul_ps(drag, flowY)))), damping);
+	vz = _mm_mul_ps(vz, damping);
+
+	_mm_storeu_ps(&positionX[first], _mm_add_ps(x, _mm_mul_ps(dt, vx)));
+	_mm_storeu_ps(&positionY[first], _mm_add_ps(y, _mm_mul_ps(dt, vy)));
+	_mm_storeu_ps(&positionZ[first], _mm_add_ps(z, _mm_mul_ps(dt, vz)));
+	_mm_storeu_ps(&velocityX[first], vx);
+	_mm_storeu_ps(&velocityY[first], vy);
+	_mm_storeu_ps(&velocityZ[first], vz);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#ifndef BUOYANCYSOLVER_H
+#define BUOYANCYSOLVER_H
+
+#include "GL_Util.h"
+#include "WaveField.h"
+
+#include <vector>
+
+// Floating spheres on a WaveField. Every step each body samples the surface under HULL_POINTS
+// points spread along its diameter and takes the submerged volume of a sphere cap at each,
+// which gives the buoyancy and how much of the water's drag acts on it. Integration is
+// semi-implicit Euler with the drag solved implicitly, so it stays stable at any damping.
+//
+// Bodies are stored as structure of arrays padded to a multiple of four and stepped four at a
+// time with SSE, with the batches split over the job system.
+class BuoyancySolver
+{
+public:
+	static const int HULL_POINTS = 4;
+	static const float WATER_DENSITY;
+	static const float WATER_DRAG;		// per second, on a fully submerged body
+
+	///<summary>
+	/// Adds a sphere at rest and returns its index. Density is in kg/m^3, water is 1000.
+	///</summary>
+	size_t addBody(const glm::vec3& position, float radius, float density);
+	void clear();
+
+	///<summary>
+	/// Advances every body by one fixed step, with the surface at simulated time t.
+	///</summary>
+	void step(const WaveField& waves, float time, float stepSeconds);
+
+	size_t bodyCount() const { return count; }
+	float radius(size_t body) const { return radii[body]; }
+	glm::vec3 position(size_t body) const { return glm::vec3(positionX[body], positionY[body], positionZ[body]); }
+	glm::vec3 previousPosition(size_t body) const { return glm::vec3(previousX[body], previousY[body], previousZ[body]); }
+	glm::vec3 velocity(size_t body) const { return glm::vec3(velocityX[body], velocityY[body], velocityZ[body]); }
+
+private:
+	// batches of four per job, below this splitting costs more than it saves
+	static const size_t MIN_BATCHES_PER_JOB = 64;
+
+	size_t count = 0;
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> previousX, previousY, previousZ;
+	std::vector<float> velocityX, velocityY, velocityZ;
+	std::vector<float> radii;
+	std::vector<float> densityRatio;	// water density over body density
+
+	void stepBatch(size_t first, const WaveField& waves, float time, float stepSeconds);
+};
+
+#endif // BUOYANCYSOLVER_H
@@ -5,6 +5,8 @@
 
 #include "GL_Util.h"
 
+class Player;
+
 // Defines several possible options for camera movement. Used as abstraction to stay away from window-system specific input methods
 enum Camera_Movement {
 	FORWARD,
@@ -68,7 +70,7 @@ public:
 		updateCameraVectors();
 	}
 
-	Camera(Player player)
+	Camera(const Player& player)
 	{
 		//set up FPS camera here...
 		Mode = FPS;
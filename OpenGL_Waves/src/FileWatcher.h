@@ -0,0 +1,225 @@
+#pragma once
+
+#ifndef FILEWATCHER_H
+#define FILEWATCHER_H
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// Reports changes to a set of files from its own thread. On Linux the parent directories
+// are watched with inotify, so editors that save through a rename are caught as well;
+// elsewhere the modification times are polled.
+class FileWatcher
+{
+public:
+	typedef std::function<void(const std::string&)> Callback;
+
+	struct Stamp
+	{
+		long long Time = -1;
+		long long Size = -1;
+
+		bool operator!=(const Stamp& other) const { return Time != other.Time || Size != other.Size; }
+	};
+
+	FileWatcher() {}
+
+	~FileWatcher()
+	{
+		stop();
+	}
+
+	// files can be added while the watcher runs
+	void watch(const std::string& path)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (files.insert(path).second)
+		{
+			added = true;
+			stamps.push_back(std::make_pair(path, stampOf(path)));
+		}
+	}
+
+	void start(const Callback& onChange)
+	{
+		if (running)
+			return;
+
+		callback = onChange;
+		running = true;
+		worker = std::thread(&FileWatcher::run, this);
+	}
+
+	void stop()
+	{
+		if (!running)
+			return;
+
+		running = false;
+		worker.join();
+	}
+
+private:
+	std::thread worker;
+	std::atomic<bool> running{ false };
+	Callback callback;
+
+	std::mutex mutex;
+	std::set<std::string> files;
+	std::vector<std::pair<std::string, Stamp> > stamps;
+	bool added = false;
+
+	enum { POLL_MILLISECONDS = 250 };
+
+	// the watcher is tied to its thread
+	FileWatcher(const FileWatcher&);
+	FileWatcher& operator=(const FileWatcher&);
+
+	// st_mtime only has second resolution, the size catches quick successive saves
+	static Stamp stampOf(const std::string& path)
+	{
+		Stamp stamp;
+		struct stat info;
+		if (stat(path.c_str(), &info) == 0)
+		{
+			stamp.Time = (long long)info.st_mtime;
+			stamp.Size = (long long)info.st_size;
+		}
+		return stamp;
+	}
+
+	static std::string directoryOf(const std::string& path)
+	{
+		size_t slash = path.find_last_of("/\\");
+		return (slash == std::string::npos) ? std::string(".") : path.substr(0, slash);
+	}
+
+#ifdef __linux__
+	void run()
+	{
+		int fd = inotify_init1(IN_NONBLOCK);
+		if (fd < 0)
+		{
+			std::cout << "ERROR::FILE_WATCHER::INOTIFY_NOT_AVAILABLE, polling instead" << std::endl;
+			runPolling();
+			return;
+		}
+
+		// watch descriptor -> directory
+		std::vector<std::pair<int, std::string> > directories;
+		char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+		while (running)
+		{
+			addDirectories(fd, directories);
+
+			pollfd pfd;
+			pfd.fd = fd;
+			pfd.events = POLLIN;
+			if (poll(&pfd, 1, POLL_MILLISECONDS) <= 0)
+				continue;
+
+			// one read holds every event of a save, each changed file is reported once
+			std::set<std::string> changed;
+			ssize_t length;
+			while ((length = read(fd, buffer, sizeof(buffer))) > 0)
+			{
+				for (char* p = buffer; p < buffer + length;)
+				{
+					const inotify_event* event = (const inotify_event*)p;
+					p += sizeof(inotify_event) + event->len;
+					if (event->len == 0)
+						continue;
+
+					for (size_t i = 0; i < directories.size(); ++i)
+					{
+						if (directories[i].first != event->wd)
+							continue;
+						std::string path = (directories[i].second == ".") ? std::string(event->name) : directories[i].second + "/" + event->name;
+						std::lock_guard<std::mutex> lock(mutex);
+						if (files.count(path))
+							changed.insert(path);
+					}
+				}
+			}
+
+			for (std::set<std::string>::iterator it = changed.begin(); it != changed.end(); ++it)
+				callback(*it);
+		}
+
+		close(fd);
+	}
+
+	void addDirectories(int fd, std::vector<std::pair<int, std::string> >& directories)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!added)
+			return;
+		added = false;
+
+		for (std::set<std::string>::iterator it = files.begin(); it != files.end(); ++it)
+		{
+			std::string directory = directoryOf(*it);
+			bool known = false;
+			for (size_t i = 0; i < directories.size(); ++i)
+				known = known || directories[i].second == directory;
+			if (known)
+				continue;
+
+			int wd = inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+			if (wd < 0)
+				std::cout << "ERROR::FILE_WATCHER::DIRECTORY_NOT_WATCHED " << directory << std::endl;
+			else
+				directories.push_back(std::make_pair(wd, directory));
+		}
+	}
+#else
+	void run()
+	{
+		runPolling();
+	}
+#endif
+
+	void runPolling()
+	{
+		while (running)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(POLL_MILLISECONDS));
+
+			std::vector<std::string> changed;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				for (size_t i = 0; i < stamps.size(); ++i)
+				{
+					Stamp stamp = stampOf(stamps[i].first);
+					if (stamp != stamps[i].second)
+					{
+						stamps[i].second = stamp;
+						if (stamp.Time >= 0)
+							changed.push_back(stamps[i].first);
+					}
+				}
+			}
+
+			for (size_t i = 0; i < changed.size(); ++i)
+				callback(changed[i]);
+		}
+	}
+};
+
+#endif // FILEWATCHER_H
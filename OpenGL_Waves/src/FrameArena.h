@@ -0,0 +1,148 @@
+#pragma once
+
+#ifndef FRAMEARENA_H
+#define FRAMEARENA_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+// Linear allocator for data that lives for one frame. Allocating bumps an offset and nothing
+// is freed on its own: reset() drops everything at once when the frame is over. If a frame
+// outgrew the first block, reset() replaces the blocks with a single one as large as the
+// busiest frame so far, so a steady state frame allocates nothing from the heap.
+//
+// Not thread safe, allocate from the thread that owns the frame phase.
+class FrameArena
+{
+public:
+	explicit FrameArena(size_t initialSize = 64 * 1024)
+		: blockSize(initialSize) {}
+
+	~FrameArena()
+	{
+		release();
+	}
+
+	void* allocate(size_t size, size_t alignment = alignof(std::max_align_t))
+	{
+		while (current < blocks.size())
+		{
+			Block& block = blocks[current];
+			size_t start = (offset + alignment - 1) / alignment * alignment;
+			// blocks come from malloc, so aligning the offset is enough up to max_align_t
+			if (start + size <= block.Size)
+			{
+				used += (start - offset) + size;
+				offset = start + size;
+				return block.Data + start;
+			}
+			current++;
+			offset = 0;
+		}
+
+		size_t needed = size + alignment;
+		addBlock((needed > blockSize) ? needed : blockSize);
+		return allocate(size, alignment);
+	}
+
+	template <typename T>
+	T* allocateArray(size_t count)
+	{
+		return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+	}
+
+	///<summary>
+	/// Releases every allocation of the frame. Pointers handed out before are invalid after.
+	///</summary>
+	void reset()
+	{
+		if (used > peak)
+			peak = used;
+		if (blocks.size() > 1)
+		{
+			release();
+			if (peak > blockSize)
+				blockSize = peak;
+			addBlock(blockSize);
+		}
+		current = 0;
+		offset = 0;
+		used = 0;
+	}
+
+	size_t bytesUsed() const { return used; }
+	size_t peakBytes() const { return (used > peak) ? used : peak; }
+
+private:
+	struct Block
+	{
+		unsigned char* Data;
+		size_t Size;
+	};
+
+	std::vector<Block> blocks;
+	size_t blockSize;
+	size_t current = 0;		// block being bumped through
+	size_t offset = 0;		// within blocks[current]
+	size_t used = 0;
+	size_t peak = 0;
+
+	void addBlock(size_t size)
+	{
+		Block block;
+		block.Data = static_cast<unsigned char*>(std::malloc(size));
+		if (block.Data == nullptr)
+			throw std::bad_alloc();
+		block.Size = size;
+		blocks.push_back(block);
+		current = blocks.size() - 1;
+		offset = 0;
+	}
+
+	void release()
+	{
+		for (size_t i = 0; i < blocks.size(); ++i)
+			std::free(blocks[i].Data);
+		blocks.clear();
+	}
+
+	FrameArena(const FrameArena&);
+	FrameArena& operator=(const FrameArena&);
+};
+
+///<summary>
+/// STL allocator on a FrameArena, for containers that only live for one frame. deallocate()
+/// does nothing, a growing vector leaves its old buffers in the arena until the reset.
+///</summary>
+template <typename T>
+class ArenaAllocator
+{
+public:
+	typedef T value_type;
+
+	explicit ArenaAllocator(FrameArena& frameArena) : arena(&frameArena) {}
+
+	template <typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+	T* allocate(size_t n)
+	{
+		return arena->allocateArray<T>(n);
+	}
+
+	void deallocate(T*, size_t) {}
+
+	template <typename U>
+	bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+	template <typename U>
+	bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+
+private:
+	template <typename U> friend class ArenaAllocator;
+
+	FrameArena* arena;
+};
+
+#endif // FRAMEARENA_H
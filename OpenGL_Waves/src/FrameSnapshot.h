@@ -0,0 +1,96 @@
+#pragma once
+
+#ifndef FRAMESNAPSHOT_H
+#define FRAMESNAPSHOT_H
+
+#include "FrameArena.h"
+#include "GL_Util.h"
+
+// Everything the render phase needs to draw one frame. The simulation phase fills it in and
+// nothing changes it afterwards, so a frame can be drawn on the main thread while the next
+// one is simulated on the job system. Vectors are cleared rather than rebuilt, they keep
+// their capacity from frame to frame.
+struct FrameSnapshot
+{
+	// a mesh to draw: its transform and the LOD level picked for it
+	struct Instance
+	{
+		glm::mat4 Model;
+		unsigned int Level;
+	};
+
+	unsigned long long Frame = 0;
+	float DeltaTime = 0.0f;		// real time since the last frame
+	float WaveTime = 0.0f;		// simulated time, interpolated to this frame
+	float Interpolation = 1.0f;	// SimClock alpha, blends the last two simulated states
+
+	// camera
+	glm::vec3 CameraPosition;
+	glm::vec3 CameraFront;
+	float CameraZoom = 45.0f;
+	glm::mat4 View;
+	glm::mat4 Projection;
+	unsigned int ScreenWidth = 0;
+	unsigned int ScreenHeight = 0;
+
+	// lights
+	glm::vec3 LightPosition;
+	std::vector<glm::vec3> PointLights;
+	Instance LightMarker;
+
+	// objects
+	std::vector<Instance> Pillars;
+	std::vector<Instance> Spheres;
+	std::vector<Instance> Floats;	// bodies on the water
+	Instance Player;
+
+	// terrain
+	std::vector<GLushort> TerrainHeights;	// the generated grid, when it changed since the last upload
+	glm::vec2 TerrainRange;				// heights TerrainHeights spans
+	unsigned int TerrainVersion = 0;
+
+	// water
+	std::vector<float> Ripples;		// RippleSolver heights, SIZE x SIZE
+	glm::vec2 RippleOrigin;
+	float RippleExtent = 0.0f;
+	std::vector<GLushort> FloodSurface;	// ShallowWaterSolver surface, packed like the terrain grid
+	glm::vec2 FloodRange;				// heights the packed surface spans
+
+	// scratch memory for the frame, reset when the snapshot is simulated again. Mutable so the
+	// render phase can take temporaries from it through the const snapshot
+	mutable FrameArena Arena;
+
+	///<summary>
+	/// Copies the camera state and builds the view and projection matrices.
+	///</summary>
+	void setCamera(const Camera& camera, unsigned int width, unsigned int height)
+	{
+		CameraPosition = camera.Position;
+		CameraFront = camera.Front;
+		CameraZoom = camera.Zoom;
+		View = glm::lookAt(camera.Position, camera.Position + camera.Front, camera.Up);
+		Projection = glm::perspective(glm::radians(camera.Zoom), (float)width / (float)height, 0.1f, 100.0f);
+		ScreenWidth = width;
+		ScreenHeight = height;
+	}
+};
+
+// Two snapshots: read() is the frame being drawn, write() the one being simulated.
+// publish() hands the written frame to the renderer once both phases are done with theirs.
+class FrameSnapshots
+{
+public:
+	FrameSnapshot& write() { return slots[1 - current]; }
+	const FrameSnapshot& read() const { return slots[current]; }
+
+	void publish()
+	{
+		current = 1 - current;
+	}
+
+private:
+	FrameSnapshot slots[2];
+	unsigned int current = 0;
+};
+
+#endif // FRAMESNAPSHOT_H
@@ -0,0 +1,41 @@
+#include "GL_Extensions.h"
+
+#ifndef GL_VERSION_4_1
+PFNGLGETPROGRAMBINARYPROC glad_glGetProgramBinary = nullptr;
+PFNGLPROGRAMBINARYPROC glad_glProgramBinary = nullptr;
+PFNGLPROGRAMPARAMETERIPROC glad_glProgramParameteri = nullptr;
+#endif
+
+#ifndef GL_VERSION_4_2
+PFNGLTEXSTORAGE2DPROC glad_glTexStorage2D = nullptr;
+#endif
+
+#ifndef GL_VERSION_4_4
+PFNGLBUFFERSTORAGEPROC glad_glBufferStorage = nullptr;
+#endif
+
+namespace
+{
+	void* loadEither(GLADloadproc load, const char* core, const char* arb)
+	{
+		void* proc = load(core);
+		return (proc != nullptr) ? proc : load(arb);
+	}
+}
+
+void LoadGLExtensions(GLADloadproc load)
+{
+#ifndef GL_VERSION_4_1
+	glad_glGetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)load("glGetProgramBinary");
+	glad_glProgramBinary = (PFNGLPROGRAMBINARYPROC)load("glProgramBinary");
+	glad_glProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)loadEither(load, "glProgramParameteri", "glProgramParameteriARB");
+#endif
+
+#ifndef GL_VERSION_4_2
+	glad_glTexStorage2D = (PFNGLTEXSTORAGE2DPROC)loadEither(load, "glTexStorage2D", "glTexStorage2DARB");
+#endif
+
+#ifndef GL_VERSION_4_4
+	glad_glBufferStorage = (PFNGLBUFFERSTORAGEPROC)loadEither(load, "glBufferStorage", "glBufferStorageARB");
+#endif
+}
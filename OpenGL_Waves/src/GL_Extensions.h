@@ -0,0 +1,60 @@
+#pragma once
+
+#ifndef GLEXTENSIONS_H
+#define GLEXTENSIONS_H
+
+// The bundled glad loader is generated for GL 3.3 core. The few newer entry points used
+// here are declared the way glad declares its own and loaded by LoadGLExtensions() once
+// glad is initialised. A pointer stays null when the driver does not provide it, so
+// callers that have a fallback check it first. Each block is skipped if glad is ever
+// regenerated with the version that provides it.
+
+#include <glad/glad.h>
+
+// GL 4.1 / ARB_get_program_binary
+#ifndef GL_VERSION_4_1
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#define GL_PROGRAM_BINARY_FORMATS 0x87FF
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+extern PFNGLGETPROGRAMBINARYPROC glad_glGetProgramBinary;
+extern PFNGLPROGRAMBINARYPROC glad_glProgramBinary;
+extern PFNGLPROGRAMPARAMETERIPROC glad_glProgramParameteri;
+#define glGetProgramBinary glad_glGetProgramBinary
+#define glProgramBinary glad_glProgramBinary
+#define glProgramParameteri glad_glProgramParameteri
+#endif
+
+// GL 4.2 / ARB_texture_storage
+#ifndef GL_VERSION_4_2
+typedef void (APIENTRYP PFNGLTEXSTORAGE2DPROC)(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height);
+extern PFNGLTEXSTORAGE2DPROC glad_glTexStorage2D;
+#define glTexStorage2D glad_glTexStorage2D
+#endif
+
+// GL 4.3 / ARB_ES3_compatibility
+#ifndef GL_VERSION_4_3
+#define GL_PRIMITIVE_RESTART_FIXED_INDEX 0x8D69
+#endif
+
+// GL 4.4 / ARB_buffer_storage
+#ifndef GL_VERSION_4_4
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#define GL_CLIENT_STORAGE_BIT 0x0200
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+extern PFNGLBUFFERSTORAGEPROC glad_glBufferStorage;
+#define glBufferStorage glad_glBufferStorage
+#endif
+
+///<summary>
+/// Loads the entry points above, call right after gladLoadGLLoader with the same loader.
+/// The ARB names are tried when the core name is missing.
+///</summary>
+void LoadGLExtensions(GLADloadproc load);
+
+#endif // GLEXTENSIONS_H
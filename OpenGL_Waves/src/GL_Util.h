@@ -11,6 +11,7 @@
 
 //GLAD
 #include <glad/glad.h>
+#include "GL_Extensions.h"
 
 // GLFW
 #include <GLFW/glfw3.h>
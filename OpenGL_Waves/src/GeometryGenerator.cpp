@@ -1,8 +1,21 @@
 #pragma once
 
 #include "GeometryGenerator.h"
+#include "JobSystem.h"
+#include "ObjectPool.h"
 
-void GeometryGenerator::CreateGrid(float width, float depth, int m, int n, MeshData& meshData) //Based off GeometryGenerator class
+#include <unordered_map>
+
+const GLuint GeometryGenerator::RESTART_INDEX;
+const unsigned int GeometryGenerator::MAX_GEOSPHERE_SUBDIVISIONS;
+
+namespace
+{
+	// small ranges are not worth handing to the job system
+	const size_t MIN_PER_JOB = 4096;
+}
+
+void GeometryGenerator::CreateGrid(float width, float depth, int m, int n, MeshData& meshData, bool triangleStrip) //Based off GeometryGenerator class
 {
 	int vertexCount = m * n;
 	int faceCount = (m - 1)*(n - 1) * 2;
@@ -33,7 +46,28 @@ void GeometryGenerator::CreateGrid(float width, float depth, int m, int n, MeshD
 		}
 	}
 
+	if (triangleStrip)
+	{
+		// one strip per row pair, (i+1, j) before (i, j) keeps the same winding as the list below
+		meshData.Topology = GL_TRIANGLE_STRIP;
+		meshData.Indices.clear();
+		meshData.Indices.reserve((m - 1) * (2 * n + 1));
+		for (int i = 0; i < m - 1; ++i)
+		{
+			if (i > 0)
+				meshData.Indices.push_back(RESTART_INDEX);
+
+			for (int j = 0; j < n; ++j)
+			{
+				meshData.Indices.push_back((GLuint)((i + 1)*n + j));
+				meshData.Indices.push_back((GLuint)(i * n + j));
+			}
+		}
+		return;
+	}
+
 	//indices
+	meshData.Topology = GL_TRIANGLES;
 	meshData.Indices.resize(3 * faceCount);
 	GLuint k = 0;
 	for (GLuint i = 0; i < m - 1; ++i)
@@ -456,104 +490,118 @@ void GeometryGenerator::CreateSphere(float radius, unsigned int sliceCount, unsi
 
 void GeometryGenerator::Subdivide(MeshData& meshData)
 {
-	// Save a copy of the input geometry.
-	MeshData inputCopy = meshData;
-
+	// The input vertices are kept, midpoints are appended after them.
+	std::vector<GLuint> inputIndices;
+	inputIndices.swap(meshData.Indices);
+
+	/*
+	       v1
+	       *
+	      / \
+	     /   \
+	  m0*-----*m1
+	   / \   / \
+	  /   \ /   \
+	 *-----*-----*
+	 v0    m2     v2
+	*/
+
+	size_t numTris = inputIndices.size() / 3;
+	GLuint baseVertex = (GLuint)meshData.Vertices.size();
 
-	meshData.Vertices.resize(0);
-	meshData.Indices.resize(0);
+	//
+	// Share one midpoint per edge. Edges are keyed by their sorted endpoints, so the
+	// two triangles on either side of an edge get the same midpoint index.
+	//
 
-	//       v1
-	//       *
-	//      / \
-		//     /   \
-	//  m0*-----*m1
-//   / \   / \
-	//  /   \ /   \
-	// *-----*-----*
-// v0    m2     v2
+	// map nodes come from a pool, one allocation per slab instead of one per edge
+	typedef std::pair<const unsigned long long, GLuint> EdgeEntry;
+	BlockPool nodePool(sizeof(EdgeEntry) + 2 * sizeof(void*), alignof(std::max_align_t), 4096);
+	std::unordered_map<unsigned long long, GLuint, std::hash<unsigned long long>, std::equal_to<unsigned long long>, PoolAllocator<EdgeEntry> >
+		edgeMidpoints(0, std::hash<unsigned long long>(), std::equal_to<unsigned long long>(), PoolAllocator<EdgeEntry>(nodePool));
+	edgeMidpoints.reserve(numTris * 3 / 2 + 1);
+	std::vector<GLuint> triMidpoints(numTris * 3);
+	std::vector<GLuint> edgeEnds;
 
-	unsigned int numTris = inputCopy.Indices.size() / 3;
-	for (unsigned int i = 0; i < numTris; ++i)
+	for (size_t i = 0; i < numTris; ++i)
 	{
-		Vertex v0 = inputCopy.Vertices[inputCopy.Indices[i * 3 + 0]];
-		Vertex v1 = inputCopy.Vertices[inputCopy.Indices[i * 3 + 1]];
-		Vertex v2 = inputCopy.Vertices[inputCopy.Indices[i * 3 + 2]];
-
-		//
-		// Generate the midpoints.
-		//
-
-		Vertex m0, m1, m2;
-
-		// For subdivision, we just care about the position component.  We derive the other
-		// vertex components in CreateGeosphere.
-
-		m0.Position = glm::vec3(
-			0.5f*(v0.Position.x + v1.Position.x),
-			0.5f*(v0.Position.y + v1.Position.y),
-			0.5f*(v0.Position.z + v1.Position.z));
-
-		m1.Position = glm::vec3(
-			0.5f*(v1.Position.x + v2.Position.x),
-			0.5f*(v1.Position.y + v2.Position.y),
-			0.5f*(v1.Position.z + v2.Position.z));
-
-		m2.Position = glm::vec3(
-			0.5f*(v0.Position.x + v2.Position.x),
-			0.5f*(v0.Position.y + v2.Position.y),
-			0.5f*(v0.Position.z + v2.Position.z));
-
-		//
-		// Add new geometry.
-		//
-
-		meshData.Vertices.push_back(v0); // 0
-		meshData.Vertices.push_back(v1); // 1
-		meshData.Vertices.push_back(v2); // 2
-		meshData.Vertices.push_back(m0); // 3
-		meshData.Vertices.push_back(m1); // 4
-		meshData.Vertices.push_back(m2); // 5
-
-		meshData.Indices.push_back(i * 6 + 0);
-		meshData.Indices.push_back(i * 6 + 3);
-		meshData.Indices.push_back(i * 6 + 5);
-
-		meshData.Indices.push_back(i * 6 + 3);
-		meshData.Indices.push_back(i * 6 + 4);
-		meshData.Indices.push_back(i * 6 + 5);
-
-		meshData.Indices.push_back(i * 6 + 5);
-		meshData.Indices.push_back(i * 6 + 4);
-		meshData.Indices.push_back(i * 6 + 2);
-
-		meshData.Indices.push_back(i * 6 + 3);
-		meshData.Indices.push_back(i * 6 + 1);
-		meshData.Indices.push_back(i * 6 + 4);
+		for (int e = 0; e < 3; ++e)
+		{
+			GLuint a = inputIndices[i * 3 + e];
+			GLuint b = inputIndices[i * 3 + (e + 1) % 3];
+			unsigned long long key = ((unsigned long long)glm::min(a, b) << 32) | glm::max(a, b);
+
+			auto inserted = edgeMidpoints.insert(std::make_pair(key, baseVertex + (GLuint)(edgeEnds.size() / 2)));
+			if (inserted.second)
+			{
+				edgeEnds.push_back(a);
+				edgeEnds.push_back(b);
+			}
+			triMidpoints[i * 3 + e] = inserted.first->second;
+		}
 	}
+
+	//
+	// Generate the midpoints and the new triangles, both are independent per element.
+	//
+
+	size_t numEdges = edgeEnds.size() / 2;
+	meshData.Vertices.resize(baseVertex + numEdges);
+	meshData.Indices.resize(numTris * 12);
+
+	// For subdivision, we just care about the position component.  We derive the other
+	// vertex components in CreateGeosphere.
+	JobSystem::instance().parallelFor(numEdges, MIN_PER_JOB, [&](size_t begin, size_t end)
+	{
+		for (size_t e = begin; e < end; ++e)
+		{
+			const glm::vec3& p0 = meshData.Vertices[edgeEnds[e * 2 + 0]].Position;
+			const glm::vec3& p1 = meshData.Vertices[edgeEnds[e * 2 + 1]].Position;
+			meshData.Vertices[baseVertex + e].Position = 0.5f * (p0 + p1);
+		}
+	});
+
+	JobSystem::instance().parallelFor(numTris, MIN_PER_JOB, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+		{
+			GLuint v0 = inputIndices[i * 3 + 0];
+			GLuint v1 = inputIndices[i * 3 + 1];
+			GLuint v2 = inputIndices[i * 3 + 2];
+			GLuint m0 = triMidpoints[i * 3 + 0];
+			GLuint m1 = triMidpoints[i * 3 + 1];
+			GLuint m2 = triMidpoints[i * 3 + 2];
+
+			GLuint* k = &meshData.Indices[i * 12];
+			k[0] = v0; k[1] = m0; k[2] = m2;
+			k[3] = m0; k[4] = m1; k[5] = m2;
+			k[6] = m2; k[7] = m1; k[8] = v2;
+			k[9] = m0; k[10] = v1; k[11] = m1;
+		}
+	});
 }
 
-/*void GeometryGenerator::CreateGeosphere(float radius, unsigned int numSubdivisions, MeshData& meshData)
+void GeometryGenerator::CreateGeosphere(float radius, unsigned int numSubdivisions, MeshData& meshData)
 {
-	// Put a cap on the number of subdivisions.
-	numSubdivisions = MathHelper::Min(numSubdivisions, 5u);
+	// Put a cap on the number of subdivisions (20 * 4^8 triangles is already ~1.3M).
+	numSubdivisions = glm::min(numSubdivisions, MAX_GEOSPHERE_SUBDIVISIONS);
 
 	// Approximate a sphere by tessellating an icosahedron.
 
 	const float X = 0.525731f;
 	const float Z = 0.850651f;
 
-	XMFLOAT3 pos[12] =
+	glm::vec3 pos[12] =
 	{
-		XMFLOAT3(-X, 0.0f, Z),  XMFLOAT3(X, 0.0f, Z),
-		XMFLOAT3(-X, 0.0f, -Z), XMFLOAT3(X, 0.0f, -Z),
-		XMFLOAT3(0.0f, Z, X),   XMFLOAT3(0.0f, Z, -X),
-		XMFLOAT3(0.0f, -Z, X),  XMFLOAT3(0.0f, -Z, -X),
-		XMFLOAT3(Z, X, 0.0f),   XMFLOAT3(-Z, X, 0.0f),
-		XMFLOAT3(Z, -X, 0.0f),  XMFLOAT3(-Z, -X, 0.0f)
+		glm::vec3(-X, 0.0f, Z),  glm::vec3(X, 0.0f, Z),
+		glm::vec3(-X, 0.0f, -Z), glm::vec3(X, 0.0f, -Z),
+		glm::vec3(0.0f, Z, X),   glm::vec3(0.0f, Z, -X),
+		glm::vec3(0.0f, -Z, X),  glm::vec3(0.0f, -Z, -X),
+		glm::vec3(Z, X, 0.0f),   glm::vec3(-Z, X, 0.0f),
+		glm::vec3(Z, -X, 0.0f),  glm::vec3(-Z, -X, 0.0f)
 	};
 
-	DWORD k[60] =
+	GLuint k[60] =
 	{
 		1,4,0,  4,9,0,  4,5,9,  8,5,4,  1,8,4,
 		1,10,8, 10,3,8, 8,3,5,  3,2,5,  3,7,2,
@@ -561,46 +609,40 @@ void GeometryGenerator::Subdivide(MeshData& meshData)
 		10,1,6, 11,0,9, 2,11,9, 5,2,9,  11,2,7
 	};
 
+	meshData.Topology = GL_TRIANGLES;
 	meshData.Vertices.resize(12);
-	meshData.Indices.resize(60);
+	meshData.Indices.assign(&k[0], &k[60]);
 
-	for (UINT i = 0; i < 12; ++i)
+	for (unsigned int i = 0; i < 12; ++i)
 		meshData.Vertices[i].Position = pos[i];
 
-	for (UINT i = 0; i < 60; ++i)
-		meshData.Indices[i] = k[i];
-
-	for (UINT i = 0; i < numSubdivisions; ++i)
+	// Each level shares its edge midpoints, so V grows as 10 * 4^n + 2 instead of 6x per level.
+	for (unsigned int i = 0; i < numSubdivisions; ++i)
 		Subdivide(meshData);
 
 	// Project vertices onto sphere and scale.
-	for (UINT i = 0; i < meshData.Vertices.size(); ++i)
+	JobSystem::instance().parallelFor(meshData.Vertices.size(), MIN_PER_JOB, [&](size_t begin, size_t end)
 	{
-		// Project onto unit sphere.
-		XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&meshData.Vertices[i].Position));
-
-		// Project onto sphere.
-		XMVECTOR p = radius * n;
-
-		XMStoreFloat3(&meshData.Vertices[i].Position, p);
-		XMStoreFloat3(&meshData.Vertices[i].Normal, n);
+		for (size_t i = begin; i < end; ++i)
+		{
+			Vertex& v = meshData.Vertices[i];
 
-		// Derive texture coordinates from spherical coordinates.
-		float theta = MathHelper::AngleFromXY(
-			meshData.Vertices[i].Position.x,
-			meshData.Vertices[i].Position.z);
+			// Project onto unit sphere.
+			glm::vec3 n = glm::normalize(v.Position);
 
-		float phi = acosf(meshData.Vertices[i].Position.y / radius);
+			// Project onto sphere.
+			v.Position = radius * n;
+			v.Normal = n;
 
-		meshData.Vertices[i].TexC.x = theta / XM_2PI;
-		meshData.Vertices[i].TexC.y = phi / XM_PI;
+			// Derive texture coordinates from spherical coordinates.
+			float theta = atan2f(n.z, n.x);
+			if (theta < 0.0f)
+				theta += 2.0f*PI;
 
-		// Partial derivative of P with respect to theta
-		meshData.Vertices[i].TangentU.x = -radius * sinf(phi)*sinf(theta);
-		meshData.Vertices[i].TangentU.y = 0.0f;
-		meshData.Vertices[i].TangentU.z = +radius * sinf(phi)*cosf(theta);
+			float phi = acosf(glm::clamp(n.y, -1.0f, 1.0f));
 
-		XMVECTOR T = XMLoadFloat3(&meshData.Vertices[i].TangentU);
-		XMStoreFloat3(&meshData.Vertices[i].TangentU, XMVector3Normalize(T));
-	}
-}*/
\ No newline at end of file
+			v.TexC.x = theta / (2.0f*PI);
+			v.TexC.y = phi / PI;
+		}
+	});
+}
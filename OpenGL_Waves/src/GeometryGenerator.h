@@ -41,17 +41,56 @@ public:
 		glm::vec2 TexC;*/
 	};
 
+	// Marks the end of a strip in MeshData::Indices. Drawn with GL_PRIMITIVE_RESTART_FIXED_INDEX,
+	// so it becomes 0xFFFF once the indices are narrowed to 16 bits.
+	static const GLuint RESTART_INDEX = 0xFFFFFFFF;
+
 	struct MeshData
 	{
 		std::vector<Vertex> Vertices;
 		std::vector<GLuint> Indices;
+		GLenum Topology = GL_TRIANGLES;
+
+		// 16-bit indices are used whenever every vertex (and the restart index) fits
+		GLenum IndexType() const
+		{
+			return (Vertices.size() < 0xFFFF) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+		}
+
+		GLsizeiptr IndexBufferSize() const
+		{
+			return Indices.size() * ((IndexType() == GL_UNSIGNED_SHORT) ? sizeof(GLushort) : sizeof(GLuint));
+		}
+
+		// Uploads the indices to the bound GL_ELEMENT_ARRAY_BUFFER using IndexType()
+		void UploadIndices(GLenum usage = GL_STATIC_DRAW) const
+		{
+			if (IndexType() == GL_UNSIGNED_INT)
+			{
+				glBufferData(GL_ELEMENT_ARRAY_BUFFER, IndexBufferSize(), Indices.data(), usage);
+				return;
+			}
+
+			std::vector<GLushort> shortIndices;
+			NarrowIndices(shortIndices);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, IndexBufferSize(), shortIndices.data(), usage);
+		}
+
+		// The indices as they are uploaded when IndexType() is GL_UNSIGNED_SHORT
+		void NarrowIndices(std::vector<GLushort>& shortIndices) const
+		{
+			shortIndices.resize(Indices.size());
+			for (size_t i = 0; i < Indices.size(); ++i)
+				shortIndices[i] = (Indices[i] == RESTART_INDEX) ? (GLushort)0xFFFF : (GLushort)Indices[i];
+		}
 	};
 
 	///<summary>
 	/// Creates an mxn grid in the xz-plane with m rows and n columns, centered
-	/// at the origin with the specified width and depth.
+	/// at the origin with the specified width and depth. With triangleStrip set
+	/// each row pair is emitted as one GL_TRIANGLE_STRIP separated by RESTART_INDEX.
 	///</summary>
-	void CreateGrid(float width, float depth, int m, int n, MeshData& meshData);
+	void CreateGrid(float width, float depth, int m, int n, MeshData& meshData, bool triangleStrip = false);
 
 	///<summary>
 	/// Creates a cylinder parallel to the y-axis, and centered about the origin.  
@@ -68,7 +107,7 @@ public:
 	
 	///<summary>
 	/// Creates a geosphere centered at the origin with the given radius.  The
-	/// depth controls the level of tessellation.
+	/// depth controls the level of tessellation (capped at MAX_GEOSPHERE_SUBDIVISIONS).
 	///</summary>
 	void CreateGeosphere(float radius, unsigned int numSubdivisions, MeshData& meshData);
 
@@ -77,6 +116,8 @@ public:
 	///</summary>
 	void CreateBox(float width, float height, float depth, MeshData& meshData);
 
+	static const unsigned int MAX_GEOSPHERE_SUBDIVISIONS = 8;
+
 private:
 	const float PI = 3.14159265;
 
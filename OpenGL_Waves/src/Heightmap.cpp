@@ -0,0 +1,320 @@
+#include "Heightmap.h"
+
+#include <algorithm>
+#include <cfloat>
+
+// the implementation is compiled in TextureLoader.cpp
+#include "stb_image.h"
+
+const unsigned int Heightmap::MAGIC;
+const unsigned int Heightmap::VERSION;
+const int Heightmap::DEFAULT_TILE_SIZE;
+
+namespace
+{
+	inline GLushort quantize(float height, float minHeight, float maxHeight)
+	{
+		float t = (height - minHeight) / std::max(maxHeight - minHeight, 1e-6f);
+		return (GLushort)(glm::clamp(t, 0.0f, 1.0f) * 65535.0f + 0.5f);
+	}
+
+	bool makeHeader(int width, int height, int tileSize, float spacing, float minHeight, float maxHeight, Heightmap::Header& header)
+	{
+		if (width < 2 || height < 2 || tileSize < 1)
+			return false;
+
+		memset(&header, 0, sizeof(header));
+		header.Magic = Heightmap::MAGIC;
+		header.Version = Heightmap::VERSION;
+		header.Width = width;
+		header.Height = height;
+		header.TileSize = tileSize;
+		header.TilesX = (width - 1 + tileSize - 1) / tileSize;
+		header.TilesZ = (height - 1 + tileSize - 1) / tileSize;
+		header.Spacing = spacing;
+		header.MinHeight = minHeight;
+		header.MaxHeight = maxHeight;
+		return true;
+	}
+}
+
+// Collects rows of samples and writes a row of tiles whenever TileSize + 1 rows are in;
+// the last row of a band is the first row of the next.
+class Heightmap::TileWriter
+{
+public:
+	TileWriter(std::ofstream& file, const Header& header)
+		: file(file), header(header), band((size_t)(header.TileSize + 1) * header.Width), tile(header.tileSamples())
+	{
+	}
+
+	void addRow(const GLushort* row)
+	{
+		std::copy(row, row + header.Width, band.begin() + (size_t)bandRows * header.Width);
+		if (++bandRows == header.TileSize + 1)
+		{
+			flush();
+			std::copy(band.end() - header.Width, band.end(), band.begin());
+			bandRows = 1;
+		}
+	}
+
+	// pads the last band by repeating its bottom row
+	void finish()
+	{
+		if (tileRows >= header.TilesZ)
+			return;
+		while (bandRows < header.TileSize + 1)
+		{
+			std::copy(band.begin() + (size_t)(bandRows - 1) * header.Width, band.begin() + (size_t)bandRows * header.Width, band.begin() + (size_t)bandRows * header.Width);
+			bandRows++;
+		}
+		flush();
+	}
+
+private:
+	std::ofstream& file;
+	const Header& header;
+	std::vector<GLushort> band;
+	std::vector<GLushort> tile;
+	int bandRows = 0;
+	int tileRows = 0;
+
+	void flush()
+	{
+		int edge = header.TileSize + 1;
+		for (int tx = 0; tx < header.TilesX; ++tx)
+		{
+			for (int y = 0; y < edge; ++y)
+			{
+				for (int x = 0; x < edge; ++x)
+				{
+					int sx = std::min(tx * header.TileSize + x, header.Width - 1);
+					tile[(size_t)y * edge + x] = band[(size_t)y * header.Width + sx];
+				}
+			}
+			file.write(reinterpret_cast<const char*>(tile.data()), header.tileBytes());
+		}
+		tileRows++;
+	}
+};
+
+bool Heightmap::ImportPNG(const std::string& path, const std::string& tiledPath, float spacing, float heightScale, int tileSize)
+{
+	int width, height, channels;
+	stbi_us* samples = stbi_load_16(path.c_str(), &width, &height, &channels, 1);
+	if (samples == nullptr)
+	{
+		std::cout << "ERROR::HEIGHTMAP::FILE_NOT_SUCCESFULLY_READ " << path << " (" << stbi_failure_reason() << ")" << std::endl;
+		return false;
+	}
+
+	Header header;
+	std::ofstream file(tiledPath.c_str(), std::ios::binary | std::ios::trunc);
+	bool ok = makeHeader(width, height, tileSize, spacing, 0.0f, heightScale, header) && file;
+	if (ok)
+	{
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		TileWriter writer(file, header);
+		for (int y = 0; y < height; ++y)
+			writer.addRow(samples + (size_t)y * width);
+		writer.finish();
+		ok = (bool)file;
+	}
+	stbi_image_free(samples);
+
+	if (!ok)
+		std::cout << "ERROR::HEIGHTMAP::FILE_NOT_SUCCESFULLY_WRITTEN " << tiledPath << std::endl;
+	return ok;
+}
+
+bool Heightmap::ImportRaw(const std::string& path, int width, int height, RawFormat format, const std::string& tiledPath, float spacing, float heightScale, int tileSize)
+{
+	std::ifstream input(path.c_str(), std::ios::binary);
+	if (!input)
+	{
+		std::cout << "ERROR::HEIGHTMAP::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+		return false;
+	}
+
+	// the size comes from the command line, check it before anything is allocated for it
+	Header header;
+	if (!makeHeader(width, height, tileSize, spacing, 0.0f, heightScale, header))
+	{
+		std::cout << "ERROR::HEIGHTMAP::INVALID_SIZE " << width << "x" << height << std::endl;
+		return false;
+	}
+	input.seekg(0, std::ios::end);
+	unsigned long long fileBytes = (unsigned long long)input.tellg();
+	input.seekg(0);
+	unsigned long long sampleBytes = (format == RAW_R16) ? sizeof(GLushort) : sizeof(float);
+	if ((unsigned long long)width * height * sampleBytes > fileBytes)
+	{
+		std::cout << "ERROR::HEIGHTMAP::FILE_NOT_SUCCESFULLY_READ " << path << " (file smaller than " << width << "x" << height << ")" << std::endl;
+		return false;
+	}
+
+	std::vector<float> floatRow(width);
+	std::vector<GLushort> row(width);
+
+	// float heights are quantized to the range of the whole map, which needs a first pass
+	float minHeight = 0.0f, maxHeight = heightScale;
+	if (format == RAW_R32F)
+	{
+		minHeight = FLT_MAX;
+		maxHeight = -FLT_MAX;
+		for (int y = 0; y < height && input.read(reinterpret_cast<char*>(floatRow.data()), sizeof(float) * width); ++y)
+		{
+			for (int x = 0; x < width; ++x)
+			{
+				minHeight = std::min(minHeight, floatRow[x]);
+				maxHeight = std::max(maxHeight, floatRow[x]);
+			}
+		}
+		input.clear();
+		input.seekg(0);
+	}
+
+	header.MinHeight = minHeight;
+	header.MaxHeight = maxHeight;
+	std::ofstream file(tiledPath.c_str(), std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		std::cout << "ERROR::HEIGHTMAP::FILE_NOT_SUCCESFULLY_WRITTEN " << tiledPath << std::endl;
+		return false;
+	}
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	TileWriter writer(file, header);
+	for (int y = 0; y < height; ++y)
+	{
+		if (format == RAW_R16)
+		{
+			input.read(reinterpret_cast<char*>(row.data()), sizeof(GLushort) * width);
+		}
+		else
+		{
+			input.read(reinterpret_cast<char*>(floatRow.data()), sizeof(float) * width);
+			for (int x = 0; x < width; ++x)
+				row[x] = quantize(floatRow[x], minHeight, maxHeight);
+		}
+		if (!input)
+		{
+			std::cout << "ERROR::HEIGHTMAP::FILE_NOT_SUCCESFULLY_READ " << path << " (file smaller than " << width << "x" << height << ")" << std::endl;
+			return false;
+		}
+		writer.addRow(row.data());
+	}
+	writer.finish();
+	return (bool)file;
+}
+
+bool Heightmap::ExportRaw(const std::string& tiledPath, const std::string& path, RawFormat format)
+{
+	std::ifstream input(tiledPath.c_str(), std::ios::binary);
+	Header header;
+	if (!input || !ReadHeader(input, header))
+	{
+		std::cout << "ERROR::HEIGHTMAP::FILE_NOT_SUCCESFULLY_READ " << tiledPath << std::endl;
+		return false;
+	}
+
+	std::ofstream output(path.c_str(), std::ios::binary | std::ios::trunc);
+	if (!output)
+	{
+		std::cout << "ERROR::HEIGHTMAP::FILE_NOT_SUCCESFULLY_WRITTEN " << path << std::endl;
+		return false;
+	}
+
+	// one row of tiles is resident at a time
+	int edge = header.TileSize + 1;
+	std::vector<GLushort> tiles(header.tileSamples() * header.TilesX);
+	std::vector<GLushort> row(header.Width);
+	std::vector<float> floatRow(header.Width);
+	float range = header.MaxHeight - header.MinHeight;
+
+	for (int tz = 0; tz < header.TilesZ; ++tz)
+	{
+		for (int tx = 0; tx < header.TilesX; ++tx)
+		{
+			if (!ReadTile(input, header, tx, tz, &tiles[header.tileSamples() * tx]))
+				return false;
+		}
+
+		// the shared bottom row is written by the next tile row, except for the last one
+		int rows = (tz == header.TilesZ - 1) ? std::min(edge, header.Height - tz * header.TileSize) : header.TileSize;
+		for (int y = 0; y < rows; ++y)
+		{
+			for (int x = 0; x < header.Width; ++x)
+			{
+				int tx = std::min(x / header.TileSize, header.TilesX - 1);
+				int local = x - tx * header.TileSize;
+				row[x] = tiles[header.tileSamples() * tx + (size_t)y * edge + local];
+				floatRow[x] = header.MinHeight + range * (row[x] / 65535.0f);
+			}
+			if (format == RAW_R16)
+				output.write(reinterpret_cast<const char*>(row.data()), sizeof(GLushort) * header.Width);
+			else
+				output.write(reinterpret_cast<const char*>(floatRow.data()), sizeof(float) * header.Width);
+		}
+	}
+	return (bool)output;
+}
+
+bool Heightmap::ExportTiled(const float* heights, int width, int height, const std::string& tiledPath, float spacing, int tileSize)
+{
+	float minHeight = FLT_MAX, maxHeight = -FLT_MAX;
+	for (size_t i = 0; i < (size_t)width * height; ++i)
+	{
+		minHeight = std::min(minHeight, heights[i]);
+		maxHeight = std::max(maxHeight, heights[i]);
+	}
+
+	Header header;
+	std::ofstream file(tiledPath.c_str(), std::ios::binary | std::ios::trunc);
+	if (!makeHeader(width, height, tileSize, spacing, minHeight, maxHeight, header) || !file)
+	{
+		std::cout << "ERROR::HEIGHTMAP::FILE_NOT_SUCCESFULLY_WRITTEN " << tiledPath << std::endl;
+		return false;
+	}
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	TileWriter writer(file, header);
+	std::vector<GLushort> row(width);
+	for (int y = 0; y < height; ++y)
+	{
+		for (int x = 0; x < width; ++x)
+			row[x] = quantize(heights[(size_t)y * width + x], minHeight, maxHeight);
+		writer.addRow(row.data());
+	}
+	writer.finish();
+	return (bool)file;
+}
+
+bool Heightmap::ReadHeader(std::ifstream& file, Header& header)
+{
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	return file && header.Magic == MAGIC && header.Version == VERSION && header.TileSize > 0 && header.TilesX > 0 && header.TilesZ > 0;
+}
+
+bool Heightmap::ReadTile(std::ifstream& file, const Header& header, int tileX, int tileZ, GLushort* out)
+{
+	std::streamoff offset = (std::streamoff)sizeof(Header) + ((std::streamoff)tileZ * header.TilesX + tileX) * (std::streamoff)header.tileBytes();
+	file.seekg(offset);
+	file.read(reinterpret_cast<char*>(out), header.tileBytes());
+	return (bool)file;
+}
+
+bool Heightmap::FormatFromPath(const std::string& path, RawFormat& format)
+{
+	std::string extension = path.substr(path.find_last_of('.') + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+	if (extension == "r16" || extension == "raw")
+		format = RAW_R16;
+	else if (extension == "r32")
+		format = RAW_R32F;
+	else
+		return false;
+	return true;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#ifndef HEIGHTMAP_H
+#define HEIGHTMAP_H
+
+#include "GL_Util.h"
+
+#include <fstream>
+
+// Heightmap import/export and the tiled layout TerrainStreamer reads from.
+//
+// A tiled file is a header followed by fixed size tiles in row major order, so any tile
+// can be read with one seek. Each tile holds (TileSize + 1)^2 UNORM16 samples mapped to
+// [MinHeight, MaxHeight]; neighbouring tiles share their edge row/column so they meet
+// without seams. Tiles past the edge of the map repeat the last sample.
+//
+// Raw inputs are converted a band of tile rows at a time, so maps larger than memory can
+// be imported. PNGs are decoded whole by stb_image.
+class Heightmap
+{
+public:
+	enum RawFormat
+	{
+		RAW_R16,	// little endian unsigned 16 bit, scaled by heightScale
+		RAW_R32F	// 32 bit float heights in world units
+	};
+
+	struct Header
+	{
+		unsigned int Magic;
+		unsigned int Version;
+		int Width;			// samples
+		int Height;
+		int TileSize;		// quads per tile edge
+		int TilesX;
+		int TilesZ;
+		float Spacing;		// world units between samples
+		float MinHeight;
+		float MaxHeight;
+		unsigned int Reserved[6];
+
+		size_t tileSamples() const { return (size_t)(TileSize + 1) * (TileSize + 1); }
+		size_t tileBytes() const { return tileSamples() * sizeof(GLushort); }
+	};
+
+	static const unsigned int MAGIC = 0x4C495448;	// "HTIL"
+	static const unsigned int VERSION = 1;
+	static const int DEFAULT_TILE_SIZE = 128;
+
+	///<summary>
+	/// Imports a 16-bit (or 8-bit) greyscale PNG, heights are sample / 65535 * heightScale.
+	///</summary>
+	static bool ImportPNG(const std::string& path, const std::string& tiledPath, float spacing, float heightScale, int tileSize = DEFAULT_TILE_SIZE);
+
+	///<summary>
+	/// Imports a headerless raw file of width x height samples. R32F files are read twice,
+	/// once for the height range and once to write the tiles.
+	///</summary>
+	static bool ImportRaw(const std::string& path, int width, int height, RawFormat format, const std::string& tiledPath, float spacing, float heightScale, int tileSize = DEFAULT_TILE_SIZE);
+
+	///<summary>
+	/// Writes a tiled file back out as one raw image, one row of tiles at a time.
+	///</summary>
+	static bool ExportRaw(const std::string& tiledPath, const std::string& path, RawFormat format);
+
+	///<summary>
+	/// Writes width x height heights (row major, world units) as a tiled file.
+	///</summary>
+	static bool ExportTiled(const float* heights, int width, int height, const std::string& tiledPath, float spacing, int tileSize = DEFAULT_TILE_SIZE);
+
+	static bool ReadHeader(std::ifstream& file, Header& header);
+
+	// reads one tile into out, which must hold header.tileSamples() values
+	static bool ReadTile(std::ifstream& file, const Header& header, int tileX, int tileZ, GLushort* out);
+
+	// raw format from the extension: .r16 / .raw are RAW_R16, .r32 is RAW_R32F
+	static bool FormatFromPath(const std::string& path, RawFormat& format);
+
+private:
+	class TileWriter;
+};
+
+#endif // HEIGHTMAP_H
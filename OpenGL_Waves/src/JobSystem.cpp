@@ -0,0 +1,355 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+// either a Work or, for parallelFor, a range of a RangeWork that outlives the job
+struct JobSystem::Job
+{
+	Work Task;
+	const RangeWork* Range;
+	size_t Begin;
+	size_t End;
+	Counter* Done;
+};
+
+namespace
+{
+	// index of the deque owned by this thread, -1 outside the pool
+	thread_local int localDeque = -1;
+
+	// empty polls before an idle worker goes to sleep
+	const unsigned int SPIN_COUNT = 64;
+
+	// ranges per thread in parallelFor, a few more than one so stolen ranges balance out
+	const size_t RANGES_PER_THREAD = 4;
+
+	unsigned int NextVictim(unsigned int& seed)
+	{
+		seed = seed * 1103515245u + 12345u;
+		return seed >> 16;
+	}
+}
+
+bool JobSystem::WorkDeque::push(Job* job)
+{
+	long long b = bottom.load(std::memory_order_relaxed);
+	long long t = top.load(std::memory_order_acquire);
+	if (b - t >= CAPACITY)
+		return false;
+
+	ring[b & (CAPACITY - 1)].store(job, std::memory_order_relaxed);
+	bottom.store(b + 1, std::memory_order_release);
+	return true;
+}
+
+JobSystem::Job* JobSystem::WorkDeque::pop()
+{
+	long long b = bottom.load(std::memory_order_relaxed) - 1;
+	bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	long long t = top.load(std::memory_order_relaxed);
+
+	if (t > b)
+	{
+		// empty
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	Job* job = ring[b & (CAPACITY - 1)].load(std::memory_order_relaxed);
+	if (t == b)
+	{
+		// last job, race the thieves for it
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			job = nullptr;
+		bottom.store(b + 1, std::memory_order_relaxed);
+	}
+	return job;
+}
+
+JobSystem::Job* JobSystem::WorkDeque::steal()
+{
+	long long t = top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	long long b = bottom.load(std::memory_order_acquire);
+	if (t >= b)
+		return nullptr;
+
+	Job* job = ring[t & (CAPACITY - 1)].load(std::memory_order_relaxed);
+	if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		return nullptr;
+	return job;
+}
+
+JobSystem::JobSystem()
+	: running(false), sharedCount(0), queued(0), sleeping(0)
+{
+}
+
+JobSystem::~JobSystem()
+{
+	shutdown();
+}
+
+JobSystem& JobSystem::instance()
+{
+	static JobSystem system;
+	return system;
+}
+
+void JobSystem::init(unsigned int workerCount)
+{
+	shutdown();
+
+	if (workerCount == 0)
+	{
+		unsigned int cores = std::thread::hardware_concurrency();
+		workerCount = (cores > 1) ? cores - 1 : 0;
+	}
+
+	for (unsigned int i = 0; i <= workerCount; ++i)
+		deques.push_back(new WorkDeque());
+	localDeque = 0;
+
+	running = true;
+	for (unsigned int i = 1; i <= workerCount; ++i)
+		workers.push_back(std::thread(&JobSystem::workerLoop, this, i));
+}
+
+void JobSystem::shutdown()
+{
+	if (deques.empty())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		running = false;
+	}
+	wake.notify_all();
+	for (size_t i = 0; i < workers.size(); ++i)
+		workers[i].join();
+	workers.clear();
+
+	// everything submitted has been waited on by now, whatever is left is run here
+	for (size_t i = 0; i < deques.size(); ++i)
+	{
+		while (Job* job = deques[i]->steal())
+			execute(job);
+		delete deques[i];
+	}
+	deques.clear();
+	while (!shared.empty())
+	{
+		execute(shared.front());
+		shared.pop_front();
+	}
+	sharedCount = 0;
+	queued = 0;
+	localDeque = -1;
+}
+
+JobSystem::Job* JobSystem::newJob(Counter* done)
+{
+	Job* job;
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		job = jobPool.create();
+	}
+	job->Range = nullptr;
+	job->Done = done;
+	if (done)
+		done->pending.fetch_add(1, std::memory_order_relaxed);
+	return job;
+}
+
+void JobSystem::run(const Work& work, Counter* done, Counter* after)
+{
+	Job* job = newJob(done);
+	job->Task = work;
+
+	if (after)
+	{
+		std::lock_guard<std::mutex> lock(after->mutex);
+		if (after->pending.load(std::memory_order_acquire) != 0)
+		{
+			after->continuations.push_back(job);
+			return;
+		}
+	}
+	submit(job);
+}
+
+void JobSystem::submit(Job* job)
+{
+	// not started, everything runs on the calling thread
+	if (deques.empty())
+	{
+		execute(job);
+		return;
+	}
+
+	int local = localDeque;
+	if (local >= 0)
+	{
+		if (!deques[local]->push(job))
+		{
+			// a full deque means there is plenty of parallel work already
+			execute(job);
+			return;
+		}
+	}
+	else
+	{
+		std::lock_guard<std::mutex> lock(sharedMutex);
+		shared.push_back(job);
+		sharedCount.fetch_add(1);
+	}
+
+	queued.fetch_add(1);
+	if (sleeping.load() > 0)
+	{
+		// taking the lock orders this with a worker that is just about to sleep
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		wake.notify_one();
+	}
+}
+
+JobSystem::Job* JobSystem::find(unsigned int& seed)
+{
+	if (deques.empty())
+		return nullptr;
+
+	Job* job = nullptr;
+	int local = localDeque;
+	if (local >= 0)
+		job = deques[local]->pop();
+
+	if (job == nullptr && sharedCount.load() > 0)
+	{
+		std::lock_guard<std::mutex> lock(sharedMutex);
+		if (!shared.empty())
+		{
+			job = shared.front();
+			shared.pop_front();
+			sharedCount.fetch_sub(1);
+		}
+	}
+
+	if (job == nullptr)
+	{
+		unsigned int count = (unsigned int)deques.size();
+		unsigned int start = NextVictim(seed) % count;
+		for (unsigned int i = 0; i < count && job == nullptr; ++i)
+		{
+			unsigned int victim = (start + i) % count;
+			if ((int)victim != local)
+				job = deques[victim]->steal();
+		}
+	}
+
+	if (job)
+		queued.fetch_sub(1);
+	return job;
+}
+
+void JobSystem::execute(Job* job)
+{
+	if (job->Range)
+		(*job->Range)(job->Begin, job->End);
+	else
+		job->Task();
+
+	Counter* done = job->Done;
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		jobPool.destroy(job);
+	}
+	if (done)
+		finish(done);
+}
+
+void JobSystem::finish(Counter* counter)
+{
+	// the decrement happens under the lock so wait() can tell when finish() is done with it
+	std::vector<Job*> ready;
+	{
+		std::lock_guard<std::mutex> lock(counter->mutex);
+		if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			ready.swap(counter->continuations);
+	}
+	for (size_t i = 0; i < ready.size(); ++i)
+		submit(ready[i]);
+}
+
+void JobSystem::wait(Counter& counter)
+{
+	unsigned int seed = (unsigned int)(size_t)&counter;
+	while (counter.pending.load(std::memory_order_acquire) != 0)
+	{
+		Job* job = find(seed);
+		if (job)
+			execute(job);
+		else
+			std::this_thread::yield();
+	}
+
+	// the last finish() may still hold the lock, the counter usually lives on the caller's stack
+	std::lock_guard<std::mutex> lock(counter.mutex);
+}
+
+void JobSystem::parallelFor(size_t count, size_t minPerJob, const RangeWork& body)
+{
+	if (count == 0)
+		return;
+
+	size_t jobs = std::min(count / std::max<size_t>(1, minPerJob), (size_t)threadCount() * RANGES_PER_THREAD);
+	if (jobs <= 1 || threadCount() <= 1)
+	{
+		body(0, count);
+		return;
+	}
+
+	size_t chunk = (count + jobs - 1) / jobs;
+	Counter counter;
+	for (size_t begin = chunk; begin < count; begin += chunk)
+	{
+		// the range is stored in the job itself, wrapping it in a Work could allocate
+		Job* job = newJob(&counter);
+		job->Range = &body;
+		job->Begin = begin;
+		job->End = std::min(count, begin + chunk);
+		submit(job);
+	}
+	body(0, std::min(count, chunk));
+	wait(counter);
+}
+
+void JobSystem::workerLoop(unsigned int index)
+{
+	localDeque = (int)index;
+	unsigned int seed = index * 7919u + 1u;
+	unsigned int idle = 0;
+
+	while (running.load(std::memory_order_acquire))
+	{
+		Job* job = find(seed);
+		if (job)
+		{
+			execute(job);
+			idle = 0;
+			continue;
+		}
+
+		if (++idle < SPIN_COUNT)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		sleeping.fetch_add(1);
+		wake.wait(lock, [this] { return !running || queued.load() > 0; });
+		sleeping.fetch_sub(1);
+		idle = 0;
+	}
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ObjectPool.h"
+
+// Fixed size work stealing thread pool. Every worker, and the thread that called init(),
+// owns a lock free Chase-Lev deque: it pushes and pops its own jobs at the bottom while idle
+// workers steal from the top. Other threads (the texture decoders, the shader compiler)
+// submit through a shared queue. Waiting on a Counter runs jobs instead of blocking, so
+// nested parallel loops cannot deadlock the pool.
+class JobSystem
+{
+	struct Job;
+
+public:
+	// Counts unfinished jobs. Jobs can be made to start only once a counter reaches zero,
+	// which is how dependencies between batches are expressed.
+	class Counter
+	{
+	public:
+		Counter() : pending(0) {}
+
+		bool isDone() const { return pending.load(std::memory_order_acquire) == 0; }
+
+	private:
+		friend class JobSystem;
+
+		std::atomic<int> pending;
+		std::mutex mutex;						// guards continuations only
+		std::vector<Job*> continuations;		// started when pending reaches zero
+
+		Counter(const Counter&);
+		Counter& operator=(const Counter&);
+	};
+
+	typedef std::function<void()> Work;
+	typedef std::function<void(size_t, size_t)> RangeWork;
+
+	static JobSystem& instance();
+
+	///<summary>
+	/// Starts workerCount threads, 0 picks one per core besides the calling thread. The
+	/// calling thread becomes a member of the pool: it runs jobs while it waits.
+	///</summary>
+	void init(unsigned int workerCount = 0);
+	void shutdown();
+
+	// threads that run jobs, the caller of init() included; 1 when not started
+	unsigned int threadCount() const { return deques.empty() ? 1 : (unsigned int)deques.size(); }
+
+	///<summary>
+	/// Queues work. done (optional) is incremented now and decremented when the work has
+	/// run; after (optional) holds the work back until that counter reaches zero.
+	///</summary>
+	void run(const Work& work, Counter* done = nullptr, Counter* after = nullptr);
+
+	///<summary>
+	/// Runs jobs until the counter reaches zero.
+	///</summary>
+	void wait(Counter& counter);
+
+	///<summary>
+	/// Splits [0, count) into ranges of at least minPerJob and runs body over them on the
+	/// pool, returning once all are done. The calling thread takes the first range.
+	///</summary>
+	void parallelFor(size_t count, size_t minPerJob, const RangeWork& body);
+
+private:
+	// Chase-Lev deque with a fixed ring; push fails when it is full and the caller runs the job
+	class WorkDeque
+	{
+	public:
+		enum { CAPACITY = 4096 };
+
+		WorkDeque() : top(0), bottom(0)
+		{
+			for (unsigned int i = 0; i < CAPACITY; ++i)
+				ring[i].store(nullptr, std::memory_order_relaxed);
+		}
+
+		bool push(Job* job);	// owner only
+		Job* pop();				// owner only
+		Job* steal();			// any thread
+
+	private:
+		std::atomic<long long> top;
+		std::atomic<long long> bottom;
+		std::atomic<Job*> ring[CAPACITY];
+	};
+
+	std::vector<WorkDeque*> deques;			// [0] belongs to the thread that called init()
+	std::vector<std::thread> workers;
+	std::atomic<bool> running;
+
+	std::mutex sharedMutex;					// submissions from threads outside the pool
+	std::deque<Job*> shared;
+	std::atomic<int> sharedCount;			// lets find() skip the lock while shared is empty
+
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	std::atomic<int> queued;				// jobs pushed and not yet taken
+	std::atomic<int> sleeping;
+
+	std::mutex poolMutex;
+	ObjectPool<Job> jobPool;				// so queueing work does not go to the heap
+
+	JobSystem();
+	~JobSystem();
+
+	void workerLoop(unsigned int index);
+	Job* newJob(Counter* done);
+	void submit(Job* job);
+	Job* find(unsigned int& seed);
+	void execute(Job* job);
+	void finish(Counter* counter);
+};
+
+#endif // JOBSYSTEM_H
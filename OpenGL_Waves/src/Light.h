@@ -4,6 +4,9 @@
 #define LIGHT_H
 
 #include "GL_Util.h"
+#include "MeshLOD.h"
+#include "FrameSnapshot.h"
+#include "ShaderLibrary.h"
 
 class Light
 {
@@ -21,8 +24,6 @@ public:
 
 	~Light()
 	{
-		glDeleteVertexArrays(1, &lightVAO);
-		glDeleteBuffers(1, &lightVBO);
 	}
 
 	void init(glm::vec3 lightPos)
@@ -35,47 +36,31 @@ public:
 		code.fragmentCode = lightFragmentShaderSource;
 		lightShader = Shader(code);
 
-		GeometryGenerator geoGen = GeometryGenerator();
-		geoGen.CreateSphere(0.5f, 20, 20, light);
-
-		// create player VAO
-		glGenVertexArrays(1, &lightVAO);
-		glGenBuffers(1, &lightVBO);
-		glGenBuffers(1, &lightEBO);
-		glBindVertexArray(lightVAO);
-
-		glBindBuffer(GL_ARRAY_BUFFER, lightVBO);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(GeometryGenerator::Vertex) * light.Vertices.size(), light.Vertices.data(), GL_STATIC_DRAW);
-
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lightEBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * light.Indices.size(), light.Indices.data(), GL_STATIC_DRAW);
+		// geosphere subdivision levels, the shader only reads positions so the chain is packed
+		lightLOD.init("light", { 20.0f, 6.0f, 0.0f }, [](unsigned int level, GeometryGenerator::MeshData& mesh)
+		{
+			const unsigned int subdivisions[] = { 2, 1, 0 };
+			GeometryGenerator geoGen;
+			geoGen.CreateGeosphere(0.5f, subdivisions[level], mesh);
+		}, true);
+	}
 
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)0);
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)(6 * sizeof(GLfloat)));
-		glBindVertexArray(0);
+	// picks the marker's LOD level, runs in the simulation phase
+	void simulate(const Camera& camera, FrameSnapshot& frame) const
+	{
+		frame.LightMarker.Model = glm::translate(glm::mat4(), lightPos);
+		frame.LightMarker.Level = lightLOD.selectLevel(lightPos, camera, frame.ScreenHeight);
 	}
 
-	void update(GLFWwindow* window, Camera camera, float deltaTime, unsigned int SCR_WIDTH, unsigned int SCR_HEIGHT)
+	void render(const FrameSnapshot& frame)
 	{
 		// ativate shader program
 		lightShader.use();
 
-		// pass projection matrix to shader (note that in this case it could change every frame)
-		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-		lightShader.setMat4("projection", projection);
-
-		// pass camera/view transformation matrix to shader 
-		glm::mat4 view = camera.GetViewMatrix();
-		lightShader.setMat4("view", view);
-
-		// pass model matrix to shader 
-		glm::mat4 model = glm::mat4();
-		model = glm::translate(model, lightPos);
-		lightShader.setMat4("model", model);
+		// pass projection, camera/view and model matrices to shader
+		lightShader.setMat4("projection", frame.Projection);
+		lightShader.setMat4("view", frame.View);
+		lightShader.setMat4("model", frame.LightMarker.Model);
 
 		// set grid color
 		glm::vec4 black = glm::vec4(0, 0, 0, 1);
@@ -85,18 +70,16 @@ public:
 		GLenum GL_RENDER_MODE = GL_TRIANGLES;	// GL_LINES or GL_TRIANGLES
 
 		// bind and draw grid element buffer
-		glBindVertexArray(lightVAO);
 		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-		glDrawElements(GL_RENDER_MODE, light.Indices.size(), GL_UNSIGNED_INT, 0);
+		lightLOD.draw(frame.LightMarker.Level, GL_RENDER_MODE);
 	}
 
 	// TODO: Move to static light Handler
-	void setLightingUniforms(Shader* shader, std::vector<glm::vec3> pointLightPositions, Camera camera)
+	void setLightingUniforms(const Shader& lightingShader, const FrameSnapshot& frame)
 	{
-		Shader lightingShader = *shader;
-		//Camera camera = *cam;
+		const std::vector<glm::vec3>& pointLightPositions = frame.PointLights;
 
-		lightingShader.setVec3("viewPos", camera.Position);
+		lightingShader.setVec3("viewPos", frame.CameraPosition);
 		lightingShader.setFloat("material.shininess", 32.0f);
 
 		// directional light
@@ -105,22 +88,19 @@ public:
 		lightingShader.setVec3("dirLight.diffuse", 0.4f, 0.4f, 0.4f);
 		lightingShader.setVec3("dirLight.specular", 0.5f, 0.5f, 0.5f);
 		// point lights
-		for (int i = 0; i < pointLightPositions.size(); i++)
+		for (unsigned int i = 0; i < pointLightPositions.size(); i++)
 		{
-			std::string pointLightNum = "pointLights[" + std::to_string(i);
-			std::string test = std::string(pointLightNum + "].position");
-			
-			lightingShader.setVec3(std::string(pointLightNum + "].position"), pointLightPositions[i]);
-			lightingShader.setVec3(std::string(pointLightNum + "].ambient"), 0.05f, 0.05f, 0.05f);
-			lightingShader.setVec3(std::string(pointLightNum + "].diffuse"), 0.8f, 0.8f, 0.8f);
-			lightingShader.setVec3(std::string(pointLightNum + "].specular"), 1.0f, 1.0f, 1.0f);
-			lightingShader.setFloat(std::string(pointLightNum + "].constant"), 1.0f);
-			lightingShader.setFloat(std::string(pointLightNum + "].linear"), 0.09);
-			lightingShader.setFloat(std::string(pointLightNum + "].quadratic"), 0.032);
+			lightingShader.setVec3(ShaderLibrary::pointLightUniform(i, ShaderLibrary::POINT_LIGHT_POSITION), pointLightPositions[i]);
+			lightingShader.setVec3(ShaderLibrary::pointLightUniform(i, ShaderLibrary::POINT_LIGHT_AMBIENT), 0.05f, 0.05f, 0.05f);
+			lightingShader.setVec3(ShaderLibrary::pointLightUniform(i, ShaderLibrary::POINT_LIGHT_DIFFUSE), 0.8f, 0.8f, 0.8f);
+			lightingShader.setVec3(ShaderLibrary::pointLightUniform(i, ShaderLibrary::POINT_LIGHT_SPECULAR), 1.0f, 1.0f, 1.0f);
+			lightingShader.setFloat(ShaderLibrary::pointLightUniform(i, ShaderLibrary::POINT_LIGHT_CONSTANT), 1.0f);
+			lightingShader.setFloat(ShaderLibrary::pointLightUniform(i, ShaderLibrary::POINT_LIGHT_LINEAR), 0.09);
+			lightingShader.setFloat(ShaderLibrary::pointLightUniform(i, ShaderLibrary::POINT_LIGHT_QUADRATIC), 0.032);
 		}
 		// spotLight
-		lightingShader.setVec3("spotLight.position", camera.Position);
-		lightingShader.setVec3("spotLight.direction", camera.Front);
+		lightingShader.setVec3("spotLight.position", frame.CameraPosition);
+		lightingShader.setVec3("spotLight.direction", frame.CameraFront);
 		lightingShader.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
 		lightingShader.setVec3("spotLight.diffuse", 1.0f, 1.0f, 1.0f);
 		lightingShader.setVec3("spotLight.specular", 1.0f, 1.0f, 1.0f);
@@ -180,8 +160,7 @@ public:
 private:
 	Shader lightShader;
 
-	GeometryGenerator::MeshData light;
-	GLuint lightVAO, lightVBO, lightEBO;
+	MeshLOD lightLOD;
 
 	glm::vec3 lightPos = glm::vec3(0.0f, 0.5f, 0.0f);
 
@@ -5,6 +5,7 @@
 
 #include "GL_Util.h"
 #include "Light.h"
+#include "ShaderLibrary.h"
 
 class LightingHandler
 {
@@ -90,11 +91,8 @@ public:
 	}
 
 	// TODO: Move to static light Handler
-	void setLightingUniforms(Shader* shader, std::vector<glm::vec3> pointLightPositions, Camera* cam)
+	void setLightingUniforms(const Shader& lightingShader, const Camera& camera)
 	{
-		Shader lightingShader = *shader;
-		Camera camera = *cam;
-
 		lightingShader.setVec3("viewPos", camera.Position);
 		lightingShader.setFloat("material.shininess", 32.0f);
 
@@ -112,17 +110,16 @@ public:
 		}
 
 		// point lights
-		for (int i = 0; i < sceneLights.pointLights.size(); i++)
+		for (unsigned int i = 0; i < sceneLights.pointLights.size(); i++)
 		{
-			std::string pointLight_ = "pointLights[" + std::to_string(i);
-
-			lightingShader.setVec3(std::string(pointLight_ + "].position"), sceneLights.pointLights[i].position);
-			lightingShader.setVec3(std::string(pointLight_ + "].ambient"), sceneLights.pointLights[i].ambient);
-			lightingShader.setVec3(std::string(pointLight_ + "].diffuse"), sceneLights.pointLights[i].diffuse);
-			lightingShader.setVec3(std::string(pointLight_ + "].specular"), sceneLights.pointLights[i].specular);
-			lightingShader.setFloat(std::string(pointLight_ + "].constant"), sceneLights.pointLights[i].constant);
-			lightingShader.setFloat(std::string(pointLight_ + "].linear"), sceneLights.pointLights[i].linear);
-			lightingShader.setFloat(std::string(pointLight_ + "].quadratic"), sceneLights.pointLights[i].quadratic);
+			const PointLight& light = sceneLights.pointLights[i];
+			lightingShader.setVec3(ShaderLibrary::pointLightUniform(i, ShaderLibrary::POINT_LIGHT_POSITION), light.position);
+			lightingShader.setVec3(ShaderLibrary::pointLightUniform(i, ShaderLibrary::POINT_LIGHT_AMBIENT), light.ambient);
+			lightingShader.setVec3(ShaderLibrary::pointLightUniform(i, ShaderLibrary::POINT_LIGHT_DIFFUSE), light.diffuse);
+			lightingShader.setVec3(ShaderLibrary::pointLightUniform(i, ShaderLibrary::POINT_LIGHT_SPECULAR), light.specular);
+			lightingShader.setFloat(ShaderLibrary::pointLightUniform(i, ShaderLibrary::POINT_LIGHT_CONSTANT), light.constant);
+			lightingShader.setFloat(ShaderLibrary::pointLightUniform(i, ShaderLibrary::POINT_LIGHT_LINEAR), light.linear);
+			lightingShader.setFloat(ShaderLibrary::pointLightUniform(i, ShaderLibrary::POINT_LIGHT_QUADRATIC), light.quadratic);
 		}
 
 		// spotLight
@@ -145,15 +142,13 @@ public:
 		}
 	}
 
-	void updateMainSpotLight(Camera* cam)
+	void updateMainSpotLight(const Camera& camera)
 	{
-		Camera camera = *cam;
-		
 		sceneLights.spotLights[0].position = camera.Position;
 		sceneLights.spotLights[0].direction = camera.Front;
 	}
 
-	void createDefaultLights(Camera camera)
+	void createDefaultLights(const Camera& camera)
 	{
 		//Camera camera = *cam;
 		
@@ -205,7 +200,7 @@ public:
 		addSpotLight(sl);
 	}
 
-	SceneLights getSceneLights()
+	const SceneLights& getSceneLights() const
 	{
 		return sceneLights;
 	}
@@ -215,17 +210,17 @@ public:
 		Light light(PointLight(lightPos));
 	}
 
-	void addPointLight(PointLight pl)
+	void addPointLight(const PointLight& pl)
 	{
 		sceneLights.pointLights.push_back(pl);
 	}
 
-	void addDirLight(DirLight dl)
+	void addDirLight(const DirLight& dl)
 	{
 		sceneLights.dirLights.push_back(dl);
 	}
 
-	void addSpotLight(SpotLight sl)
+	void addSpotLight(const SpotLight& sl)
 	{
 		sceneLights.spotLights.push_back(sl);
 	}
@@ -0,0 +1,208 @@
+#pragma once
+
+#ifndef MESHLOD_H
+#define MESHLOD_H
+
+#include "GL_Util.h"
+#include "VertexPacking.h"
+#include "MeshOptimizer.h"
+#include "AssetPack.h"
+
+#include <functional>
+#include <limits>
+
+// A chain of tessellations of one primitive, highest detail first. Every frame the
+// level is picked from the radius the bounding sphere covers on screen. Built levels are
+// kept in the AssetPack as upload ready vertex and index buffers.
+class MeshLOD
+{
+public:
+	struct Level
+	{
+		GLuint VAO = 0, VBO = 0, EBO = 0;
+		GLsizei IndexCount = 0;
+		GLenum IndexType = GL_UNSIGNED_SHORT;
+		float MinPixelRadius = 0.0f;	// used while the projected radius is at least this big
+	};
+
+	// builds level i into the mesh, called once per entry of pixelThresholds
+	typedef std::function<void(unsigned int, GeometryGenerator::MeshData&)> LevelBuilder;
+
+	MeshLOD() {}
+
+	~MeshLOD()
+	{
+		for (size_t i = 0; i < levels.size(); ++i)
+		{
+			glDeleteVertexArrays(1, &levels[i].VAO);
+			glDeleteBuffers(1, &levels[i].VBO);
+			glDeleteBuffers(1, &levels[i].EBO);
+		}
+	}
+
+	///<summary>
+	/// Builds and uploads the chain. pixelThresholds must be descending, the last entry is
+	/// normally 0 so the coarsest level is used for anything smaller. Packed chains use
+	/// VertexPacking::PackedVertex (position only shaders), otherwise the full float Vertex.
+	/// Levels found in the AssetPack are uploaded from it without calling build.
+	///</summary>
+	void init(const std::string& name, const std::vector<float>& pixelThresholds, const LevelBuilder& build, bool packed)
+	{
+		MeshOptimizer meshOptimizer;
+		MeshOptimizer::Report report;
+		AssetPack& pack = AssetPack::instance();
+
+		levels.resize(pixelThresholds.size());
+		boundingRadius = 0.0f;
+
+		for (unsigned int i = 0; i < levels.size(); ++i)
+		{
+			Level& level = levels[i];
+			level.MinPixelRadius = pixelThresholds[i];
+
+			glGenVertexArrays(1, &level.VAO);
+			glGenBuffers(1, &level.VBO);
+			glGenBuffers(1, &level.EBO);
+			glBindVertexArray(level.VAO);
+			glBindBuffer(GL_ARRAY_BUFFER, level.VBO);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, level.EBO);
+
+			std::string section = "mesh/" + name + "/lod" + std::to_string(i);
+			AssetPack::Section vertices, indices;
+			if (pack.find(section + "/vb", vertices) && pack.find(section + "/ib", indices) && AssetPack::info<PackInfo>(vertices).Packed == (packed ? 1u : 0u))
+			{
+				// the driver copies straight out of the mapped file
+				PackInfo info = AssetPack::info<PackInfo>(vertices);
+				glBufferData(GL_ARRAY_BUFFER, vertices.Size, vertices.Data, GL_STATIC_DRAW);
+				glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.Size, indices.Data, GL_STATIC_DRAW);
+				level.IndexCount = (GLsizei)info.IndexCount;
+				level.IndexType = info.IndexType;
+				boundingRadius = glm::max(boundingRadius, info.BoundingRadius);
+			}
+			else
+			{
+				GeometryGenerator::MeshData mesh;
+				build(i, mesh);
+
+				meshOptimizer.Optimize(mesh, &report);
+				meshOptimizer.LogReport(name + " LOD" + std::to_string(i), report);
+
+				PackInfo info;
+				info.Packed = packed ? 1u : 0u;
+				info.IndexCount = (unsigned int)mesh.Indices.size();
+				info.IndexType = mesh.IndexType();
+				info.BoundingRadius = 0.0f;
+				for (size_t v = 0; v < mesh.Vertices.size(); ++v)
+					info.BoundingRadius = glm::max(info.BoundingRadius, glm::length(mesh.Vertices[v].Position));
+
+				VertexPacking::PackedMeshData packedMesh;
+				const void* vertexData = mesh.Vertices.data();
+				size_t vertexBytes = sizeof(GeometryGenerator::Vertex) * mesh.Vertices.size();
+				if (packed)
+				{
+					VertexPacking::PackMesh(mesh, VertexPacking::POSITION_HALF, packedMesh);
+					vertexData = packedMesh.Vertices.data();
+					vertexBytes = sizeof(VertexPacking::PackedVertex) * packedMesh.Vertices.size();
+				}
+
+				std::vector<GLushort> shortIndices;
+				const void* indexData = mesh.Indices.data();
+				if (info.IndexType == GL_UNSIGNED_SHORT)
+				{
+					mesh.NarrowIndices(shortIndices);
+					indexData = shortIndices.data();
+				}
+
+				glBufferData(GL_ARRAY_BUFFER, vertexBytes, vertexData, GL_STATIC_DRAW);
+				glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.IndexBufferSize(), indexData, GL_STATIC_DRAW);
+				pack.add(section + "/vb", vertexData, vertexBytes, &info, sizeof(info));
+				pack.add(section + "/ib", indexData, (size_t)mesh.IndexBufferSize());
+
+				level.IndexCount = (GLsizei)info.IndexCount;
+				level.IndexType = info.IndexType;
+				boundingRadius = glm::max(boundingRadius, info.BoundingRadius);
+			}
+
+			if (packed)
+			{
+				VertexPacking::SetupPackedAttributes(VertexPacking::POSITION_HALF);
+			}
+			else
+			{
+				glEnableVertexAttribArray(0);
+				glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)0);
+				glEnableVertexAttribArray(1);
+				glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
+				glEnableVertexAttribArray(2);
+				glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)(6 * sizeof(GLfloat)));
+			}
+			glBindVertexArray(0);
+		}
+	}
+
+	///<summary>
+	/// Radius in pixels of a sphere of the given world radius, using the camera zoom as the vertical field of view.
+	///</summary>
+	static float projectedRadius(const glm::vec3& center, float radius, const Camera& camera, unsigned int SCR_HEIGHT)
+	{
+		float distance = glm::length(center - camera.Position);
+		if (distance <= radius)
+			return std::numeric_limits<float>::max();
+
+		float tanHalfFov = tanf(glm::radians(camera.Zoom) * 0.5f);
+		return (radius / (distance * tanHalfFov)) * (0.5f * SCR_HEIGHT);
+	}
+
+	unsigned int selectLevel(const glm::vec3& center, const Camera& camera, unsigned int SCR_HEIGHT, float scale = 1.0f) const
+	{
+		float pixels = projectedRadius(center, boundingRadius * scale, camera, SCR_HEIGHT);
+		for (unsigned int i = 0; i < levels.size(); ++i)
+		{
+			if (pixels >= levels[i].MinPixelRadius)
+				return i;
+		}
+		return (unsigned int)levels.size() - 1;
+	}
+
+	// binds and draws one level, the shader and model matrix must already be set
+	void draw(unsigned int level, GLenum mode) const
+	{
+		const Level& l = levels[level];
+		glBindVertexArray(l.VAO);
+		glDrawElements(mode, l.IndexCount, l.IndexType, 0);
+	}
+
+	const Level& getLevel(unsigned int level) const
+	{
+		return levels[level];
+	}
+
+	unsigned int levelCount() const
+	{
+		return (unsigned int)levels.size();
+	}
+
+	float getBoundingRadius() const
+	{
+		return boundingRadius;
+	}
+
+private:
+	// AssetPack info block of a level's vertex section
+	struct PackInfo
+	{
+		unsigned int Packed;
+		unsigned int IndexCount;
+		GLenum IndexType;
+		float BoundingRadius;
+	};
+
+	std::vector<Level> levels;
+	float boundingRadius = 0.0f;
+
+	// the GL objects are owned by the chain
+	MeshLOD(const MeshLOD&);
+	MeshLOD& operator=(const MeshLOD&);
+};
+
+#endif // MESHLOD_H
@@ -0,0 +1,349 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+namespace
+{
+	struct VertexKey
+	{
+		GeometryGenerator::Vertex V;
+
+		bool operator==(const VertexKey& other) const
+		{
+			return memcmp(&V, &other.V, sizeof(GeometryGenerator::Vertex)) == 0;
+		}
+	};
+
+	struct VertexKeyHash
+	{
+		size_t operator()(const VertexKey& key) const
+		{
+			// FNV-1a over the raw vertex bytes
+			const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&key.V);
+			size_t hash = 2166136261u;
+			for (size_t i = 0; i < sizeof(GeometryGenerator::Vertex); ++i)
+			{
+				hash ^= bytes[i];
+				hash *= 16777619u;
+			}
+			return hash;
+		}
+	};
+}
+
+void MeshOptimizer::Optimize(GeometryGenerator::MeshData& meshData, Report* report, unsigned int cacheSize)
+{
+	if (meshData.Topology != GL_TRIANGLES)
+		return;
+
+	Report r;
+	r.VerticesBefore = meshData.Vertices.size();
+	r.Before = AnalyzeVertexCache(meshData, cacheSize);
+
+	std::vector<unsigned int> clusters;
+	WeldVertices(meshData);
+	OptimizeVertexCache(meshData, clusters, cacheSize);
+	OptimizeOverdraw(meshData, clusters);
+	OptimizeVertexFetch(meshData);
+
+	r.VerticesAfter = meshData.Vertices.size();
+	r.After = AnalyzeVertexCache(meshData, cacheSize);
+
+	if (report != nullptr)
+		*report = r;
+}
+
+MeshOptimizer::CacheStats MeshOptimizer::AnalyzeVertexCache(const GeometryGenerator::MeshData& meshData, unsigned int cacheSize) const
+{
+	CacheStats stats;
+	size_t triangleCount = meshData.Indices.size() / 3;
+	if (triangleCount == 0)
+		return stats;
+
+	// a vertex is in the FIFO while fewer than cacheSize misses happened since it was loaded
+	std::vector<size_t> loadedAt(meshData.Vertices.size(), 0);
+	std::vector<bool> referenced(meshData.Vertices.size(), false);
+	size_t misses = 0;
+	size_t uniqueVertices = 0;
+
+	for (size_t i = 0; i < meshData.Indices.size(); ++i)
+	{
+		GLuint v = meshData.Indices[i];
+		if (!referenced[v])
+		{
+			referenced[v] = true;
+			uniqueVertices++;
+		}
+
+		if (loadedAt[v] == 0 || misses - loadedAt[v] + 1 > cacheSize)
+		{
+			misses++;
+			loadedAt[v] = misses;
+		}
+	}
+
+	stats.ACMR = (float)misses / triangleCount;
+	stats.ATVR = (float)misses / uniqueVertices;
+	return stats;
+}
+
+size_t MeshOptimizer::WeldVertices(GeometryGenerator::MeshData& meshData) const
+{
+	std::unordered_map<VertexKey, GLuint, VertexKeyHash> unique;
+	unique.reserve(meshData.Vertices.size());
+
+	std::vector<GeometryGenerator::Vertex> vertices;
+	vertices.reserve(meshData.Vertices.size());
+	std::vector<GLuint> remap(meshData.Vertices.size());
+
+	for (size_t i = 0; i < meshData.Vertices.size(); ++i)
+	{
+		VertexKey key;
+		key.V = meshData.Vertices[i];
+
+		// -0.0 and 0.0 compare equal but differ bitwise
+		for (int c = 0; c < 3; ++c)
+		{
+			key.V.Position[c] += 0.0f;
+			key.V.Normal[c] += 0.0f;
+		}
+		key.V.TexC += glm::vec2(0.0f);
+
+		auto inserted = unique.insert(std::make_pair(key, (GLuint)vertices.size()));
+		if (inserted.second)
+			vertices.push_back(meshData.Vertices[i]);
+		remap[i] = inserted.first->second;
+	}
+
+	size_t removed = meshData.Vertices.size() - vertices.size();
+	for (size_t i = 0; i < meshData.Indices.size(); ++i)
+	{
+		if (meshData.Indices[i] != GeometryGenerator::RESTART_INDEX)
+			meshData.Indices[i] = remap[meshData.Indices[i]];
+	}
+	meshData.Vertices.swap(vertices);
+	return removed;
+}
+
+void MeshOptimizer::OptimizeVertexCache(GeometryGenerator::MeshData& meshData, std::vector<unsigned int>& clusters, unsigned int cacheSize) const
+{
+	const std::vector<GLuint>& indices = meshData.Indices;
+	unsigned int vertexCount = (unsigned int)meshData.Vertices.size();
+	unsigned int triangleCount = (unsigned int)indices.size() / 3;
+
+	clusters.clear();
+	if (triangleCount == 0)
+		return;
+
+	// vertex -> triangle adjacency in compressed form
+	std::vector<unsigned int> liveCount(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; ++i)
+		liveCount[indices[i]]++;
+
+	std::vector<unsigned int> offsets(vertexCount + 1, 0);
+	for (unsigned int v = 0; v < vertexCount; ++v)
+		offsets[v + 1] = offsets[v] + liveCount[v];
+
+	std::vector<unsigned int> adjacency(triangleCount * 3);
+	std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+	for (unsigned int t = 0; t < triangleCount; ++t)
+	{
+		for (int c = 0; c < 3; ++c)
+			adjacency[fill[indices[t * 3 + c]]++] = t;
+	}
+
+	std::vector<unsigned int> cacheTime(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<GLuint> deadEnd;
+	std::vector<GLuint> candidates;
+	std::vector<GLuint> output;
+	output.reserve(triangleCount * 3);
+
+	unsigned int timeStamp = cacheSize + 1;
+	unsigned int cursor = 0;
+	int fanning = 0;
+	clusters.push_back(0);
+
+	while (fanning >= 0)
+	{
+		candidates.clear();
+
+		for (unsigned int a = offsets[fanning]; a < offsets[fanning + 1]; ++a)
+		{
+			unsigned int t = adjacency[a];
+			if (emitted[t])
+				continue;
+
+			for (int c = 0; c < 3; ++c)
+			{
+				GLuint v = indices[t * 3 + c];
+				output.push_back(v);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				liveCount[v]--;
+
+				if (timeStamp - cacheTime[v] > cacheSize)
+					cacheTime[v] = timeStamp++;
+			}
+			emitted[t] = true;
+		}
+
+		bool skipped = false;
+		fanning = nextVertex(liveCount, cacheTime, candidates, deadEnd, cursor, timeStamp, cacheSize, skipped);
+
+		// a dead end flushes the locality of the cache, start a new overdraw cluster
+		if (skipped && fanning >= 0 && output.size() / 3 > clusters.back())
+			clusters.push_back((unsigned int)output.size() / 3);
+	}
+
+	meshData.Indices.swap(output);
+}
+
+int MeshOptimizer::nextVertex(const std::vector<unsigned int>& liveCount, const std::vector<unsigned int>& cacheTime, const std::vector<GLuint>& candidates,
+	std::vector<GLuint>& deadEnd, unsigned int& cursor, unsigned int timeStamp, unsigned int cacheSize, bool& skipped) const
+{
+	// pick the candidate that is still in the cache after emitting its fan and was loaded the longest ago
+	int best = -1;
+	int bestPriority = -1;
+	for (size_t i = 0; i < candidates.size(); ++i)
+	{
+		GLuint v = candidates[i];
+		if (liveCount[v] == 0)
+			continue;
+
+		int priority = 0;
+		if (timeStamp - cacheTime[v] + 2 * liveCount[v] <= cacheSize)
+			priority = timeStamp - cacheTime[v];
+
+		if (priority > bestPriority)
+		{
+			bestPriority = priority;
+			best = (int)v;
+		}
+	}
+
+	if (best != -1)
+		return best;
+
+	skipped = true;
+
+	// dead end, go back through recently used vertices
+	while (!deadEnd.empty())
+	{
+		GLuint v = deadEnd.back();
+		deadEnd.pop_back();
+		if (liveCount[v] > 0)
+			return (int)v;
+	}
+
+	// then continue with the next vertex in input order
+	while (cursor < liveCount.size())
+	{
+		if (liveCount[cursor] > 0)
+			return (int)cursor;
+		cursor++;
+	}
+
+	return -1;
+}
+
+void MeshOptimizer::OptimizeOverdraw(GeometryGenerator::MeshData& meshData, const std::vector<unsigned int>& clusters) const
+{
+	const std::vector<GLuint>& indices = meshData.Indices;
+	unsigned int triangleCount = (unsigned int)indices.size() / 3;
+	if (clusters.size() < 2)
+		return;
+
+	// area weighted mesh centroid
+	glm::vec3 meshCentroid(0.0f);
+	float meshArea = 0.0f;
+	for (unsigned int t = 0; t < triangleCount; ++t)
+	{
+		const glm::vec3& p0 = meshData.Vertices[indices[t * 3 + 0]].Position;
+		const glm::vec3& p1 = meshData.Vertices[indices[t * 3 + 1]].Position;
+		const glm::vec3& p2 = meshData.Vertices[indices[t * 3 + 2]].Position;
+		float area = 0.5f * glm::length(glm::cross(p1 - p0, p2 - p0));
+		meshCentroid += area * (p0 + p1 + p2) / 3.0f;
+		meshArea += area;
+	}
+	if (meshArea > 0.0f)
+		meshCentroid /= meshArea;
+
+	struct Cluster
+	{
+		unsigned int Begin;
+		unsigned int End;
+		float Sort;
+	};
+
+	std::vector<Cluster> sorted(clusters.size());
+	for (size_t c = 0; c < clusters.size(); ++c)
+	{
+		Cluster& cluster = sorted[c];
+		cluster.Begin = clusters[c];
+		cluster.End = (c + 1 < clusters.size()) ? clusters[c + 1] : triangleCount;
+
+		glm::vec3 centroid(0.0f);
+		glm::vec3 normal(0.0f);
+		float area = 0.0f;
+		for (unsigned int t = cluster.Begin; t < cluster.End; ++t)
+		{
+			const glm::vec3& p0 = meshData.Vertices[indices[t * 3 + 0]].Position;
+			const glm::vec3& p1 = meshData.Vertices[indices[t * 3 + 1]].Position;
+			const glm::vec3& p2 = meshData.Vertices[indices[t * 3 + 2]].Position;
+			glm::vec3 n = glm::cross(p1 - p0, p2 - p0);	// length is twice the area
+			float a = 0.5f * glm::length(n);
+			centroid += a * (p0 + p1 + p2) / 3.0f;
+			normal += n;
+			area += a;
+		}
+		if (area > 0.0f)
+			centroid /= area;
+
+		float length = glm::length(normal);
+		cluster.Sort = (length > 0.0f) ? glm::dot(centroid - meshCentroid, normal / length) : 0.0f;
+	}
+
+	std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) { return a.Sort > b.Sort; });
+
+	std::vector<GLuint> output;
+	output.reserve(indices.size());
+	for (size_t c = 0; c < sorted.size(); ++c)
+		output.insert(output.end(), indices.begin() + sorted[c].Begin * 3, indices.begin() + sorted[c].End * 3);
+
+	meshData.Indices.swap(output);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(GeometryGenerator::MeshData& meshData) const
+{
+	const GLuint unused = 0xFFFFFFFF;
+	std::vector<GLuint> remap(meshData.Vertices.size(), unused);
+	std::vector<GeometryGenerator::Vertex> vertices;
+	vertices.reserve(meshData.Vertices.size());
+
+	for (size_t i = 0; i < meshData.Indices.size(); ++i)
+	{
+		GLuint& index = meshData.Indices[i];
+		if (index == GeometryGenerator::RESTART_INDEX)
+			continue;
+
+		if (remap[index] == unused)
+		{
+			remap[index] = (GLuint)vertices.size();
+			vertices.push_back(meshData.Vertices[index]);
+		}
+		index = remap[index];
+	}
+
+	meshData.Vertices.swap(vertices);
+}
+
+void MeshOptimizer::LogReport(const std::string& name, const Report& report) const
+{
+	std::cout << "MESH_OPTIMIZER::" << name
+		<< " vertices " << report.VerticesBefore << " -> " << report.VerticesAfter
+		<< " ACMR " << report.Before.ACMR << " -> " << report.After.ACMR
+		<< " ATVR " << report.Before.ATVR << " -> " << report.After.ATVR << std::endl;
+}
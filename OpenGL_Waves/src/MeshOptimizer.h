@@ -0,0 +1,71 @@
+#pragma once
+
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include "GL_Util.h"
+
+class MeshOptimizer
+{
+public:
+
+	struct CacheStats
+	{
+		float ACMR = 0.0f;	// average cache miss ratio, transformed vertices per triangle
+		float ATVR = 0.0f;	// average transform to vertex ratio, 1.0 is optimal
+	};
+
+	struct Report
+	{
+		size_t VerticesBefore = 0;
+		size_t VerticesAfter = 0;
+		CacheStats Before;
+		CacheStats After;
+	};
+
+	///<summary>
+	/// Runs the full pass on an indexed triangle list: welding, Tipsify vertex cache
+	/// ordering, cluster overdraw ordering and vertex fetch ordering.
+	/// Strip topologies are left untouched.
+	///</summary>
+	void Optimize(GeometryGenerator::MeshData& meshData, Report* report = nullptr, unsigned int cacheSize = 16);
+
+	///<summary>
+	/// Simulates a FIFO post-transform cache of the given size over the index buffer.
+	///</summary>
+	CacheStats AnalyzeVertexCache(const GeometryGenerator::MeshData& meshData, unsigned int cacheSize = 16) const;
+
+	///<summary>
+	/// Merges bitwise identical vertices through a hash map and remaps the indices.
+	/// Returns the number of vertices removed.
+	///</summary>
+	size_t WeldVertices(GeometryGenerator::MeshData& meshData) const;
+
+	///<summary>
+	/// Reorders triangles for the post-transform cache (Tipsify, Sander et al. 2007).
+	/// The start of every cluster (a jump to a new fan after a dead end) is written to clusters.
+	///</summary>
+	void OptimizeVertexCache(GeometryGenerator::MeshData& meshData, std::vector<unsigned int>& clusters, unsigned int cacheSize = 16) const;
+
+	///<summary>
+	/// Sorts the clusters produced by OptimizeVertexCache so that clusters facing away
+	/// from the mesh centre (the likely occluders) are drawn first.
+	///</summary>
+	void OptimizeOverdraw(GeometryGenerator::MeshData& meshData, const std::vector<unsigned int>& clusters) const;
+
+	///<summary>
+	/// Reorders vertices by first use in the index buffer and drops unreferenced vertices.
+	///</summary>
+	void OptimizeVertexFetch(GeometryGenerator::MeshData& meshData) const;
+
+	///<summary>
+	/// Writes the before/after statistics of a report to std::cout.
+	///</summary>
+	void LogReport(const std::string& name, const Report& report) const;
+
+private:
+	int nextVertex(const std::vector<unsigned int>& liveCount, const std::vector<unsigned int>& cacheTime, const std::vector<GLuint>& candidates,
+		std::vector<GLuint>& deadEnd, unsigned int& cursor, unsigned int timeStamp, unsigned int cacheSize, bool& skipped) const;
+};
+
+#endif // MESHOPTIMIZER_H
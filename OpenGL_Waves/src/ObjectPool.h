@@ -0,0 +1,160 @@
+#pragma once
+
+#ifndef OBJECTPOOL_H
+#define OBJECTPOOL_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Fixed size blocks carved from slabs, with freed blocks kept on a free list. Allocating and
+// freeing are a couple of pointer moves and memory only goes back to the heap when the pool
+// is destroyed. Not thread safe, callers sharing a pool between threads lock around it.
+class BlockPool
+{
+public:
+	BlockPool(size_t blockSize, size_t blockAlignment = alignof(std::max_align_t), size_t blocksPerSlab = 256)
+		: alignment(blockAlignment), perSlab(blocksPerSlab)
+	{
+		// every block must be able to hold the free list link and keep the next one aligned
+		size = (blockSize < sizeof(Link)) ? sizeof(Link) : blockSize;
+		if (alignment < alignof(Link))
+			alignment = alignof(Link);
+		size = (size + alignment - 1) / alignment * alignment;
+	}
+
+	~BlockPool()
+	{
+		for (size_t i = 0; i < slabs.size(); ++i)
+			std::free(slabs[i]);
+	}
+
+	void* allocate()
+	{
+		if (freeList == nullptr)
+			grow();
+		Link* block = freeList;
+		freeList = block->Next;
+		live++;
+		return block;
+	}
+
+	void deallocate(void* block)
+	{
+		Link* link = static_cast<Link*>(block);
+		link->Next = freeList;
+		freeList = link;
+		live--;
+	}
+
+	size_t blockSize() const { return size; }
+	size_t blockAlignment() const { return alignment; }
+	size_t liveCount() const { return live; }
+	size_t capacity() const { return slabs.size() * perSlab; }
+
+private:
+	struct Link
+	{
+		Link* Next;
+	};
+
+	size_t size;
+	size_t alignment;
+	size_t perSlab;
+	std::vector<void*> slabs;
+	Link* freeList = nullptr;
+	size_t live = 0;
+
+	void grow()
+	{
+		// over-allocated by one alignment so the first block can be aligned by hand
+		unsigned char* slab = static_cast<unsigned char*>(std::malloc(size * perSlab + alignment));
+		if (slab == nullptr)
+			throw std::bad_alloc();
+		slabs.push_back(slab);
+
+		unsigned char* first = slab + (alignment - reinterpret_cast<size_t>(slab) % alignment) % alignment;
+		for (size_t i = perSlab; i-- > 0;)
+		{
+			Link* link = reinterpret_cast<Link*>(first + i * size);
+			link->Next = freeList;
+			freeList = link;
+		}
+	}
+
+	BlockPool(const BlockPool&);
+	BlockPool& operator=(const BlockPool&);
+};
+
+// A BlockPool sized for T that constructs and destroys the objects as well.
+template <typename T>
+class ObjectPool : public BlockPool
+{
+public:
+	explicit ObjectPool(size_t objectsPerSlab = 256)
+		: BlockPool(sizeof(T), alignof(T), objectsPerSlab) {}
+
+	template <typename... Args>
+	T* create(Args&&... args)
+	{
+		void* block = allocate();
+		return new (block) T(std::forward<Args>(args)...);
+	}
+
+	void destroy(T* object)
+	{
+		object->~T();
+		deallocate(object);
+	}
+};
+
+///<summary>
+/// STL allocator drawing single elements from a BlockPool, for node based containers such as
+/// std::list, std::map or std::unordered_map. Requests for more than one element, like a hash
+/// table's bucket array, and nodes that do not fit a block go to the heap.
+///</summary>
+template <typename T>
+class PoolAllocator
+{
+public:
+	typedef T value_type;
+
+	explicit PoolAllocator(BlockPool& blockPool) : pool(&blockPool) {}
+
+	template <typename U>
+	PoolAllocator(const PoolAllocator<U>& other) : pool(other.pool) {}
+
+	T* allocate(size_t n)
+	{
+		if (fitsBlock(n))
+			return static_cast<T*>(pool->allocate());
+		return static_cast<T*>(::operator new(n * sizeof(T)));
+	}
+
+	void deallocate(T* p, size_t n)
+	{
+		if (fitsBlock(n))
+			pool->deallocate(p);
+		else
+			::operator delete(p);
+	}
+
+	template <typename U>
+	bool operator==(const PoolAllocator<U>& other) const { return pool == other.pool; }
+	template <typename U>
+	bool operator!=(const PoolAllocator<U>& other) const { return pool != other.pool; }
+
+private:
+	template <typename U> friend class PoolAllocator;
+
+	BlockPool* pool;
+
+	bool fitsBlock(size_t n) const
+	{
+		return n == 1 && sizeof(T) <= pool->blockSize() && alignof(T) <= pool->blockAlignment();
+	}
+};
+
+#endif // OBJECTPOOL_H
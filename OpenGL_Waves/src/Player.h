@@ -4,6 +4,9 @@
 #define PLAYER_H
 
 #include "GL_Util.h"
+#include "MeshLOD.h"
+#include "FrameSnapshot.h"
+#include "SurfaceQuery.h"
 
 class Player
 {
@@ -15,8 +18,6 @@ public:
 
 	~Player()
 	{
-		glDeleteVertexArrays(1, &playerVAO);
-		glDeleteBuffers(1, &playerVBO);
 	}
 
 	void init()
@@ -27,49 +28,80 @@ public:
 		code.fragmentCode = fragmentShaderSource;
 		playerShader = Shader(code);
 
-		GeometryGenerator geoGen = GeometryGenerator();
-		geoGen.CreateSphere(0.5f, 20, 20, player);
-
-		// create player VAO
-		glGenVertexArrays(1, &playerVAO);
-		glGenBuffers(1, &playerVBO);
-		glGenBuffers(1, &playerEBO);
-		glBindVertexArray(playerVAO);
-
-		glBindBuffer(GL_ARRAY_BUFFER, playerVBO);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(GeometryGenerator::Vertex) * player.Vertices.size(), player.Vertices.data(), GL_STATIC_DRAW);
+		// geosphere subdivision levels, the shader only reads positions so the chain is packed
+		playerLOD.init("player", { 60.0f, 20.0f, 6.0f, 0.0f }, [](unsigned int level, GeometryGenerator::MeshData& mesh)
+		{
+			const unsigned int subdivisions[] = { 3, 2, 1, 0 };
+			GeometryGenerator geoGen;
+			geoGen.CreateGeosphere(0.5f, subdivisions[level], mesh);
+		}, true);
+	}
 
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, playerEBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * player.Indices.size(), player.Indices.data(), GL_STATIC_DRAW);
+	///<summary>
+	/// Sets the directions held this frame, a bit per Player_Movement. Every fixed step of the
+	/// frame moves by them.
+	///</summary>
+	void setInput(unsigned int movementBits)
+	{
+		input = movementBits;
+	}
 
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)0);
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)(6 * sizeof(GLfloat)));
-		glBindVertexArray(0);
+	///<summary>
+	/// One fixed simulation step. The ball rolls over the terrain, stops at slopes it cannot
+	/// climb and floats half out of the water wherever that is higher than the ground.
+	///</summary>
+	void step(float stepSeconds, SurfaceQuery& surface)
+	{
+		previousPosition = playerPosition;
+		for (unsigned int direction = FORWARD; direction <= RIGHT; ++direction)
+		{
+			if (input & (1u << direction))
+				doMovement((Player_Movement)direction, stepSeconds);
+		}
+
+		// doMovement gave the horizontal target, gravity the vertical one
+		glm::vec3 target = playerPosition;
+		velocityY -= GRAVITY * stepSeconds;
+		target.y += velocityY * stepSeconds;
+
+		SurfaceQuery::Sweep sweep = surface.sweepSphere(previousPosition, target, RADIUS, MAX_CLIMB);
+		float support = glm::max(sweep.Ground, surface.waterHeight(sweep.Position.x));
+		playerPosition = sweep.Position;
+
+		// land on the support, or stay on it while it falls away slower than a step can climb
+		if (playerPosition.y <= support || (grounded && playerPosition.y - support < MAX_CLIMB))
+		{
+			playerPosition.y = support;
+			velocityY = 0.0f;
+			grounded = true;
+		}
+		else
+		{
+			grounded = false;
+		}
 	}
 
-	void update(GLFWwindow* window, Camera camera, float deltaTime, unsigned int SCR_WIDTH, unsigned int SCR_HEIGHT)
+	// interpolates between the last two steps and picks the LOD level, runs in the simulation phase
+	void simulate(const Camera& camera, FrameSnapshot& frame) const
 	{
-		//processInput(window, deltaTime);
+		glm::vec3 position = glm::mix(previousPosition, playerPosition, frame.Interpolation);
+		frame.Player.Model = glm::translate(glm::mat4(), position);
+		frame.Player.Level = playerLOD.selectLevel(position, camera, frame.ScreenHeight);
+	}
+
+	glm::vec3 position() const { return playerPosition; }
+	glm::vec3 lastPosition() const { return previousPosition; }
+	float radius() const { return RADIUS; }
 
+	void render(const FrameSnapshot& frame)
+	{
 		// ativate shader program
 		playerShader.use();
 
-		// pass projection matrix to shader (note that in this case it could change every frame)
-		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-		playerShader.setMat4("projection", projection);
-
-		// pass camera/view transformation matrix to shader 
-		glm::mat4 view = camera.GetViewMatrix();
-		playerShader.setMat4("view", view);
-
-		// pass model matrix to shader 
-		glm::mat4 model = glm::mat4();
-		model = glm::translate(model, playerPosition);
-		playerShader.setMat4("model", model);
+		// pass projection, camera/view and model matrices to shader
+		playerShader.setMat4("projection", frame.Projection);
+		playerShader.setMat4("view", frame.View);
+		playerShader.setMat4("model", frame.Player.Model);
 
 		// set grid color
 		glm::vec4 black = glm::vec4(0, 0, 0, 1);
@@ -79,21 +111,22 @@ public:
 		GLenum GL_RENDER_MODE = GL_LINES;	// GL_LINES or GL_TRIANGLES
 
 		// bind and draw grid element buffer
-		glBindVertexArray(playerVAO);
 		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-		glDrawElements(GL_RENDER_MODE, player.Indices.size(), GL_UNSIGNED_INT, 0);
+		playerLOD.draw(frame.Player.Level, GL_RENDER_MODE);
 	}
 
-	void processInput(GLFWwindow *window, float deltaTime)
+	void processInput(GLFWwindow *window)
 	{
+		unsigned int movement = 0;
 		if (glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS)
-			doMovement(FORWARD, deltaTime);
+			movement |= 1u << FORWARD;
 		if (glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS)
-			doMovement(BACKWARD, deltaTime);
+			movement |= 1u << BACKWARD;
 		if (glfwGetKey(window, GLFW_KEY_J) == GLFW_PRESS)
-			doMovement(LEFT, deltaTime);
+			movement |= 1u << LEFT;
 		if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS)
-			doMovement(RIGHT, deltaTime);
+			movement |= 1u << RIGHT;
+		setInput(movement);
 	}
 
 	enum Player_Movement {
@@ -121,11 +154,17 @@ public:
 private:
 	Shader playerShader;
 
-	GeometryGenerator::MeshData player;
-	GLuint playerVAO, playerVBO, playerEBO;
+	MeshLOD playerLOD;
 
 	const float MAX_SPEED = 2.5f;
+	const float RADIUS = 0.5f;		// of the geosphere
+	const float GRAVITY = 9.81f;
+	const float MAX_CLIMB = 0.25f;	// highest ground step the ball rolls up in one sweep step
+	float velocityY = 0.0f;
+	bool grounded = false;
 	glm::vec3 playerPosition = glm::vec3(0.0f, 0.5f, 0.0f);
+	glm::vec3 previousPosition = glm::vec3(0.0f, 0.5f, 0.0f);
+	unsigned int input = 0;
 	float player_dx = 0;
 	float player_dz = 0;
 
@@ -0,0 +1,142 @@
+#include "RippleSolver.h"
+#include "JobSystem.h"
+
+#include <chrono>
+#include <cstring>
+#include <emmintrin.h>
+
+namespace
+{
+	// leapfrog on a square grid is stable up to (c dt / dx)^2 = 1/2
+	const float MAX_COURANT2 = 0.5f;
+	// fraction of the height the outermost sponge cell loses every step
+	const float SPONGE_STRENGTH = 0.15f;
+}
+
+RippleSolver::RippleSolver(float cellSize, float waveSpeed, float dampingPerSecond)
+	: cell(cellSize), speed(waveSpeed), damping(dampingPerSecond),
+	current(SIZE * SIZE, 0.0f), previous(SIZE * SIZE, 0.0f), scratch(SIZE * SIZE, 0.0f), sponge(SIZE, 1.0f)
+{
+	// quadratic ramp, so the sponge starts gently and reflects little itself
+	for (int i = 0; i < SPONGE_CELLS; ++i)
+	{
+		float t = (float)(SPONGE_CELLS - i) / SPONGE_CELLS;
+		sponge[i] = sponge[SIZE - 1 - i] = 1.0f - SPONGE_STRENGTH * t * t;
+	}
+	originX = originZ = -SIZE / 2;
+}
+
+void RippleSolver::follow(const glm::vec3& center)
+{
+	int centerX = (int)floorf(center.x / cell) - SIZE / 2;
+	int centerZ = (int)floorf(center.z / cell) - SIZE / 2;
+	int dx = centerX - originX;
+	int dz = centerZ - originZ;
+	if (abs(dx) <= RECENTER_CELLS && abs(dz) <= RECENTER_CELLS)
+		return;
+
+	scroll(current, dx, dz);
+	scroll(previous, dx, dz);
+	originX = centerX;
+	originZ = centerZ;
+}
+
+void RippleSolver::disturb(float x, float z, float radius, float amount)
+{
+	int cells = (int)ceilf(radius / cell);
+	int column = (int)floorf(x / cell) - originX;
+	int row = (int)floorf(z / cell) - originZ;
+	for (int r = glm::max(row - cells, 1); r <= glm::min(row + cells, SIZE - 2); ++r)
+	{
+		for (int c = glm::max(column - cells, 1); c <= glm::min(column + cells, SIZE - 2); ++c)
+		{
+			float distance = glm::length(glm::vec2((originX + c + 0.5f) * cell - x, (originZ + r + 0.5f) * cell - z));
+			if (distance < radius)
+				current[r * SIZE + c] -= amount * 0.5f * (1.0f + cosf(glm::pi<float>() * distance / radius));
+		}
+	}
+}
+
+void RippleSolver::step(float stepSeconds)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	float courant = speed * stepSeconds / cell;
+	float courant2 = glm::min(courant * courant, MAX_COURANT2);
+	float stepDamping = glm::max(1.0f - damping * stepSeconds, 0.0f);
+
+	// the outer ring stays at zero, rows 1 .. SIZE-2 are computed
+	JobSystem::instance().parallelFor(SIZE - 2, MIN_ROWS_PER_JOB, [&](size_t begin, size_t end)
+	{
+		stepRows(begin + 1, end + 1, courant2, stepDamping);
+	});
+	current.swap(previous);
+
+	lastStep = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	totalStep += lastStep;
+	steps++;
+}
+
+void RippleSolver::stepRows(size_t firstRow, size_t endRow, float courant2, float stepDamping)
+{
+	const __m128 two = _mm_set1_ps(2.0f);
+	const __m128 four = _mm_set1_ps(4.0f);
+	const __m128 c2 = _mm_set1_ps(courant2);
+
+	for (size_t r = firstRow; r < endRow; ++r)
+	{
+		const float* up = &current[(r - 1) * SIZE];
+		const float* row = &current[r * SIZE];
+		const float* down = &current[(r + 1) * SIZE];
+		float* out = &previous[r * SIZE];
+		const float rowDamping = stepDamping * sponge[r];
+		const __m128 rowScale = _mm_set1_ps(rowDamping);
+
+		int c = 1;
+		for (; c + 4 <= SIZE - 1; c += 4)
+		{
+			__m128 center = _mm_loadu_ps(row + c);
+			__m128 neighbours = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(row + c - 1), _mm_loadu_ps(row + c + 1)),
+				_mm_add_ps(_mm_loadu_ps(up + c), _mm_loadu_ps(down + c)));
+			__m128 laplacian = _mm_sub_ps(neighbours, _mm_mul_ps(four, center));
+			__m128 next = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(two, center), _mm_loadu_ps(out + c)), _mm_mul_ps(c2, laplacian));
+			_mm_storeu_ps(out + c, _mm_mul_ps(next, _mm_mul_ps(rowScale, _mm_loadu_ps(&sponge[c]))));
+		}
+		for (; c < SIZE - 1; ++c)
+		{
+			float laplacian = row[c - 1] + row[c + 1] + up[c] + down[c] - 4.0f * row[c];
+			out[c] = (2.0f * row[c] - out[c] + courant2 * laplacian) * rowDamping * sponge[c];
+		}
+	}
+}
+
+float RippleSolver::height(float x, float z) const
+{
+	float column = x / cell - originX - 0.5f;
+	float row = z / cell - originZ - 0.5f;
+	if (column < 0.0f || row < 0.0f || column >= SIZE - 1 || row >= SIZE - 1)
+		return 0.0f;
+
+	int c = (int)column;
+	int r = (int)row;
+	float fx = column - c;
+	float fz = row - r;
+	const float* h = &current[r * SIZE + c];
+	float top = h[0] + (h[1] - h[0]) * fx;
+	float bottom = h[SIZE] + (h[SIZE + 1] - h[SIZE]) * fx;
+	return top + (bottom - top) * fz;
+}
+
+void RippleSolver::scroll(std::vector<float>& grid, int dx, int dz)
+{
+	// cell (r, c) takes what was at (r + dz, c + dx), anything new starts flat
+	std::fill(scratch.begin(), scratch.end(), 0.0f);
+	int firstColumn = glm::max(0, -dx);
+	int lastColumn = glm::min(SIZE, SIZE - dx);
+	for (int r = glm::max(0, -dz); r < glm::min(SIZE, SIZE - dz); ++r)
+	{
+		if (firstColumn < lastColumn)
+			memcpy(&scratch[r * SIZE + firstColumn], &grid[(r + dz) * SIZE + firstColumn + dx], sizeof(float) * (lastColumn - firstColumn));
+	}
+	grid.swap(scratch);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#ifndef RIPPLESOLVER_H
+#define RIPPLESOLVER_H
+
+#include "GL_Util.h"
+
+#include <vector>
+
+// Small waves on top of the WaveField: the 2D wave equation on a SIZE x SIZE height grid
+// around the camera, stepped with the usual leapfrog scheme
+//
+//     h' = damping * (2h - h_prev + (c dt / dx)^2 * laplacian(h))
+//
+// which only keeps two grids, the new heights overwrite the previous ones. A sponge of
+// SPONGE_CELLS along the edges damps whatever reaches it, so waves leave the grid instead of
+// bouncing back. When the camera gets more than RECENTER_CELLS away from the center the grid
+// scrolls by whole cells, the heights move with it.
+//
+// Rows are updated four cells at a time with SSE and spread over the job system in stripes.
+class RippleSolver
+{
+public:
+	static const int SIZE = 512;
+	static const int SPONGE_CELLS = 24;
+	static const int RECENTER_CELLS = 32;
+
+	RippleSolver(float cellSize = 0.1f, float waveSpeed = 2.0f, float damping = 0.3f);
+
+	///<summary>
+	/// Keeps the grid centered under a point, scrolling it when the point has moved far enough.
+	///</summary>
+	void follow(const glm::vec3& center);
+
+	///<summary>
+	/// Pushes the water down by amount at (x, z), fading out to nothing at radius.
+	///</summary>
+	void disturb(float x, float z, float radius, float amount);
+
+	void step(float stepSeconds);
+
+	// ripple height at a world position, zero outside the grid
+	float height(float x, float z) const;
+
+	// SIZE x SIZE heights, rows along +z from origin()
+	const float* heights() const { return current.data(); }
+	glm::vec2 origin() const { return glm::vec2(originX * cell, originZ * cell); }
+	float cellSize() const { return cell; }
+	float extent() const { return SIZE * cell; }
+
+	double lastStepMs() const { return lastStep; }
+	double averageStepMs() const { return steps ? totalStep / steps : 0.0; }
+
+private:
+	// rows per job, small stripes cost more in scheduling than they save
+	static const size_t MIN_ROWS_PER_JOB = 32;
+
+	float cell;
+	float speed;
+	float damping;
+	int originX = 0;	// world cell of the first column and row
+	int originZ = 0;
+
+	std::vector<float> current;
+	std::vector<float> previous;	// becomes the next step as it is computed
+	std::vector<float> scratch;		// for scrolling
+	std::vector<float> sponge;		// per row and per column absorption, 1 away from the edges
+
+	double lastStep = 0.0;
+	double totalStep = 0.0;
+	unsigned long long steps = 0;
+
+	void stepRows(size_t firstRow, size_t endRow, float courant2, float stepDamping);
+	void scroll(std::vector<float>& grid, int dx, int dz);
+};
+
+#endif // RIPPLESOLVER_H
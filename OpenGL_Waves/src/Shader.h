@@ -4,11 +4,13 @@
 #define SHADER_H
 
 #include "GL_Util.h"
+#include "ShaderCache.h"
+#include "ShaderBatch.h"
 
 class Shader
 {
 public:
-	unsigned int ID;
+	unsigned int ID = 0;	// 0 until a program is built
 
 	struct ShaderCode
 	{
@@ -31,6 +33,18 @@ public:
 		std::string geometryCode;
 		const char* vShaderCode = shaderCode.vertexCode;
 		const char* fShaderCode = shaderCode.fragmentCode;
+
+		// shader Program
+		ID = glCreateProgram();
+
+		// a binary linked by an earlier run with the same sources and driver skips compilation
+		ShaderCache& cache = ShaderCache::instance();
+		unsigned long long cacheKey = cache.makeKey(shaderCode.vertexCode, shaderCode.fragmentCode, shaderCode.geometryCode);
+		if (cache.load(ID, cacheKey))
+			return;
+
+		// inside an open ShaderBatch the status checks are left to ShaderBatch::finish()
+		ShaderBatch* batch = ShaderBatch::current();
 		
 		// 2. compile shaders
 		unsigned int vertex, fragment;
@@ -39,35 +53,42 @@ public:
 		vertex = glCreateShader(GL_VERTEX_SHADER);
 		glShaderSource(vertex, 1, &vShaderCode, NULL);
 		glCompileShader(vertex);
-		checkCompileErrors(vertex, "VERTEX");
+		if (batch == nullptr)
+			checkCompileErrors(vertex, "VERTEX");
 
 		// fragment Shader
 		fragment = glCreateShader(GL_FRAGMENT_SHADER);
 		glShaderSource(fragment, 1, &fShaderCode, NULL);
 		glCompileShader(fragment);
-		checkCompileErrors(fragment, "FRAGMENT");
+		if (batch == nullptr)
+			checkCompileErrors(fragment, "FRAGMENT");
 
 		// if geometry shader is given, compile geometry shader
-		unsigned int geometry;
+		unsigned int geometry = 0;
 		if (shaderCode.geometryCode != nullptr)
 		{
 			const char * gShaderCode = shaderCode.geometryCode;
 			geometry = glCreateShader(GL_GEOMETRY_SHADER);
 			glShaderSource(geometry, 1, &gShaderCode, NULL);
 			glCompileShader(geometry);
-			checkCompileErrors(geometry, "GEOMETRY");
+			if (batch == nullptr)
+				checkCompileErrors(geometry, "GEOMETRY");
 		}
 
-		// shader Program
-		ID = glCreateProgram();
-
 		glAttachShader(ID, vertex);
 		glAttachShader(ID, fragment);
 		if (shaderCode.geometryCode != nullptr)
 			glAttachShader(ID, geometry);
 
+		cache.prepare(ID);
 		glLinkProgram(ID);
-		checkCompileErrors(ID, "PROGRAM");
+		if (batch != nullptr)
+		{
+			batch->add(ID, vertex, fragment, geometry, cacheKey);
+			return;
+		}
+		if (checkCompileErrors(ID, "PROGRAM"))
+			cache.store(ID, cacheKey);
 
 		// delete the shaders as they're linked into our program now and no longer necessery
 		glDeleteShader(vertex);
@@ -167,67 +188,67 @@ public:
 	}
 	// utility uniform functions
 	// ------------------------------------------------------------------------
-	void setBool(const std::string &name, bool value) const
+	void setBool(const char* name, bool value) const
 	{
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+		glUniform1i(glGetUniformLocation(ID, name), (int)value);
 	}
 	// ------------------------------------------------------------------------
-	void setInt(const std::string &name, int value) const
+	void setInt(const char* name, int value) const
 	{
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+		glUniform1i(glGetUniformLocation(ID, name), value);
 	}
 	// ------------------------------------------------------------------------
-	void setFloat(const std::string &name, float value) const
+	void setFloat(const char* name, float value) const
 	{
-		glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+		glUniform1f(glGetUniformLocation(ID, name), value);
 	}
 	// ------------------------------------------------------------------------
-	void setVec2(const std::string &name, const glm::vec2 &value) const
+	void setVec2(const char* name, const glm::vec2 &value) const
 	{
-		glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+		glUniform2fv(glGetUniformLocation(ID, name), 1, &value[0]);
 	}
-	void setVec2(const std::string &name, float x, float y) const
+	void setVec2(const char* name, float x, float y) const
 	{
-		glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+		glUniform2f(glGetUniformLocation(ID, name), x, y);
 	}
 	// ------------------------------------------------------------------------
-	void setVec3(const std::string &name, const glm::vec3 &value) const
+	void setVec3(const char* name, const glm::vec3 &value) const
 	{
-		glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+		glUniform3fv(glGetUniformLocation(ID, name), 1, &value[0]);
 	}
-	void setVec3(const std::string &name, float x, float y, float z) const
+	void setVec3(const char* name, float x, float y, float z) const
 	{
-		glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+		glUniform3f(glGetUniformLocation(ID, name), x, y, z);
 	}
 	// ------------------------------------------------------------------------
-	void setVec4(const std::string &name, const glm::vec4 &value) const
+	void setVec4(const char* name, const glm::vec4 &value) const
 	{
-		glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+		glUniform4fv(glGetUniformLocation(ID, name), 1, &value[0]);
 	}
-	void setVec4(const std::string &name, float x, float y, float z, float w)
+	void setVec4(const char* name, float x, float y, float z, float w)
 	{
-		glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+		glUniform4f(glGetUniformLocation(ID, name), x, y, z, w);
 	}
 	// ------------------------------------------------------------------------
-	void setMat2(const std::string &name, const glm::mat2 &mat) const
+	void setMat2(const char* name, const glm::mat2 &mat) const
 	{
-		glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		glUniformMatrix2fv(glGetUniformLocation(ID, name), 1, GL_FALSE, &mat[0][0]);
 	}
 	// ------------------------------------------------------------------------
-	void setMat3(const std::string &name, const glm::mat3 &mat) const
+	void setMat3(const char* name, const glm::mat3 &mat) const
 	{
-		glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		glUniformMatrix3fv(glGetUniformLocation(ID, name), 1, GL_FALSE, &mat[0][0]);
 	}
 	// ------------------------------------------------------------------------
-	void setMat4(const std::string &name, const glm::mat4 &mat) const
+	void setMat4(const char* name, const glm::mat4 &mat) const
 	{
-		glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		glUniformMatrix4fv(glGetUniformLocation(ID, name), 1, GL_FALSE, &mat[0][0]);
 	}
 
 private:
-	// utility function for checking shader compilation/linking errors.
+	// utility function for checking shader compilation/linking errors, returns true on success.
 	// ------------------------------------------------------------------------
-	void checkCompileErrors(GLuint shader, std::string type)
+	bool checkCompileErrors(GLuint shader, std::string type)
 	{
 		GLint success;
 		GLchar infoLog[1024];
@@ -249,6 +270,7 @@ private:
 				std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
 			}
 		}
+		return success != 0;
 	}
 };
 
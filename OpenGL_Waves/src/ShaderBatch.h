@@ -0,0 +1,199 @@
+#pragma once
+
+#ifndef SHADERBATCH_H
+#define SHADERBATCH_H
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <thread>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "ShaderCache.h"
+
+#ifndef GL_MAX_SHADER_COMPILER_THREADS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// Collects the programs created between begin() and finish() so that every compile and
+// link is submitted before the first status query. With GL_KHR_parallel_shader_compile
+// (or the ARB variant) the driver compiles them on its own threads and finish() only
+// blocks on the slowest program instead of the sum of all of them.
+class ShaderBatch
+{
+public:
+	ShaderBatch() {}
+
+	~ShaderBatch()
+	{
+		if (current() == this)
+			finish();
+	}
+
+	// the batch programs built by Shader(ShaderCode) on this thread are deferred to, nullptr when none is open
+	static ShaderBatch*& current()
+	{
+		static thread_local ShaderBatch* batch = nullptr;
+		return batch;
+	}
+
+	void begin()
+	{
+		parallel = hasParallelCompile();
+		if (parallel)
+		{
+			typedef void (APIENTRY *MaxShaderCompilerThreadsProc)(GLuint count);
+			MaxShaderCompilerThreadsProc maxThreads = (MaxShaderCompilerThreadsProc)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+			if (maxThreads == nullptr)
+				maxThreads = (MaxShaderCompilerThreadsProc)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+			// 0xFFFFFFFF lets the implementation pick the thread count
+			if (maxThreads != nullptr)
+				maxThreads(0xFFFFFFFF);
+		}
+
+		beginTime = glfwGetTime();
+		current() = this;
+	}
+
+	// called by Shader after glLinkProgram, the shader objects are released once checked
+	void add(GLuint program, GLuint vertex, GLuint fragment, GLuint geometry, unsigned long long cacheKey)
+	{
+		Pending p;
+		p.Program = program;
+		p.Shaders[0] = vertex;
+		p.Shaders[1] = fragment;
+		p.Shaders[2] = geometry;
+		p.CacheKey = cacheKey;
+		pending.push_back(p);
+	}
+
+	///<summary>
+	/// Waits for every submitted program, reports compile and link errors and stores the
+	/// successful ones in the ShaderCache. Returns the number of programs that failed.
+	///</summary>
+	unsigned int finish()
+	{
+		if (current() == this)
+			current() = nullptr;
+
+		double submitted = glfwGetTime();
+		unsigned int programs = (unsigned int)pending.size();
+		unsigned int failed = 0;
+
+		while (!pending.empty())
+		{
+			bool progress = false;
+			for (size_t i = 0; i < pending.size();)
+			{
+				// without the extension the first status query blocks, so programs are taken in order
+				if (parallel)
+				{
+					GLint complete = GL_FALSE;
+					glGetProgramiv(pending[i].Program, GL_COMPLETION_STATUS_KHR, &complete);
+					if (!complete)
+					{
+						++i;
+						continue;
+					}
+				}
+
+				if (!check(pending[i]))
+					failed++;
+
+				pending[i] = pending.back();
+				pending.pop_back();
+				progress = true;
+			}
+
+			if (!progress)
+				std::this_thread::yield();
+		}
+
+		double finished = glfwGetTime();
+		std::cout << "SHADER_BATCH::" << programs << " programs, submit " << (submitted - beginTime) * 1000.0
+			<< " ms, wait " << (finished - submitted) * 1000.0 << " ms" << (parallel ? " (parallel)" : "") << std::endl;
+
+		return failed;
+	}
+
+	bool isParallel() const
+	{
+		return parallel;
+	}
+
+private:
+	struct Pending
+	{
+		GLuint Program = 0;
+		GLuint Shaders[3];
+		unsigned long long CacheKey = 0;
+	};
+
+	std::vector<Pending> pending;
+	bool parallel = false;
+	double beginTime = 0.0;
+
+	// batches are tied to the scope that opened them
+	ShaderBatch(const ShaderBatch&);
+	ShaderBatch& operator=(const ShaderBatch&);
+
+	static bool hasParallelCompile()
+	{
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (GLint i = 0; i < count; ++i)
+		{
+			const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+			if (name == nullptr)
+				continue;
+			std::string extension(name);
+			if (extension == "GL_KHR_parallel_shader_compile" || extension == "GL_ARB_parallel_shader_compile")
+				return true;
+		}
+		return false;
+	}
+
+	bool check(const Pending& p) const
+	{
+		static const char* types[] = { "VERTEX", "FRAGMENT", "GEOMETRY" };
+		GLint success;
+		GLchar infoLog[1024];
+		bool ok = true;
+
+		for (int s = 0; s < 3; ++s)
+		{
+			if (p.Shaders[s] == 0)
+				continue;
+
+			glGetShaderiv(p.Shaders[s], GL_COMPILE_STATUS, &success);
+			if (!success)
+			{
+				glGetShaderInfoLog(p.Shaders[s], 1024, NULL, infoLog);
+				std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << types[s] << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+				ok = false;
+			}
+			glDeleteShader(p.Shaders[s]);
+		}
+
+		glGetProgramiv(p.Program, GL_LINK_STATUS, &success);
+		if (!success)
+		{
+			glGetProgramInfoLog(p.Program, 1024, NULL, infoLog);
+			std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: PROGRAM\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+			ok = false;
+		}
+		else
+		{
+			ShaderCache::instance().store(p.Program, p.CacheKey);
+		}
+
+		return ok;
+	}
+};
+
+#endif // SHADERBATCH_H
@@ -0,0 +1,230 @@
+#pragma once
+
+#ifndef SHADERCACHE_H
+#define SHADERCACHE_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <mutex>
+
+#include <glad/glad.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// Stores linked program binaries on disk, keyed by a hash of the shader sources and the
+// driver (vendor, renderer, version). A binary the driver rejects is treated as a miss,
+// so the caller falls back to compiling from source. Programs may be built on more than
+// one context/thread (see ShaderPermutations), so the public calls are serialised.
+class ShaderCache
+{
+public:
+	static ShaderCache& instance()
+	{
+		static ShaderCache cache;
+		return cache;
+	}
+
+	void setDirectory(const std::string& dir)
+	{
+		directory = dir;
+	}
+
+	unsigned long long makeKey(const char* vertexCode, const char* fragmentCode, const char* geometryCode)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		unsigned long long hash = FNV_OFFSET;
+		hash = hashString(hash, driverString().c_str());
+		hash = hashString(hash, vertexCode);
+		hash = hashString(hash, fragmentCode);
+		hash = hashString(hash, geometryCode);
+		return hash;
+	}
+
+	// loads the cached binary into program, returns false on a miss or a driver mismatch
+	bool load(GLuint program, unsigned long long key)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!isSupported())
+			return false;
+		if (!readEnabled)
+		{
+			misses++;
+			return false;
+		}
+
+		std::ifstream file(pathFor(key).c_str(), std::ios::binary);
+		if (!file)
+		{
+			misses++;
+			return false;
+		}
+
+		Header header;
+		file.read(reinterpret_cast<char*>(&header), sizeof(header));
+		if (!file || header.magic != MAGIC || header.version != VERSION || header.key != key)
+		{
+			misses++;
+			return false;
+		}
+
+		std::vector<char> binary(header.length);
+		file.read(binary.data(), header.length);
+		if (!file)
+		{
+			misses++;
+			return false;
+		}
+
+		glProgramBinary(program, header.format, binary.data(), (GLsizei)header.length);
+
+		GLint success;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success)
+		{
+			// driver update or different GPU, the caller recompiles and overwrites the entry
+			misses++;
+			return false;
+		}
+
+		hits++;
+		return true;
+	}
+
+	// call before glLinkProgram so the driver keeps the binary around
+	void prepare(GLuint program)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (isSupported())
+			glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+
+	void store(GLuint program, unsigned long long key)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!isSupported())
+			return;
+
+		GLint length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0)
+			return;
+
+		std::vector<char> binary(length);
+		Header header;
+		header.magic = MAGIC;
+		header.version = VERSION;
+		header.key = key;
+		glGetProgramBinary(program, length, NULL, &header.format, binary.data());
+		header.length = (unsigned int)length;
+
+		makeDirectory();
+		std::ofstream file(pathFor(key).c_str(), std::ios::binary | std::ios::trunc);
+		if (!file)
+		{
+			std::cout << "ERROR::SHADER_CACHE::FILE_NOT_SUCCESFULLY_WRITTEN " << pathFor(key) << std::endl;
+			return;
+		}
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(binary.data(), length);
+	}
+
+	// with reads disabled every program is compiled and the entries are rewritten, used for cold start timings
+	void setReadEnabled(bool enabled)
+	{
+		readEnabled = enabled;
+	}
+
+	unsigned int getHits() const { return hits; }
+	unsigned int getMisses() const { return misses; }
+
+private:
+	struct Header
+	{
+		unsigned int magic;
+		unsigned int version;
+		unsigned long long key;
+		GLenum format;
+		unsigned int length;
+	};
+
+	static const unsigned int MAGIC = 0x5347574F;	// "OWGS"
+	static const unsigned int VERSION = 1;
+	static const unsigned long long FNV_OFFSET = 14695981039346656037ULL;
+	static const unsigned long long FNV_PRIME = 1099511628211ULL;
+
+	std::mutex mutex;
+	std::string directory = "shadercache";
+	std::string driver;
+	int supported = -1;
+	bool readEnabled = true;
+	unsigned int hits = 0;
+	unsigned int misses = 0;
+
+	ShaderCache() {}
+
+	bool isSupported()
+	{
+		if (supported < 0)
+		{
+			GLint formats = 0;
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+			supported = (formats > 0) ? 1 : 0;
+		}
+		return supported == 1;
+	}
+
+	const std::string& driverString()
+	{
+		if (driver.empty())
+		{
+			const GLubyte* vendor = glGetString(GL_VENDOR);
+			const GLubyte* renderer = glGetString(GL_RENDERER);
+			const GLubyte* version = glGetString(GL_VERSION);
+			driver = std::string(vendor ? (const char*)vendor : "") + "|" +
+				(renderer ? (const char*)renderer : "") + "|" +
+				(version ? (const char*)version : "");
+		}
+		return driver;
+	}
+
+	static unsigned long long hashString(unsigned long long hash, const char* str)
+	{
+		// the separator keeps ("ab", "c") and ("a", "bc") apart
+		if (str != nullptr)
+		{
+			for (const char* c = str; *c != '\0'; ++c)
+			{
+				hash ^= (unsigned char)*c;
+				hash *= FNV_PRIME;
+			}
+		}
+		hash ^= 0xFF;
+		hash *= FNV_PRIME;
+		return hash;
+	}
+
+	std::string pathFor(unsigned long long key) const
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.bin", key);
+		return directory + "/" + name;
+	}
+
+	void makeDirectory() const
+	{
+#ifdef _WIN32
+		_mkdir(directory.c_str());
+#else
+		mkdir(directory.c_str(), 0755);
+#endif
+	}
+};
+
+#endif // SHADERCACHE_H
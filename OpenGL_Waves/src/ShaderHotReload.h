@@ -0,0 +1,220 @@
+#pragma once
+
+#ifndef SHADERHOTRELOAD_H
+#define SHADERHOTRELOAD_H
+
+#include "GL_Util.h"
+#include "FileWatcher.h"
+#include "ShaderSource.h"
+#include "ShaderPermutations.h"
+
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+// Rebuilds file backed programs when their sources are saved. The files are read and
+// preprocessed on the FileWatcher thread and compiled on the ShaderCompileThread; update()
+// swaps the finished programs in at the start of a frame, so an edit never stalls drawing.
+// A program that fails to compile leaves the previous one in place.
+// Note: the watcher preprocesses against the ShaderSource registry, so modules must not be
+// registered once reloading has started.
+class ShaderHotReload
+{
+public:
+	static ShaderHotReload& instance()
+	{
+		static ShaderHotReload hotReload;
+		return hotReload;
+	}
+
+	///<summary>
+	/// Builds target from the files now and again whenever one of them changes. The target
+	/// must stay at the same address until unwatch() is called.
+	///</summary>
+	bool watch(Shader* target, const std::string& vertexPath, const std::string& fragmentPath, const ShaderSource::Defines& defines = ShaderSource::Defines())
+	{
+		std::string vertexCode, fragmentCode;
+		if (!readSources(vertexPath, fragmentPath, defines, vertexCode, fragmentCode))
+			return false;
+
+		Shader::ShaderCode code;
+		code.vertexCode = vertexCode.c_str();
+		code.fragmentCode = fragmentCode.c_str();
+		*target = Shader(code);
+
+		Entry entry;
+		entry.Target = target;
+		entry.VertexPath = vertexPath;
+		entry.FragmentPath = fragmentPath;
+		entry.Defines = defines;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			entries.push_back(entry);
+		}
+
+		watcher.watch(vertexPath);
+		watcher.watch(fragmentPath);
+		return true;
+	}
+
+	void unwatch(Shader* target)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (size_t i = 0; i < entries.size(); ++i)
+		{
+			if (entries[i].Target == target)
+			{
+				entries[i] = entries.back();
+				entries.pop_back();
+				return;
+			}
+		}
+	}
+
+	void start()
+	{
+		watcher.start([this](const std::string& path) { onChange(path); });
+	}
+
+	void stop()
+	{
+		watcher.stop();
+	}
+
+	///<summary>
+	/// Swaps in every rebuilt program whose compile has finished. Call on the main thread at
+	/// the frame boundary, before anything is drawn.
+	///</summary>
+	void update()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (size_t i = 0; i < entries.size(); ++i)
+		{
+			Entry& entry = entries[i];
+			while (!entry.Pending.empty() && finish(entry, *entry.Pending.front()))
+				entry.Pending.pop_front();
+		}
+	}
+
+	static bool readFile(const std::string& path, std::string& out)
+	{
+		std::ifstream file(path.c_str());
+		if (!file)
+		{
+			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+			return false;
+		}
+		std::stringstream stream;
+		stream << file.rdbuf();
+		out = stream.str();
+		return true;
+	}
+
+private:
+	typedef ShaderCompileThread::Job Job;
+
+	struct Entry
+	{
+		Shader* Target = nullptr;
+		std::string VertexPath;
+		std::string FragmentPath;
+		ShaderSource::Defines Defines;
+		std::deque<std::shared_ptr<Job> > Pending;	// in save order, the last one wins
+	};
+
+	std::mutex mutex;
+	std::vector<Entry> entries;
+	FileWatcher watcher;
+
+	ShaderHotReload() {}
+	~ShaderHotReload() { stop(); }
+
+	static bool readSources(const std::string& vertexPath, const std::string& fragmentPath, const ShaderSource::Defines& defines, std::string& vertexCode, std::string& fragmentCode)
+	{
+		std::string vertexFile, fragmentFile;
+		if (!readFile(vertexPath, vertexFile) || !readFile(fragmentPath, fragmentFile))
+			return false;
+
+		vertexCode = ShaderSource::preprocess(vertexFile, defines);
+		fragmentCode = ShaderSource::preprocess(fragmentFile, defines);
+		return true;
+	}
+
+	// watcher thread
+	void onChange(const std::string& path)
+	{
+		std::vector<Entry> changed;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (size_t i = 0; i < entries.size(); ++i)
+			{
+				if (entries[i].VertexPath == path || entries[i].FragmentPath == path)
+					changed.push_back(entries[i]);
+			}
+		}
+
+		for (size_t i = 0; i < changed.size(); ++i)
+		{
+			std::shared_ptr<Job> job = std::make_shared<Job>();
+			if (!readSources(changed[i].VertexPath, changed[i].FragmentPath, changed[i].Defines, job->VertexCode, job->FragmentCode))
+				continue;
+
+			std::cout << "SHADER_HOT_RELOAD::" << path << " changed, rebuilding" << std::endl;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				for (size_t e = 0; e < entries.size(); ++e)
+				{
+					if (entries[e].Target == changed[i].Target)
+						entries[e].Pending.push_back(job);
+				}
+			}
+			if (ShaderCompileThread::instance().isRunning())
+				ShaderCompileThread::instance().submit(job);
+		}
+	}
+
+	// true once the job is done with, swapping the program in when it linked
+	bool finish(Entry& entry, Job& job)
+	{
+		GLuint program = 0;
+		if (job.Status == Job::QUEUED)
+		{
+			// no compile thread, build it here
+			if (ShaderCompileThread::instance().isRunning())
+				return false;
+
+			Shader::ShaderCode code;
+			code.vertexCode = job.VertexCode.c_str();
+			code.fragmentCode = job.FragmentCode.c_str();
+			program = Shader(code).ID;
+		}
+		else
+		{
+			GLenum wait = glClientWaitSync(job.Fence, 0, 0);
+			if (wait != GL_ALREADY_SIGNALED && wait != GL_CONDITION_SATISFIED)
+				return false;
+			glDeleteSync(job.Fence);
+			program = job.Program;
+		}
+
+		GLint success;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success)
+		{
+			// the errors were logged by Shader, keep the last good program
+			job.Status = Job::FAILED;
+			glDeleteProgram(program);
+			return true;
+		}
+
+		job.Status = Job::READY;
+		glDeleteProgram(entry.Target->ID);
+		entry.Target->ID = program;
+		std::cout << "SHADER_HOT_RELOAD::" << entry.VertexPath << " + " << entry.FragmentPath << " reloaded" << std::endl;
+		return true;
+	}
+};
+
+#endif // SHADERHOTRELOAD_H
@@ -0,0 +1,258 @@
+#pragma once
+
+#ifndef SHADERLIBRARY_H
+#define SHADERLIBRARY_H
+
+#include "ShaderSource.h"
+#include "ShaderPermutations.h"
+#include "VertexPacking.h"
+
+// GLSL modules shared between the scene shaders, registered with ShaderSource.
+//
+//	"lighting"		light structs, uniforms and CalcDirLight/CalcPointLight/CalcSpotLight
+//	"lit.frag"		lit fragment shader, see the permutation defines below
+//	"octahedral"	VertexPacking::OctahedralDecodeSource
+//	"height_grid"	VertexPacking::HeightGridDecodeSource
+//
+// lit.frag permutation defines:
+//	NR_POINT_LIGHTS	size of the pointLights array (3 when not given)
+//	TEXTURED		take the diffuse/specular colours from material.diffuse/specular instead of objectColor
+//	SPOT_LIGHT		add the camera spot light
+class ShaderLibrary
+{
+public:
+	// ShaderPermutations keys of lit.frag
+	enum LitFeature
+	{
+		LIT_POINT_LIGHTS_SHIFT = 0,			// 3 bits, the NR_POINT_LIGHTS value
+		LIT_TEXTURED = 1 << 3,
+		LIT_SPOT_LIGHT = 1 << 4
+	};
+
+	static unsigned int litKey(unsigned int pointLights, bool textured, bool spotLight)
+	{
+		return (pointLights << LIT_POINT_LIGHTS_SHIFT) | (textured ? LIT_TEXTURED : 0) | (spotLight ? LIT_SPOT_LIGHT : 0);
+	}
+
+	static std::vector<ShaderPermutations::Feature> litFeatures()
+	{
+		ShaderPermutations::Feature features[] = {
+			{ "NR_POINT_LIGHTS", LIT_POINT_LIGHTS_SHIFT, 3 },
+			{ "TEXTURED", 3, 1 },
+			{ "SPOT_LIGHT", 4, 1 }
+		};
+		return std::vector<ShaderPermutations::Feature>(features, features + 3);
+	}
+
+	// fields of one entry of the lighting module's pointLights array
+	enum PointLightField
+	{
+		POINT_LIGHT_POSITION,
+		POINT_LIGHT_AMBIENT,
+		POINT_LIGHT_DIFFUSE,
+		POINT_LIGHT_SPECULAR,
+		POINT_LIGHT_CONSTANT,
+		POINT_LIGHT_LINEAR,
+		POINT_LIGHT_QUADRATIC,
+		POINT_LIGHT_FIELD_COUNT
+	};
+
+	enum { MAX_POINT_LIGHTS = 7 };	// largest NR_POINT_LIGHTS the 3 key bits hold
+
+	///<summary>
+	/// "pointLights[index].field", formatted once for all lights so the per-frame uniform
+	/// updates do not build strings.
+	///</summary>
+	static const char* pointLightUniform(unsigned int index, PointLightField field)
+	{
+		static const std::vector<std::string> names = []()
+		{
+			const char* fields[POINT_LIGHT_FIELD_COUNT] = { "position", "ambient", "diffuse", "specular", "constant", "linear", "quadratic" };
+			std::vector<std::string> table;
+			for (unsigned int light = 0; light < MAX_POINT_LIGHTS; ++light)
+			{
+				for (unsigned int f = 0; f < POINT_LIGHT_FIELD_COUNT; ++f)
+					table.push_back("pointLights[" + std::to_string(light) + "]." + fields[f]);
+			}
+			return table;
+		}();
+		return names[index * POINT_LIGHT_FIELD_COUNT + field].c_str();
+	}
+
+	static void registerModules()
+	{
+		static bool registered = false;
+		if (registered)
+			return;
+		registered = true;
+
+		ShaderSource::registerModule("lighting", LightingSource);
+		ShaderSource::registerModule("lit.frag", LitFragmentSource);
+		ShaderSource::registerModule("octahedral", VertexPacking::OctahedralDecodeSource);
+		ShaderSource::registerModule("height_grid", VertexPacking::HeightGridDecodeSource);
+	}
+
+	// expanded source of a library module for the given defines
+	static const std::string& get(const std::string& name, const ShaderSource::Defines& defines = ShaderSource::Defines())
+	{
+		registerModules();
+		return ShaderSource::permutation(name, defines);
+	}
+
+	static constexpr const char* LightingSource =
+		"#ifndef NR_POINT_LIGHTS\n"
+		"#define NR_POINT_LIGHTS 3\n"
+		"#endif\n"
+
+		"struct Material {\n"
+		"	sampler2D diffuse;\n"
+		"	sampler2D specular;\n"
+		"	float shininess;\n"
+		"};\n"
+
+		"struct DirLight {\n"
+		"	vec3 direction;\n"
+
+		"	vec3 ambient;\n"
+		"	vec3 diffuse;\n"
+		"	vec3 specular;\n"
+		"};\n"
+
+		"struct PointLight {\n"
+		"	vec3 position;\n"
+
+		"	float constant;\n"
+		"	float linear;\n"
+		"	float quadratic;\n"
+
+		"	vec3 ambient;\n"
+		"	vec3 diffuse;\n"
+		"	vec3 specular;\n"
+		"};\n"
+
+		"struct SpotLight {\n"
+		"	vec3 position;\n"
+		"	vec3 direction;\n"
+		"	float cutOff;\n"
+		"	float outerCutOff;\n"
+
+		"	float constant;\n"
+		"	float linear;\n"
+		"	float quadratic;\n"
+
+		"	vec3 ambient;\n"
+		"	vec3 diffuse;\n"
+		"	vec3 specular;\n"
+		"};\n"
+
+		"uniform DirLight dirLight;\n"
+		"#if NR_POINT_LIGHTS > 0\n"
+		"uniform PointLight pointLights[NR_POINT_LIGHTS];\n"
+		"#endif\n"
+		"#ifdef SPOT_LIGHT\n"
+		"uniform SpotLight spotLight;\n"
+		"#endif\n"
+		"uniform Material material;\n"
+
+		"// calculates the color when using a directional light.\n"
+		"vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 diffuseColor, vec3 specularColor)\n"
+		"{\n"
+		"	vec3 lightDir = normalize(-light.direction);\n"
+		"	// diffuse shading\n"
+		"	float diff = max(dot(normal, lightDir), 0.0);\n"
+		"	// specular shading\n"
+		"	vec3 reflectDir = reflect(-lightDir, normal);\n"
+		"	float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);\n"
+		"	// combine results\n"
+		"	vec3 ambient = light.ambient * diffuseColor;\n"
+		"	vec3 diffuse = light.diffuse * diff * diffuseColor;\n"
+		"	vec3 specular = light.specular * spec * specularColor;\n"
+		"	return (ambient + diffuse + specular);\n"
+		"}\n"
+
+		"// calculates the color when using a point light.\n"
+		"vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 diffuseColor, vec3 specularColor)\n"
+		"{\n"
+		"	vec3 lightDir = normalize(light.position - fragPos);\n"
+		"	// diffuse shading\n"
+		"	float diff = max(dot(normal, lightDir), 0.0);\n"
+		"	// specular shading\n"
+		"	vec3 reflectDir = reflect(-lightDir, normal);\n"
+		"	float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);\n"
+		"	// attenuation\n"
+		"	float distance = length(light.position - fragPos);\n"
+		"	float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));\n"
+		"	// combine results\n"
+		"	vec3 ambient = light.ambient * diffuseColor;\n"
+		"	vec3 diffuse = light.diffuse * diff * diffuseColor;\n"
+		"	vec3 specular = light.specular * spec * specularColor;\n"
+		"	return (ambient + diffuse + specular) * attenuation;\n"
+		"}\n"
+
+		"// calculates the color when using a spot light.\n"
+		"vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 diffuseColor, vec3 specularColor)\n"
+		"{\n"
+		"	vec3 lightDir = normalize(light.position - fragPos);\n"
+		"	// diffuse shading\n"
+		"	float diff = max(dot(normal, lightDir), 0.0);\n"
+		"	// specular shading\n"
+		"	vec3 reflectDir = reflect(-lightDir, normal);\n"
+		"	float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);\n"
+		"	// attenuation\n"
+		"	float distance = length(light.position - fragPos);\n"
+		"	float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));\n"
+		"	// spotlight intensity\n"
+		"	float theta = dot(lightDir, normalize(-light.direction));\n"
+		"	float epsilon = light.cutOff - light.outerCutOff;\n"
+		"	float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);\n"
+		"	// combine results\n"
+		"	vec3 ambient = light.ambient * diffuseColor;\n"
+		"	vec3 diffuse = light.diffuse * diff * diffuseColor;\n"
+		"	vec3 specular = light.specular * spec * specularColor;\n"
+		"	return (ambient + diffuse + specular) * attenuation * intensity;\n"
+		"}\n";
+
+	static constexpr const char* LitFragmentSource = "#version 330 core\n"
+		"#include \"lighting\"\n"
+
+		"out vec4 FragColor;\n"
+
+		"in vec3 FragPos;\n"
+		"in vec3 Normal;\n"
+		"in vec2 TexCoords;\n"
+
+		"uniform vec3 objectColor;\n"
+		"uniform vec3 viewPos;\n"
+
+		"void main()\n"
+		"{\n"
+		"	// properties\n"
+		"	vec3 norm = normalize(Normal);\n"
+		"	vec3 viewDir = normalize(viewPos - FragPos);\n"
+		"#ifdef TEXTURED\n"
+		"	vec3 diffuseColor = vec3(texture(material.diffuse, TexCoords));\n"
+		"	vec3 specularColor = vec3(texture(material.specular, TexCoords));\n"
+		"#else\n"
+		"	vec3 diffuseColor = objectColor;\n"
+		"	vec3 specularColor = objectColor;\n"
+		"#endif\n"
+
+		"	// phase 1: directional lighting\n"
+		"	vec3 result = CalcDirLight(dirLight, norm, viewDir, diffuseColor, specularColor);\n"
+
+		"	// phase 2: point lights\n"
+		"#if NR_POINT_LIGHTS > 0\n"
+		"	for (int i = 0; i < NR_POINT_LIGHTS; i++)\n"
+		"		result += CalcPointLight(pointLights[i], norm, FragPos, viewDir, diffuseColor, specularColor);\n"
+		"#endif\n"
+
+		"#ifdef SPOT_LIGHT\n"
+		"	// phase 3: spot light\n"
+		"	result += CalcSpotLight(spotLight, norm, FragPos, viewDir, diffuseColor, specularColor);\n"
+		"#endif\n"
+
+		"	FragColor = vec4(result, 1.0);\n"
+		"}\n";
+};
+
+#endif // SHADERLIBRARY_H
@@ -0,0 +1,368 @@
+#pragma once
+
+#ifndef SHADERPERMUTATIONS_H
+#define SHADERPERMUTATIONS_H
+
+#include "GL_Util.h"
+#include "ShaderSource.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+// Compiles programs on a hidden window whose context shares objects with the main one.
+// Finished programs are handed back with a fence, the main thread only picks them up
+// once the fence has signalled so it never waits on the driver.
+class ShaderCompileThread
+{
+public:
+	struct Job
+	{
+		enum State { QUEUED, COMPILED, READY, FAILED };
+
+		std::string VertexCode;
+		std::string FragmentCode;
+		std::atomic<int> Status;
+		GLuint Program = 0;
+		GLsync Fence = 0;
+
+		Job() : Status(QUEUED) {}
+	};
+
+	static ShaderCompileThread& instance()
+	{
+		static ShaderCompileThread compileThread;
+		return compileThread;
+	}
+
+	///<summary>
+	/// Creates the shared context and starts the worker. Must be called on the main thread
+	/// while the main context is current, the window hints of the main window are reused.
+	///</summary>
+	bool start(GLFWwindow* mainWindow)
+	{
+		if (running)
+			return true;
+
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		context = glfwCreateWindow(1, 1, "", NULL, mainWindow);
+		glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+		if (!context)
+		{
+			std::cout << "ERROR::SHADER_COMPILE_THREAD::CONTEXT_NOT_CREATED, permutations compile on first use" << std::endl;
+			return false;
+		}
+
+		running = true;
+		worker = std::thread(&ShaderCompileThread::run, this);
+		return true;
+	}
+
+	void stop()
+	{
+		if (!running)
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			running = false;
+		}
+		wake.notify_one();
+		worker.join();
+
+		glfwDestroyWindow(context);
+		context = nullptr;
+	}
+
+	bool isRunning() const
+	{
+		return running;
+	}
+
+	void submit(const std::shared_ptr<Job>& job)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			queue.push_back(job);
+		}
+		wake.notify_one();
+	}
+
+private:
+	GLFWwindow* context = nullptr;
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::deque<std::shared_ptr<Job> > queue;
+	std::atomic<bool> running{ false };
+
+	ShaderCompileThread() {}
+	~ShaderCompileThread() { stop(); }
+
+	void run()
+	{
+		glfwMakeContextCurrent(context);
+
+		for (;;)
+		{
+			std::shared_ptr<Job> job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [this] { return !running || !queue.empty(); });
+				if (!running)
+					break;
+				job = queue.front();
+				queue.pop_front();
+			}
+
+			Shader::ShaderCode code;
+			code.vertexCode = job->VertexCode.c_str();
+			code.fragmentCode = job->FragmentCode.c_str();
+			Shader shader(code);
+
+			// the fence makes the finished program visible to the main context
+			job->Program = shader.ID;
+			job->Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			glFlush();
+			job->Status = Job::COMPILED;
+		}
+
+		glfwMakeContextCurrent(NULL);
+	}
+};
+
+// Programs of one shader family (a vertex source and a fragment module from the
+// ShaderSource registry) keyed by a feature bitmask. A permutation is compiled the first
+// time it is asked for, on the ShaderCompileThread when it runs, and the generic
+// permutation is returned until it is ready. Every key used is recorded so the next
+// run can precompile it at load time through the warm-up list.
+class ShaderPermutations
+{
+public:
+	// a run of Bits bits at Shift in the key, single bits are plain #defines, wider fields pass their value
+	struct Feature
+	{
+		const char* Define;
+		unsigned int Shift;
+		unsigned int Bits;
+	};
+
+	ShaderPermutations() {}
+
+	~ShaderPermutations()
+	{
+		// failed permutations alias the generic program, so every id is deleted once
+		std::set<GLuint> ids;
+		for (std::unordered_map<unsigned int, Shader>::iterator it = programs.begin(); it != programs.end(); ++it)
+			ids.insert(it->second.ID);
+		for (std::set<GLuint>::iterator it = ids.begin(); it != ids.end(); ++it)
+			glDeleteProgram(*it);
+	}
+
+	///<summary>
+	/// Compiles the generic permutation and every permutation of this family in the warm-up
+	/// list right away, the rest is compiled lazily by get().
+	///</summary>
+	void init(const std::string& familyName, const std::string& vertex, const std::string& fragmentModule, const std::vector<Feature>& featureList, unsigned int genericKey)
+	{
+		name = familyName;
+		vertexSource = vertex;
+		fragmentName = fragmentModule;
+		features = featureList;
+		generic = genericKey;
+
+		compileNow(generic);
+
+		std::vector<unsigned int>& warm = warmupList()[name];
+		for (size_t i = 0; i < warm.size(); ++i)
+			compileNow(warm[i]);
+	}
+
+	///<summary>
+	/// The program for key, or the generic one while it is still compiling.
+	///</summary>
+	Shader& get(unsigned int key)
+	{
+		std::unordered_map<unsigned int, Shader>::iterator it = programs.find(key);
+		if (it != programs.end())
+			return it->second;
+
+		std::unordered_map<unsigned int, std::shared_ptr<ShaderCompileThread::Job> >::iterator job = pending.find(key);
+		if (job == pending.end())
+		{
+			recordKey(key);
+			if (!ShaderCompileThread::instance().isRunning())
+				return compileNow(key);
+			request(key);
+		}
+		else if (collect(key, job->second))
+		{
+			pending.erase(job);
+			return programs[key];
+		}
+
+		return programs[generic];
+	}
+
+	///<summary>
+	/// Starts compiling key ahead of the first get() for it, on the ShaderCompileThread when it
+	/// runs and right away otherwise.
+	///</summary>
+	void prewarm(unsigned int key)
+	{
+		if (programs.find(key) != programs.end() || pending.find(key) != pending.end())
+			return;
+
+		if (!ShaderCompileThread::instance().isRunning())
+			compileNow(key);
+		else
+			request(key);
+	}
+
+	bool isReady(unsigned int key) const
+	{
+		return programs.find(key) != programs.end();
+	}
+
+	ShaderSource::Defines definesFor(unsigned int key) const
+	{
+		ShaderSource::Defines defines;
+		for (size_t i = 0; i < features.size(); ++i)
+		{
+			unsigned int value = (key >> features[i].Shift) & ((1u << features[i].Bits) - 1);
+			if (features[i].Bits == 1)
+			{
+				if (value)
+					defines.push_back(std::make_pair(std::string(features[i].Define), std::string()));
+			}
+			else
+			{
+				defines.push_back(std::make_pair(std::string(features[i].Define), std::to_string(value)));
+			}
+		}
+		return defines;
+	}
+
+	///<summary>
+	/// Reads "family key" lines written by saveWarmupList. Call before the families are initialised.
+	///</summary>
+	static void loadWarmupList(const std::string& path)
+	{
+		std::ifstream file(path.c_str());
+		std::string family;
+		unsigned int key;
+		while (file >> family >> std::hex >> key)
+			warmupList()[family].push_back(key);
+	}
+
+	static void saveWarmupList(const std::string& path)
+	{
+		std::ofstream file(path.c_str(), std::ios::trunc);
+		if (!file)
+		{
+			std::cout << "ERROR::SHADER_PERMUTATIONS::FILE_NOT_SUCCESFULLY_WRITTEN " << path << std::endl;
+			return;
+		}
+		for (std::set<std::pair<std::string, unsigned int> >::const_iterator it = usedKeys().begin(); it != usedKeys().end(); ++it)
+			file << it->first << " " << std::hex << it->second << "\n";
+	}
+
+private:
+	std::string name;
+	std::string vertexSource;
+	std::string fragmentName;
+	std::vector<Feature> features;
+	unsigned int generic = 0;
+
+	std::unordered_map<unsigned int, Shader> programs;
+	std::unordered_map<unsigned int, std::shared_ptr<ShaderCompileThread::Job> > pending;
+
+	// the programs are owned by the family
+	ShaderPermutations(const ShaderPermutations&);
+	ShaderPermutations& operator=(const ShaderPermutations&);
+
+	static std::map<std::string, std::vector<unsigned int> >& warmupList()
+	{
+		static std::map<std::string, std::vector<unsigned int> > list;
+		return list;
+	}
+
+	static std::set<std::pair<std::string, unsigned int> >& usedKeys()
+	{
+		static std::set<std::pair<std::string, unsigned int> > keys;
+		return keys;
+	}
+
+	void recordKey(unsigned int key)
+	{
+		usedKeys().insert(std::make_pair(name, key));
+	}
+
+	Shader& compileNow(unsigned int key)
+	{
+		std::unordered_map<unsigned int, Shader>::iterator it = programs.find(key);
+		if (it != programs.end())
+			return it->second;
+
+		recordKey(key);
+		ShaderSource::Defines defines = definesFor(key);
+		std::string vertexCode = ShaderSource::preprocess(vertexSource, defines);
+
+		Shader::ShaderCode code;
+		code.vertexCode = vertexCode.c_str();
+		code.fragmentCode = ShaderSource::permutation(fragmentName, defines).c_str();
+		return programs[key] = Shader(code);
+	}
+
+	void request(unsigned int key)
+	{
+		// the sources are expanded here, the registry is not touched from the worker
+		std::shared_ptr<ShaderCompileThread::Job> job = std::make_shared<ShaderCompileThread::Job>();
+		ShaderSource::Defines defines = definesFor(key);
+		job->VertexCode = ShaderSource::preprocess(vertexSource, defines);
+		job->FragmentCode = ShaderSource::permutation(fragmentName, defines);
+
+		pending[key] = job;
+		ShaderCompileThread::instance().submit(job);
+	}
+
+	// moves a finished job into programs, true once the program can be used on this context
+	bool collect(unsigned int key, const std::shared_ptr<ShaderCompileThread::Job>& job)
+	{
+		if (job->Status != ShaderCompileThread::Job::COMPILED)
+			return false;
+
+		GLenum wait = glClientWaitSync(job->Fence, 0, 0);
+		if (wait != GL_ALREADY_SIGNALED && wait != GL_CONDITION_SATISFIED)
+			return false;
+		glDeleteSync(job->Fence);
+
+		GLint success;
+		glGetProgramiv(job->Program, GL_LINK_STATUS, &success);
+		if (!success)
+		{
+			// the worker already logged the errors, keep drawing with the generic permutation
+			job->Status = ShaderCompileThread::Job::FAILED;
+			glDeleteProgram(job->Program);
+			programs[key] = programs[generic];
+			return true;
+		}
+
+		job->Status = ShaderCompileThread::Job::READY;
+		Shader shader;
+		shader.ID = job->Program;
+		programs[key] = shader;
+		std::cout << "SHADER_PERMUTATIONS::" << name << " " << std::hex << key << std::dec << " ready" << std::endl;
+		return true;
+	}
+};
+
+#endif // SHADERPERMUTATIONS_H
@@ -0,0 +1,229 @@
+#pragma once
+
+#ifndef SHADERSOURCE_H
+#define SHADERSOURCE_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <sstream>
+#include <iostream>
+#include <unordered_map>
+#include <unordered_set>
+
+// A small GLSL preprocessor on top of a registry of named source modules.
+// Modules pull each other in with #include "name" (expanded once per program) and every
+// permutation gets its defines injected right after the #version line. Expanded sources
+// are cached by a hash of the module and the defines, so asking for the same permutation
+// twice returns the same string.
+class ShaderSource
+{
+public:
+	typedef std::vector<std::pair<std::string, std::string> > Defines;
+
+	///<summary>
+	/// Adds or replaces a module. Replacing a module with different code drops every cached
+	/// permutation, since any of them may include it.
+	///</summary>
+	static void registerModule(const std::string& name, const std::string& code)
+	{
+		unsigned long long codeHash = hash(code);
+		std::unordered_map<std::string, Module>::iterator it = modules().find(name);
+		if (it != modules().end())
+		{
+			if (it->second.Hash == codeHash)
+				return;
+			it->second.Code = code;
+			it->second.Hash = codeHash;
+			permutations().clear();
+			return;
+		}
+
+		Module module;
+		module.Code = code;
+		module.Hash = codeHash;
+		module.Index = (int)modules().size() + 1;	// source string 0 is reserved for inline roots
+		modules()[name] = module;
+	}
+
+	static bool hasModule(const std::string& name)
+	{
+		return modules().find(name) != modules().end();
+	}
+
+	///<summary>
+	/// Returns the expanded source of a registered module for the given defines. The string
+	/// stays valid until the module registry changes.
+	///</summary>
+	static const std::string& permutation(const std::string& name, const Defines& defines = Defines())
+	{
+		std::unordered_map<std::string, Module>::const_iterator it = modules().find(name);
+		if (it == modules().end())
+		{
+			std::cout << "ERROR::SHADER_SOURCE::MODULE_NOT_FOUND " << name << std::endl;
+			static const std::string empty;
+			return empty;
+		}
+
+		unsigned long long key = hashDefines(it->second.Hash, defines);
+		std::unordered_map<unsigned long long, std::string>::iterator cached = permutations().find(key);
+		if (cached != permutations().end())
+			return cached->second;
+
+		std::string& out = permutations()[key];
+		out = expandRoot(it->second.Code, it->second.Index, defines);
+		return out;
+	}
+
+	///<summary>
+	/// Expands a source that is not in the registry. Not cached.
+	///</summary>
+	static std::string preprocess(const std::string& source, const Defines& defines = Defines())
+	{
+		return expandRoot(source, 0, defines);
+	}
+
+	static unsigned long long hash(const std::string& str, unsigned long long seed = 14695981039346656037ULL)
+	{
+		unsigned long long h = seed;
+		for (size_t i = 0; i < str.size(); ++i)
+		{
+			h ^= (unsigned char)str[i];
+			h *= 1099511628211ULL;
+		}
+		return h;
+	}
+
+private:
+	struct Module
+	{
+		std::string Code;
+		unsigned long long Hash = 0;
+		int Index = 0;	// GLSL source string number used in #line, so errors point at the module
+	};
+
+	static const int MAX_INCLUDE_DEPTH = 16;
+
+	static std::unordered_map<std::string, Module>& modules()
+	{
+		static std::unordered_map<std::string, Module> registry;
+		return registry;
+	}
+
+	static std::unordered_map<unsigned long long, std::string>& permutations()
+	{
+		static std::unordered_map<unsigned long long, std::string> cache;
+		return cache;
+	}
+
+	static unsigned long long hashDefines(unsigned long long seed, const Defines& defines)
+	{
+		unsigned long long h = seed;
+		for (size_t i = 0; i < defines.size(); ++i)
+		{
+			h = hash(defines[i].first, h);
+			h = hash("=", h);
+			h = hash(defines[i].second, h);
+			h = hash(";", h);
+		}
+		return h;
+	}
+
+	static std::string expandRoot(const std::string& source, int index, const Defines& defines)
+	{
+		std::string out;
+		out.reserve(source.size() * 2);
+
+		std::istringstream stream(source);
+		std::string line;
+		int lineNumber = 0;
+		bool versionSeen = false;
+		std::unordered_set<std::string> included;
+
+		while (std::getline(stream, line))
+		{
+			lineNumber++;
+			if (!versionSeen && line.compare(0, 8, "#version") == 0)
+			{
+				// the defines have to follow #version, which must stay the first directive
+				out += line;
+				out += '\n';
+				for (size_t i = 0; i < defines.size(); ++i)
+					out += "#define " + defines[i].first + " " + defines[i].second + "\n";
+				out += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(index) + "\n";
+				versionSeen = true;
+				continue;
+			}
+			expandLine(line, lineNumber, index, out, included, 0);
+		}
+
+		if (!versionSeen)
+			std::cout << "ERROR::SHADER_SOURCE::MISSING_VERSION" << std::endl;
+
+		return out;
+	}
+
+	static void expandModule(const std::string& source, int index, std::string& out, std::unordered_set<std::string>& included, int depth)
+	{
+		std::istringstream stream(source);
+		std::string line;
+		int lineNumber = 0;
+
+		out += "#line 1 " + std::to_string(index) + "\n";
+		while (std::getline(stream, line))
+		{
+			lineNumber++;
+			expandLine(line, lineNumber, index, out, included, depth);
+		}
+	}
+
+	static void expandLine(const std::string& line, int lineNumber, int index, std::string& out, std::unordered_set<std::string>& included, int depth)
+	{
+		std::string name;
+		if (!parseInclude(line, name))
+		{
+			out += line;
+			out += '\n';
+			return;
+		}
+
+		std::unordered_map<std::string, Module>::const_iterator it = modules().find(name);
+		if (it == modules().end())
+		{
+			std::cout << "ERROR::SHADER_SOURCE::MODULE_NOT_FOUND " << name << std::endl;
+			return;
+		}
+		if (depth >= MAX_INCLUDE_DEPTH)
+		{
+			std::cout << "ERROR::SHADER_SOURCE::INCLUDE_TOO_DEEP " << name << std::endl;
+			return;
+		}
+
+		// every module is pasted once, which also breaks include cycles
+		if (included.insert(name).second)
+		{
+			expandModule(it->second.Code, it->second.Index, out, included, depth + 1);
+			out += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(index) + "\n";
+		}
+	}
+
+	static bool parseInclude(const std::string& line, std::string& name)
+	{
+		size_t start = line.find_first_not_of(" \t");
+		if (start == std::string::npos || line.compare(start, 8, "#include") != 0)
+			return false;
+
+		size_t open = line.find('"', start + 8);
+		size_t close = (open == std::string::npos) ? std::string::npos : line.find('"', open + 1);
+		if (close == std::string::npos)
+		{
+			std::cout << "ERROR::SHADER_SOURCE::MALFORMED_INCLUDE " << line << std::endl;
+			return false;
+		}
+
+		name = line.substr(open + 1, close - open - 1);
+		return true;
+	}
+};
+
+#endif // SHADERSOURCE_H
@@ -0,0 +1,254 @@
+#include "ShallowWaterSolver.h"
+#include "JobSystem.h"
+
+const float ShallowWaterSolver::GRAVITY = 9.81f;
+const float ShallowWaterSolver::WET_DEPTH = 1e-4f;
+
+namespace
+{
+	// flows keep this much of themselves from one step to the next, the rest is friction
+	const float FLOW_RETAINED = 0.995f;
+	// dry cells are drawn this far under the ground
+	const float DRY_OFFSET = 0.05f;
+}
+
+void ShallowWaterSolver::init(const VertexPacking::HeightGridData& grid)
+{
+	columns = grid.Columns;
+	rows = grid.Rows;
+	width = grid.Width;
+	depthExtent = grid.Depth;
+	cellSize = grid.Width / (grid.Columns - 1);
+	tilesX = (columns + TILE - 1) / TILE;
+	tilesZ = (rows + TILE - 1) / TILE;
+
+	size_t cells = (size_t)tilesX * tilesZ * TILE * TILE;
+	ground.assign(cells, 0.0f);
+	depths.assign(cells, 0.0f);
+	flowLeft.assign(cells, 0.0f);
+	flowRight.assign(cells, 0.0f);
+	flowUp.assign(cells, 0.0f);
+	flowDown.assign(cells, 0.0f);
+	tileWet.assign((size_t)tilesX * tilesZ, 0);
+	tileActive.assign((size_t)tilesX * tilesZ, 0);
+	nextActive.assign((size_t)tilesX * tilesZ, 0);
+	activeTiles.clear();
+	sources.clear();
+	setGround(grid);
+}
+
+void ShallowWaterSolver::setGround(const VertexPacking::HeightGridData& grid)
+{
+	float range = glm::max(grid.MaxHeight - grid.MinHeight, 1e-6f);
+	for (int row = 0; row < rows; ++row)
+		for (int column = 0; column < columns; ++column)
+			ground[cellIndex(column, row)] = grid.MinHeight + range * (grid.Heights[row * columns + column] / 65535.0f);
+}
+
+void ShallowWaterSolver::addSource(float x, float z, float rate)
+{
+	int column = glm::clamp((int)roundf((x + 0.5f * width) / cellSize), 0, columns - 1);
+	int row = glm::clamp((int)roundf((0.5f * depthExtent - z) / cellSize), 0, rows - 1);
+
+	Source source;
+	source.Cell = cellIndex(column, row);
+	source.Tile = source.Cell / (TILE * TILE);
+	source.Rate = rate;
+	sources.push_back(source);
+}
+
+void ShallowWaterSolver::step(float stepSeconds)
+{
+	if (!isReady())
+		return;
+
+	for (size_t i = 0; i < sources.size(); ++i)
+	{
+		depths[sources[i].Cell] += sources[i].Rate * stepSeconds / (cellSize * cellSize);
+		tileWet[sources[i].Tile] = 1;
+	}
+	updateActiveTiles();
+
+	// flows read the depths around them and depths read the flows, so the passes take turns
+	JobSystem& jobs = JobSystem::instance();
+	jobs.parallelFor(activeTiles.size(), MIN_TILES_PER_JOB, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+			updateFlows(activeTiles[i], stepSeconds);
+	});
+	jobs.parallelFor(activeTiles.size(), MIN_TILES_PER_JOB, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+			updateDepths(activeTiles[i], stepSeconds);
+	});
+}
+
+void ShallowWaterSolver::updateActiveTiles()
+{
+	// wet tiles and every tile next to one, water can only reach that far in a step
+	std::fill(nextActive.begin(), nextActive.end(), 0);
+	for (int tz = 0; tz < tilesZ; ++tz)
+	{
+		for (int tx = 0; tx < tilesX; ++tx)
+		{
+			if (!tileWet[tz * tilesX + tx])
+				continue;
+			for (int nz = glm::max(tz - 1, 0); nz <= glm::min(tz + 1, tilesZ - 1); ++nz)
+				for (int nx = glm::max(tx - 1, 0); nx <= glm::min(tx + 1, tilesX - 1); ++nx)
+					nextActive[nz * tilesX + nx] = 1;
+		}
+	}
+
+	activeTiles.clear();
+	for (size_t tile = 0; tile < nextActive.size(); ++tile)
+	{
+		if (nextActive[tile])
+		{
+			activeTiles.push_back((int)tile);
+		}
+		else if (tileActive[tile])
+		{
+			// active neighbours still read the flows of a tile that drops out, they must be zero
+			size_t first = tile * TILE * TILE, last = first + TILE * TILE;
+			std::fill(flowLeft.begin() + first, flowLeft.begin() + last, 0.0f);
+			std::fill(flowRight.begin() + first, flowRight.begin() + last, 0.0f);
+			std::fill(flowUp.begin() + first, flowUp.begin() + last, 0.0f);
+			std::fill(flowDown.begin() + first, flowDown.begin() + last, 0.0f);
+		}
+	}
+	tileActive.swap(nextActive);
+}
+
+void ShallowWaterSolver::updateFlows(int tile, float stepSeconds)
+{
+	const int tileColumn = (tile % tilesX) * TILE;
+	const int tileRow = (tile / tilesX) * TILE;
+	const float pipe = stepSeconds * GRAVITY * cellSize;	// dt * g * A / l with A = l^2
+	const float capacity = cellSize * cellSize / stepSeconds;
+
+	for (int localRow = 0; localRow < TILE; ++localRow)
+	{
+		int row = tileRow + localRow;
+		for (int localColumn = 0; localColumn < TILE; ++localColumn)
+		{
+			int column = tileColumn + localColumn;
+			int i = tile * TILE * TILE + localRow * TILE + localColumn;
+			if (column >= columns || row >= rows)
+				continue;
+
+			float water = depths[i];
+			float surface = ground[i] + water;
+
+			// neighbours inside the tile are next to each other, the others are looked up; off
+			// the grid the water falls away as if the neighbour were dry ground at our level.
+			// Tiles that are not active do not take in what flows to them this step, so their
+			// edges are closed, or the water would be lost
+			float left = ground[i], right = ground[i], up = ground[i], down = ground[i];
+			bool openLeft = true, openRight = true, openUp = true, openDown = true;
+			if (column > 0)
+			{
+				int n = (localColumn > 0) ? i - 1 : cellIndex(column - 1, row);
+				left = ground[n] + depths[n];
+				openLeft = localColumn > 0 || tileActive[n / (TILE * TILE)];
+			}
+			if (column < columns - 1)
+			{
+				int n = (localColumn < TILE - 1) ? i + 1 : cellIndex(column + 1, row);
+				right = ground[n] + depths[n];
+				openRight = localColumn < TILE - 1 || tileActive[n / (TILE * TILE)];
+			}
+			if (row > 0)
+			{
+				int n = (localRow > 0) ? i - TILE : cellIndex(column, row - 1);
+				up = ground[n] + depths[n];
+				openUp = localRow > 0 || tileActive[n / (TILE * TILE)];
+			}
+			if (row < rows - 1)
+			{
+				int n = (localRow < TILE - 1) ? i + TILE : cellIndex(column, row + 1);
+				down = ground[n] + depths[n];
+				openDown = localRow < TILE - 1 || tileActive[n / (TILE * TILE)];
+			}
+
+			float fl = openLeft ? glm::max(0.0f, FLOW_RETAINED * flowLeft[i] + pipe * (surface - left)) : 0.0f;
+			float fr = openRight ? glm::max(0.0f, FLOW_RETAINED * flowRight[i] + pipe * (surface - right)) : 0.0f;
+			float fu = openUp ? glm::max(0.0f, FLOW_RETAINED * flowUp[i] + pipe * (surface - up)) : 0.0f;
+			float fd = openDown ? glm::max(0.0f, FLOW_RETAINED * flowDown[i] + pipe * (surface - down)) : 0.0f;
+
+			// never let more out in a step than the cell holds
+			float total = fl + fr + fu + fd;
+			if (total > 0.0f)
+			{
+				float scale = glm::min(1.0f, water * capacity / total);
+				fl *= scale;
+				fr *= scale;
+				fu *= scale;
+				fd *= scale;
+			}
+			flowLeft[i] = fl;
+			flowRight[i] = fr;
+			flowUp[i] = fu;
+			flowDown[i] = fd;
+		}
+	}
+}
+
+void ShallowWaterSolver::updateDepths(int tile, float stepSeconds)
+{
+	const int tileColumn = (tile % tilesX) * TILE;
+	const int tileRow = (tile / tilesX) * TILE;
+	const float scale = stepSeconds / (cellSize * cellSize);
+
+	bool wet = false;
+	for (int localRow = 0; localRow < TILE; ++localRow)
+	{
+		int row = tileRow + localRow;
+		for (int localColumn = 0; localColumn < TILE; ++localColumn)
+		{
+			int column = tileColumn + localColumn;
+			int i = tile * TILE * TILE + localRow * TILE + localColumn;
+			if (column >= columns || row >= rows)
+				continue;
+
+			// what the neighbours send this way; flows over the edge of the grid are lost
+			float in = 0.0f;
+			if (column > 0)
+				in += flowRight[(localColumn > 0) ? i - 1 : cellIndex(column - 1, row)];
+			if (column < columns - 1)
+				in += flowLeft[(localColumn < TILE - 1) ? i + 1 : cellIndex(column + 1, row)];
+			if (row > 0)
+				in += flowDown[(localRow > 0) ? i - TILE : cellIndex(column, row - 1)];
+			if (row < rows - 1)
+				in += flowUp[(localRow < TILE - 1) ? i + TILE : cellIndex(column, row + 1)];
+			float out = flowLeft[i] + flowRight[i] + flowUp[i] + flowDown[i];
+
+			float water = glm::max(0.0f, depths[i] + (in - out) * scale);
+			depths[i] = water;
+			wet = wet || water > WET_DEPTH;
+		}
+	}
+	tileWet[tile] = wet ? 1 : 0;
+}
+
+void ShallowWaterSolver::packSurface(std::vector<GLushort>& out, float minHeight, float maxHeight) const
+{
+	out.resize((size_t)columns * rows);
+	float scale = 1.0f / glm::max(maxHeight - minHeight, 1e-6f);
+	for (int row = 0; row < rows; ++row)
+	{
+		for (int column = 0; column < columns; ++column)
+		{
+			int i = cellIndex(column, row);
+			float height = (depths[i] > WET_DEPTH) ? ground[i] + depths[i] : ground[i] - DRY_OFFSET;
+			out[row * columns + column] = glm::packUnorm1x16((height - minHeight) * scale);
+		}
+	}
+}
+
+double ShallowWaterSolver::totalVolume() const
+{
+	double volume = 0.0;
+	for (size_t i = 0; i < depths.size(); ++i)
+		volume += depths[i];
+	return volume * cellSize * cellSize;
+}
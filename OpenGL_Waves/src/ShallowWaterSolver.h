@@ -0,0 +1,100 @@
+#pragma once
+
+#ifndef SHALLOWWATERSOLVER_H
+#define SHALLOWWATERSOLVER_H
+
+#include "GL_Util.h"
+#include "VertexPacking.h"
+
+#include <vector>
+
+// Water running over the terrain grid: the virtual pipes model (O'Brien and Hodgins, Mei et
+// al.). Every cell keeps a water depth and the flow out through four pipes to its neighbours.
+// A step first accelerates the flows by the difference in water surface height, scaled down
+// where they would drain more than the cell holds, then moves the water.
+//
+// Cells are stored tile by tile, TILE x TILE cells of each field next to each other, so a tile
+// and most of its neighbours' cells stay in cache while it is updated. Both passes run over
+// the tiles on the job system. Only tiles with water in them or next to them are visited,
+// the cost follows the wet area rather than the size of the map. Water that flows over the
+// edge of the grid leaves it.
+class ShallowWaterSolver
+{
+public:
+	static const int TILE = 16;
+	static const float GRAVITY;
+	static const float WET_DEPTH;	// below this a cell counts as dry
+
+	///<summary>
+	/// Takes the terrain heights, dry, with the layout of a Terrain height grid.
+	///</summary>
+	void init(const VertexPacking::HeightGridData& grid);
+
+	///<summary>
+	/// Replaces the terrain under the water, for a grid of the same size. The water stays.
+	///</summary>
+	void setGround(const VertexPacking::HeightGridData& grid);
+	bool isReady() const { return columns > 0; }
+
+	///<summary>
+	/// A spring pouring rate m^3/s into the cell under (x, z) every step.
+	///</summary>
+	void addSource(float x, float z, float rate);
+
+	void step(float stepSeconds);
+
+	///<summary>
+	/// Packs the water surface as a height grid like the terrain's, UNORM16 over
+	/// [minHeight, maxHeight]. Dry cells go just under the terrain, out of sight.
+	///</summary>
+	void packSurface(std::vector<GLushort>& out, float minHeight, float maxHeight) const;
+
+	float depth(int column, int row) const { return depths[cellIndex(column, row)]; }
+	int gridColumns() const { return columns; }
+	int gridRows() const { return rows; }
+	size_t tileCount() const { return tileWet.size(); }
+	size_t activeTileCount() const { return activeTiles.size(); }
+	double totalVolume() const;
+
+private:
+	// tiles per job, a tile is a few microseconds of work
+	static const size_t MIN_TILES_PER_JOB = 4;
+
+	struct Source
+	{
+		int Cell;
+		int Tile;
+		float Rate;
+	};
+
+	int columns = 0;
+	int rows = 0;
+	int tilesX = 0;
+	int tilesZ = 0;
+	float cellSize = 1.0f;
+	float width = 0.0f;
+	float depthExtent = 0.0f;
+
+	// tile blocked fields, TILE * TILE cells per tile
+	std::vector<float> ground;
+	std::vector<float> depths;
+	std::vector<float> flowLeft, flowRight, flowUp, flowDown;
+
+	std::vector<unsigned char> tileWet;	// written by each tile's own job
+	std::vector<int> activeTiles;
+	std::vector<unsigned char> tileActive;
+	std::vector<unsigned char> nextActive;
+	std::vector<Source> sources;
+
+	int cellIndex(int column, int row) const
+	{
+		int tile = (row / TILE) * tilesX + column / TILE;
+		return tile * TILE * TILE + (row % TILE) * TILE + column % TILE;
+	}
+
+	void updateActiveTiles();
+	void updateFlows(int tile, float stepSeconds);
+	void updateDepths(int tile, float stepSeconds);
+};
+
+#endif // SHALLOWWATERSOLVER_H
@@ -0,0 +1,76 @@
+#pragma once
+
+#ifndef SIMCLOCK_H
+#define SIMCLOCK_H
+
+// Fixed timestep clock. Real time is added to an accumulator and the simulation advances in
+// whole steps of step(); what is left over becomes alpha(), the fraction of a step the render
+// phase interpolates by. A frame never runs more than maxSteps steps: after a long stall the
+// excess is dropped instead of being caught up, which would only make the next frame longer.
+//
+// In lockstep mode every frame is exactly one step whatever the wall clock says, so a run is
+// the same from one machine to the next, for benchmarks.
+class SimClock
+{
+public:
+	SimClock(double fixedStep = 1.0 / 60.0, unsigned int maxStepsPerFrame = 5)
+		: stepSize(fixedStep), maxSteps(maxStepsPerFrame) {}
+
+	void reset(double now)
+	{
+		last = now;
+		accumulator = 0.0;
+	}
+
+	void setLockstep(bool enabled)
+	{
+		lockstep = enabled;
+	}
+
+	///<summary>
+	/// Adds the real time since the last call and returns how many steps to run this frame.
+	///</summary>
+	unsigned int advance(double now)
+	{
+		double elapsed = now - last;
+		last = now;
+		if (lockstep)
+			elapsed = stepSize;
+
+		accumulator += (elapsed > 0.0) ? elapsed : 0.0;
+		unsigned int steps = (unsigned int)(accumulator / stepSize);
+		if (steps > maxSteps)
+		{
+			dropped += (steps - maxSteps) * stepSize;
+			steps = maxSteps;
+		}
+		accumulator -= (double)(unsigned long long)(accumulator / stepSize) * stepSize;
+		stepCount += steps;
+		return steps;
+	}
+
+	double step() const { return stepSize; }
+
+	// fraction of a step between the last simulated state and now, for interpolation
+	float alpha() const { return (float)(accumulator / stepSize); }
+
+	// simulated time at the last step, and the time the render phase shows for things evaluated
+	// at render time: alpha of the way from the step before to the last, like interpolated bodies
+	double time() const { return stepCount * stepSize; }
+	double interpolatedTime() const { return time() - stepSize + alpha() * stepSize; }
+
+	unsigned long long steps() const { return stepCount; }
+	double droppedSeconds() const { return dropped; }
+
+private:
+	double stepSize;
+	unsigned int maxSteps;
+	bool lockstep = false;
+
+	double last = 0.0;
+	double accumulator = 0.0;
+	unsigned long long stepCount = 0;
+	double dropped = 0.0;
+};
+
+#endif // SIMCLOCK_H
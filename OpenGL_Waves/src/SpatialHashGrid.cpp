@@ -0,0 +1,149 @@
+#include "SpatialHashGrid.h"
+#include "JobSystem.h"
+
+const SpatialHashGrid::Handle SpatialHashGrid::INVALID;
+const unsigned int SpatialHashGrid::ALL_LAYERS;
+
+SpatialHashGrid::SpatialHashGrid(float cellSize, unsigned int bucketCount)
+	: cell(cellSize), inverseCell(1.0f / cellSize)
+{
+	unsigned int size = 1;
+	while (size < bucketCount)
+		size <<= 1;
+	bucketMask = size - 1;
+	buckets.assign(size, INVALID);
+}
+
+SpatialHashGrid::Handle SpatialHashGrid::insert(const glm::vec3& position, float radius, unsigned int layers, unsigned int userData)
+{
+	Handle handle;
+	if (freeList != INVALID)
+	{
+		handle = freeList;
+		freeList = entries[handle].Next;
+	}
+	else
+	{
+		handle = (Handle)entries.size();
+		entries.push_back(Entry());
+	}
+
+	Entry& entry = entries[handle];
+	entry.Position = position;
+	entry.Radius = radius;
+	entry.CellX = cellOf(position.x);
+	entry.CellZ = cellOf(position.z);
+	entry.Bucket = bucketOf(entry.CellX, entry.CellZ);
+	entry.Layers = layers;
+	entry.User = userData;
+	link(handle);
+
+	maxRadius = glm::max(maxRadius, radius);
+	count++;
+	return handle;
+}
+
+void SpatialHashGrid::move(Handle handle, const glm::vec3& position)
+{
+	Entry& entry = entries[handle];
+	entry.Position = position;
+	int cellX = cellOf(position.x);
+	int cellZ = cellOf(position.z);
+	if (cellX == entry.CellX && cellZ == entry.CellZ)
+		return;
+
+	unsigned int bucket = bucketOf(cellX, cellZ);
+	entry.CellX = cellX;
+	entry.CellZ = cellZ;
+	if (bucket == entry.Bucket)
+		return;
+
+	unlink(handle);
+	entry.Bucket = bucket;
+	link(handle);
+}
+
+void SpatialHashGrid::remove(Handle handle)
+{
+	unlink(handle);
+	entries[handle].Layers = 0;
+	entries[handle].Next = freeList;
+	freeList = handle;
+	count--;
+}
+
+void SpatialHashGrid::clear()
+{
+	std::fill(buckets.begin(), buckets.end(), INVALID);
+	entries.clear();
+	freeList = INVALID;
+	maxRadius = 0.0f;
+	count = 0;
+}
+
+void SpatialHashGrid::rebuild(const glm::vec3* positions, const float* radii, size_t entityCount, unsigned int layers)
+{
+	std::fill(buckets.begin(), buckets.end(), INVALID);
+	entries.resize(entityCount);
+	freeList = INVALID;
+	count = entityCount;
+
+	JobSystem::instance().parallelFor(entityCount, MIN_ENTITIES_PER_JOB, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+		{
+			Entry& entry = entries[i];
+			entry.Position = positions[i];
+			entry.Radius = radii[i];
+			entry.CellX = cellOf(positions[i].x);
+			entry.CellZ = cellOf(positions[i].z);
+			entry.Bucket = bucketOf(entry.CellX, entry.CellZ);
+			entry.Layers = layers;
+			entry.User = (unsigned int)i;
+		}
+	});
+
+	// backwards, so every list comes out in handle order
+	maxRadius = 0.0f;
+	for (size_t i = entityCount; i-- > 0;)
+	{
+		link((Handle)i);
+		maxRadius = glm::max(maxRadius, entries[i].Radius);
+	}
+}
+
+size_t SpatialHashGrid::queryRadius(const glm::vec3& center, float radius, unsigned int layers, std::vector<Handle>& out) const
+{
+	size_t first = out.size();
+	forEachInRadius(center, radius, layers, [&](Handle handle) { out.push_back(handle); });
+	return out.size() - first;
+}
+
+size_t SpatialHashGrid::queryBox(const glm::vec3& boxMin, const glm::vec3& boxMax, unsigned int layers, std::vector<Handle>& out) const
+{
+	size_t first = out.size();
+	forEachInBox(boxMin, boxMax, layers, [&](Handle handle) { out.push_back(handle); });
+	return out.size() - first;
+}
+
+void SpatialHashGrid::link(Handle handle)
+{
+	Entry& entry = entries[handle];
+	Handle& head = buckets[entry.Bucket];
+	entry.Previous = INVALID;
+	entry.Next = head;
+	if (head != INVALID)
+		entries[head].Previous = handle;
+	head = handle;
+}
+
+void SpatialHashGrid::unlink(Handle handle)
+{
+	Entry& entry = entries[handle];
+	if (entry.Previous != INVALID)
+		entries[entry.Previous].Next = entry.Next;
+	else
+		buckets[entry.Bucket] = entry.Next;
+	if (entry.Next != INVALID)
+		entries[entry.Next].Previous = entry.Previous;
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#ifndef SPATIALHASHGRID_H
+#define SPATIALHASHGRID_H
+
+#include "GL_Util.h"
+
+#include <vector>
+
+// Spheres in the scene sorted into a uniform grid of square cells over x/z, for neighbour
+// queries that do not scan every object. Cells are not stored, a cell hashes to one of a fixed
+// number of buckets and every bucket keeps a doubly linked list of the entities in it, so
+// insert, move and remove are O(1) and memory does not grow with the extent of the world.
+// Cells that share a bucket are told apart by the cell each entity remembers.
+//
+// Every entity carries a layer mask and a user value; queries take the layers to look at and
+// hand back handles, the caller maps them to its objects through userData().
+//
+// Queries only read and may run from any number of threads at once. Changes may not overlap
+// with anything else. rebuild() computes the cells of a whole batch on the job system.
+class SpatialHashGrid
+{
+public:
+	typedef unsigned int Handle;
+	static const Handle INVALID = 0xffffffffu;
+	static const unsigned int ALL_LAYERS = 0xffffffffu;
+
+	///<summary>
+	/// cellSize should be about the size of the usual query. bucketCount is rounded up to a
+	/// power of two, a few times the number of occupied cells keeps the lists short.
+	///</summary>
+	explicit SpatialHashGrid(float cellSize = 4.0f, unsigned int bucketCount = 4096);
+
+	Handle insert(const glm::vec3& position, float radius, unsigned int layers = 1, unsigned int userData = 0);
+	void move(Handle handle, const glm::vec3& position);
+	void remove(Handle handle);
+	void clear();
+
+	///<summary>
+	/// Replaces everything with count entities, entity i getting handle i and user value i.
+	/// Cells and buckets are computed in parallel, linking them up is one pass after.
+	///</summary>
+	void rebuild(const glm::vec3* positions, const float* radii, size_t count, unsigned int layers = 1);
+
+	///<summary>
+	/// Calls visit(handle) for every entity on the given layers whose sphere reaches into the
+	/// sphere around center.
+	///</summary>
+	template<typename Visit>
+	void forEachInRadius(const glm::vec3& center, float radius, unsigned int layers, Visit visit) const
+	{
+		glm::vec3 reach(radius + maxRadius);
+		forEachInCells(center - reach, center + reach, layers, [&](Handle handle, const Entry& entry)
+		{
+			float distance = radius + entry.Radius;
+			glm::vec3 offset = entry.Position - center;
+			if (glm::dot(offset, offset) <= distance * distance)
+				visit(handle);
+		});
+	}
+
+	///<summary>
+	/// Calls visit(handle) for every entity on the given layers whose sphere overlaps the box.
+	///</summary>
+	template<typename Visit>
+	void forEachInBox(const glm::vec3& boxMin, const glm::vec3& boxMax, unsigned int layers, Visit visit) const
+	{
+		forEachInCells(boxMin - glm::vec3(maxRadius), boxMax + glm::vec3(maxRadius), layers, [&](Handle handle, const Entry& entry)
+		{
+			glm::vec3 offset = entry.Position - glm::clamp(entry.Position, boxMin, boxMax);
+			if (glm::dot(offset, offset) <= entry.Radius * entry.Radius)
+				visit(handle);
+		});
+	}
+
+	// append the handles found to out and return how many there were
+	size_t queryRadius(const glm::vec3& center, float radius, unsigned int layers, std::vector<Handle>& out) const;
+	size_t queryBox(const glm::vec3& boxMin, const glm::vec3& boxMax, unsigned int layers, std::vector<Handle>& out) const;
+
+	const glm::vec3& position(Handle handle) const { return entries[handle].Position; }
+	float radius(Handle handle) const { return entries[handle].Radius; }
+	unsigned int userData(Handle handle) const { return entries[handle].User; }
+	size_t size() const { return count; }
+	float cellSize() const { return cell; }
+
+private:
+	// entities per job in rebuild()
+	static const size_t MIN_ENTITIES_PER_JOB = 4096;
+
+	struct Entry
+	{
+		glm::vec3 Position;
+		float Radius;
+		int CellX;
+		int CellZ;
+		unsigned int Bucket;
+		unsigned int Layers;	// 0 while the entry is free
+		unsigned int User;
+		Handle Previous;
+		Handle Next;			// also links the free entries
+	};
+
+	float cell;
+	float inverseCell;
+	unsigned int bucketMask;
+	float maxRadius = 0.0f;		// queries reach this much further, so large entities are found
+	size_t count = 0;
+
+	std::vector<Handle> buckets;	// first entity of each bucket
+	std::vector<Entry> entries;
+	Handle freeList = INVALID;
+
+	int cellOf(float coordinate) const { return (int)floorf(coordinate * inverseCell); }
+
+	unsigned int bucketOf(int cellX, int cellZ) const
+	{
+		return ((unsigned int)cellX * 73856093u ^ (unsigned int)cellZ * 19349663u) & bucketMask;
+	}
+
+	void link(Handle handle);
+	void unlink(Handle handle);
+
+	template<typename Visit>
+	void forEachInCells(const glm::vec3& boxMin, const glm::vec3& boxMax, unsigned int layers, Visit visit) const
+	{
+		int firstX = cellOf(boxMin.x), lastX = cellOf(boxMax.x);
+		int firstZ = cellOf(boxMin.z), lastZ = cellOf(boxMax.z);
+
+		// with more cells than buckets every bucket would be walked several times, walk each once
+		long long cellCount = (long long)(lastX - firstX + 1) * (lastZ - firstZ + 1);
+		if (cellCount > (long long)bucketMask + 1)
+		{
+			for (size_t bucket = 0; bucket < buckets.size(); ++bucket)
+			{
+				for (Handle handle = buckets[bucket]; handle != INVALID; handle = entries[handle].Next)
+				{
+					const Entry& entry = entries[handle];
+					if (entry.CellX >= firstX && entry.CellX <= lastX && entry.CellZ >= firstZ && entry.CellZ <= lastZ && (entry.Layers & layers))
+						visit(handle, entry);
+				}
+			}
+			return;
+		}
+
+		for (int cellZ = firstZ; cellZ <= lastZ; ++cellZ)
+		{
+			for (int cellX = firstX; cellX <= lastX; ++cellX)
+			{
+				for (Handle handle = buckets[bucketOf(cellX, cellZ)]; handle != INVALID; handle = entries[handle].Next)
+				{
+					const Entry& entry = entries[handle];
+					if (entry.CellX == cellX && entry.CellZ == cellZ && (entry.Layers & layers))
+						visit(handle, entry);
+				}
+			}
+		}
+	}
+};
+
+#endif // SPATIALHASHGRID_H
@@ -0,0 +1,193 @@
+#pragma once
+
+#ifndef STREAMBUFFER_H
+#define STREAMBUFFER_H
+
+#include "GL_Util.h"
+
+// A buffer for data rewritten from the CPU every frame (simulated water, deformed or eroded
+// terrain). It is split into REGION_COUNT regions used round robin: the CPU writes frame N+1
+// into one region while the GPU still reads frame N from another, and a fence per region
+// only blocks when the CPU gets a full ring ahead.
+//
+// With GL 4.4 / ARB_buffer_storage the buffer is mapped once, persistent and coherent, so
+// writing is a plain memcpy. Without it every frame maps its region unsynchronized and
+// unmaps it again, which is still stall free thanks to the same fences.
+//
+// Per frame:
+//	void* p = stream.map();				// waits for the region if the GPU is still on it
+//	... write at most regionSize() bytes ...
+//	GLintptr offset = stream.unmap();		// where this frame's data starts
+//	... draw, e.g. glDrawElementsBaseVertex(..., stream.baseVertex(stride)) ...
+//	stream.fence();						// after the last draw that reads the region
+class StreamBuffer
+{
+public:
+	enum { REGION_COUNT = 3 };
+
+	StreamBuffer() {}
+
+	~StreamBuffer()
+	{
+		destroy();
+	}
+
+	///<summary>
+	/// Creates the buffer with REGION_COUNT regions of regionSize bytes and leaves it bound
+	/// to target, so the caller can set up its vertex attributes.
+	///</summary>
+	void create(GLenum bufferTarget, GLsizeiptr bytesPerRegion)
+	{
+		destroy();
+		target = bufferTarget;
+		size = bytesPerRegion;
+
+		glGenBuffers(1, &buffer);
+		glBindBuffer(target, buffer);
+
+		persistent = glBufferStorage != nullptr;
+		if (persistent)
+		{
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glBufferStorage(target, size * REGION_COUNT, NULL, flags);
+			mapped = static_cast<unsigned char*>(glMapBufferRange(target, 0, size * REGION_COUNT, flags));
+			if (mapped == nullptr)
+			{
+				// storage is immutable, so fall back with a new buffer
+				std::cout << "ERROR::STREAM_BUFFER::PERSISTENT_MAP_FAILED, using unsynchronized maps" << std::endl;
+				glDeleteBuffers(1, &buffer);
+				glGenBuffers(1, &buffer);
+				glBindBuffer(target, buffer);
+				persistent = false;
+			}
+		}
+		if (!persistent)
+			glBufferData(target, size * REGION_COUNT, NULL, GL_STREAM_DRAW);
+	}
+
+	void destroy()
+	{
+		if (buffer == 0)
+			return;
+
+		for (unsigned int i = 0; i < REGION_COUNT; ++i)
+		{
+			if (fences[i])
+				glDeleteSync(fences[i]);
+			fences[i] = 0;
+		}
+		if (persistent)
+		{
+			glBindBuffer(target, buffer);
+			glUnmapBuffer(target);
+		}
+		glDeleteBuffers(1, &buffer);
+		buffer = 0;
+		mapped = nullptr;
+		region = 0;
+	}
+
+	///<summary>
+	/// Waits until the GPU is done with the current region and returns it for writing.
+	///</summary>
+	void* map()
+	{
+		GLsync& fence = fences[region];
+		if (fence)
+		{
+			double start = glfwGetTime();
+			GLenum result = glClientWaitSync(fence, 0, 0);
+			if (result == GL_TIMEOUT_EXPIRED)
+			{
+				// the flush makes sure the fence is submitted before blocking on it
+				waitedFrames++;
+				do
+				{
+					result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+				} while (result == GL_TIMEOUT_EXPIRED);
+			}
+			lastWait = (glfwGetTime() - start) * 1000.0;
+			totalWait += lastWait;
+			glDeleteSync(fence);
+			fence = 0;
+		}
+		else
+		{
+			lastWait = 0.0;
+		}
+		frames++;
+
+		if (persistent)
+			return mapped + offset();
+
+		glBindBuffer(target, buffer);
+		return glMapBufferRange(target, offset(), size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	}
+
+	///<summary>
+	/// Ends the writes of this frame and returns the byte offset of its region.
+	///</summary>
+	GLintptr unmap()
+	{
+		if (!persistent)
+		{
+			glBindBuffer(target, buffer);
+			glUnmapBuffer(target);
+		}
+		return offset();
+	}
+
+	///<summary>
+	/// Fences the region after the draws that read it and moves on to the next one.
+	///</summary>
+	void fence()
+	{
+		fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		region = (region + 1) % REGION_COUNT;
+	}
+
+	// byte offset of the current region
+	GLintptr offset() const
+	{
+		return (GLintptr)size * region;
+	}
+
+	// first vertex of the current region, regionSize must be a multiple of stride
+	GLint baseVertex(GLsizei stride) const
+	{
+		return (GLint)(offset() / stride);
+	}
+
+	GLuint id() const { return buffer; }
+	GLsizeiptr regionSize() const { return size; }
+	bool isPersistent() const { return persistent; }
+
+	// Fence wait metrics: time spent blocked in the last map() and over all of them, and how
+	// many frames had to block at all. Anything above zero means the CPU is running more
+	// than REGION_COUNT - 1 frames ahead of the GPU.
+	double lastWaitMs() const { return lastWait; }
+	double totalWaitMs() const { return totalWait; }
+	unsigned long long waitedFrameCount() const { return waitedFrames; }
+	unsigned long long frameCount() const { return frames; }
+
+private:
+	GLenum target = GL_ARRAY_BUFFER;
+	GLuint buffer = 0;
+	GLsizeiptr size = 0;
+	bool persistent = false;
+	unsigned char* mapped = nullptr;
+
+	GLsync fences[REGION_COUNT] = {};
+	unsigned int region = 0;
+
+	double lastWait = 0.0;
+	double totalWait = 0.0;
+	unsigned long long waitedFrames = 0;
+	unsigned long long frames = 0;
+
+	// owns the GL buffer and its mapping
+	StreamBuffer(const StreamBuffer&);
+	StreamBuffer& operator=(const StreamBuffer&);
+};
+
+#endif // STREAMBUFFER_H
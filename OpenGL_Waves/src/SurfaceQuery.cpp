@@ -0,0 +1,185 @@
+#include "SurfaceQuery.h"
+
+const float SurfaceQuery::NO_GROUND = -1.0e30f;
+
+namespace
+{
+	// footprint of a sphere on the ground: the center and eight points at 0.7 radius
+	const int FOOTPRINT_POINTS = 9;
+	const float FOOTPRINT[FOOTPRINT_POINTS][2] = {
+		{ 0.0f, 0.0f },
+		{ 0.7f, 0.0f }, { -0.7f, 0.0f }, { 0.0f, 0.7f }, { 0.0f, -0.7f },
+		{ 0.495f, 0.495f }, { -0.495f, 0.495f }, { 0.495f, -0.495f }, { -0.495f, -0.495f }
+	};
+
+	int floorDiv(int a, int b)
+	{
+		return (a >= 0) ? a / b : -((-a + b - 1) / b);
+	}
+}
+
+SurfaceQuery::SurfaceQuery()
+	: terrainTiles(SLOTS), waterColumns(SLOTS)
+{
+}
+
+void SurfaceQuery::setSources(const VertexPacking::HeightGridData* terrainGrid, const WaveField* waveField)
+{
+	terrain = (terrainGrid && terrainGrid->Rows > 1 && terrainGrid->Columns > 1) ? terrainGrid : nullptr;
+	waves = waveField;
+	for (size_t i = 0; i < terrainTiles.size(); ++i)
+		terrainTiles[i].Key = -1;
+	for (size_t i = 0; i < waterColumns.size(); ++i)
+		waterColumns[i].Step = 0;
+}
+
+void SurfaceQuery::beginStep(float stepTime)
+{
+	time = stepTime;
+	step++;
+	if (step == 0)
+		step = 1;
+}
+
+float SurfaceQuery::terrainHeight(float x, float z)
+{
+	if (!terrain)
+		return NO_GROUND;
+
+	float column = (x + 0.5f * terrain->Width) / cellWidth();
+	float row = (0.5f * terrain->Depth - z) / cellDepth();
+	if (column < 0.0f || row < 0.0f || column > terrain->Columns - 1 || row > terrain->Rows - 1)
+		return NO_GROUND;
+
+	int c = glm::min((int)column, terrain->Columns - 2);
+	int r = glm::min((int)row, terrain->Rows - 2);
+	float fx = column - c;
+	float fz = row - r;
+
+	const TerrainTile& tile = terrainTile(c / TILE_CELLS, r / TILE_CELLS);
+	const float* h = tile.Heights + (r % TILE_CELLS) * TILE_SAMPLES + (c % TILE_CELLS);
+	float top = h[0] + (h[1] - h[0]) * fx;
+	float bottom = h[TILE_SAMPLES] + (h[TILE_SAMPLES + 1] - h[TILE_SAMPLES]) * fx;
+	return top + (bottom - top) * fz;
+}
+
+float SurfaceQuery::waterHeight(float x)
+{
+	if (!waves)
+		return NO_GROUND;
+
+	float spacing = waterCell() / WATER_SUBSAMPLES;
+	float sample = x / spacing;
+	int first = (int)floorf(sample);
+	int column = floorDiv(first, WATER_SAMPLES - 1);
+	int index = first - column * (WATER_SAMPLES - 1);
+	float f = sample - first;
+
+	const WaterColumn& water = waterColumn(column);
+	return water.Heights[index] + (water.Heights[index + 1] - water.Heights[index]) * f;
+}
+
+float SurfaceQuery::sphereGround(float x, float z, float radius)
+{
+	float ground = NO_GROUND;
+	for (int i = 0; i < FOOTPRINT_POINTS; ++i)
+	{
+		float dx = FOOTPRINT[i][0] * radius;
+		float dz = FOOTPRINT[i][1] * radius;
+		float h = terrainHeight(x + dx, z + dz);
+		if (h == NO_GROUND)
+			continue;
+		// the sphere touches a point d away from its center sqrt(r^2 - d^2) above it
+		ground = glm::max(ground, h + sqrtf(glm::max(radius * radius - dx * dx - dz * dz, 0.0f)));
+	}
+	return ground;
+}
+
+SurfaceQuery::Sweep SurfaceQuery::sweepSphere(const glm::vec3& from, const glm::vec3& to, float radius, float maxClimb)
+{
+	Sweep result;
+	result.Position = from;
+	result.Blocked = false;
+
+	float distance = glm::length(glm::vec2(to.x - from.x, to.z - from.z));
+	int steps = glm::max(1, (int)ceilf(distance / (0.5f * radius)));
+	float ground = sphereGround(from.x, from.z, radius);
+	float reached = 0.0f;
+	for (int i = 1; i <= steps; ++i)
+	{
+		float t = (float)i / steps;
+		glm::vec3 p = glm::mix(from, to, t);
+		float next = sphereGround(p.x, p.z, radius);
+
+		// a step is only too high measured from where the sphere is, a floating sphere clears
+		// anything below it
+		float standing = glm::max(ground, p.y);
+		if (ground != NO_GROUND && next - standing > maxClimb)
+		{
+			result.Blocked = true;
+			break;
+		}
+		ground = next;
+		reached = t;
+	}
+
+	result.Position = glm::mix(from, to, reached);
+	result.Ground = ground;
+	result.Position.y = glm::max(result.Position.y, ground);
+	return result;
+}
+
+const SurfaceQuery::TerrainTile& SurfaceQuery::terrainTile(int tileX, int tileZ)
+{
+	int tilesX = (terrain->Columns - 2) / TILE_CELLS + 1;
+	int key = tileZ * tilesX + tileX;
+	TerrainTile& tile = terrainTiles[key % SLOTS];
+	if (tile.Key == key)
+	{
+		cacheHits++;
+		return tile;
+	}
+	cacheMisses++;
+
+	// edge tiles repeat the last row and column of the grid
+	float range = glm::max(terrain->MaxHeight - terrain->MinHeight, 1e-6f);
+	for (int r = 0; r < TILE_SAMPLES; ++r)
+	{
+		int row = glm::min(tileZ * TILE_CELLS + r, terrain->Rows - 1);
+		for (int c = 0; c < TILE_SAMPLES; ++c)
+		{
+			int column = glm::min(tileX * TILE_CELLS + c, terrain->Columns - 1);
+			tile.Heights[r * TILE_SAMPLES + c] = terrain->MinHeight + range * (terrain->Heights[row * terrain->Columns + column] / 65535.0f);
+		}
+	}
+	tile.Key = key;
+	return tile;
+}
+
+const SurfaceQuery::WaterColumn& SurfaceQuery::waterColumn(int column)
+{
+	WaterColumn& water = waterColumns[((column % SLOTS) + SLOTS) % SLOTS];
+	if (water.Step == step && water.Key == column)
+	{
+		cacheHits++;
+		return water;
+	}
+	cacheMisses++;
+
+	float spacing = waterCell() / WATER_SUBSAMPLES;
+	float start = column * (WATER_SAMPLES - 1) * spacing;
+	int i = 0;
+	for (; i + 4 <= WATER_SAMPLES; i += 4)
+	{
+		__m128 x = _mm_add_ps(_mm_set1_ps(start), _mm_mul_ps(_mm_set_ps(i + 3.0f, i + 2.0f, i + 1.0f, (float)i), _mm_set1_ps(spacing)));
+		__m128 height, velocityX, velocityY;
+		waves->sample4(x, time, height, velocityX, velocityY);
+		_mm_storeu_ps(water.Heights + i, height);
+	}
+	for (; i < WATER_SAMPLES; ++i)
+		water.Heights[i] = waves->height(start + i * spacing, time);
+
+	water.Key = column;
+	water.Step = step;
+	return water;
+}
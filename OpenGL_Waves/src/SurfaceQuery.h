@@ -0,0 +1,107 @@
+#pragma once
+
+#ifndef SURFACEQUERY_H
+#define SURFACEQUERY_H
+
+#include "GL_Util.h"
+#include "VertexPacking.h"
+#include "WaveField.h"
+
+#include <vector>
+
+// Height queries against the terrain grid and the water surface, for anything that walks or
+// floats. Both are sampled through small caches shared by every caller:
+//
+//  - terrain tiles of TILE_CELLS x TILE_CELLS cells are decoded from UNORM16 to floats on
+//    first use and stay until another tile maps to the same slot;
+//  - the water is tabulated per tile column at WATER_SUBSAMPLES points per cell, once per
+//    simulation step, since it only varies along x and with time. Heights are linear between
+//    the samples, which rounds off the sharp crest of the steepest wave.
+//
+// So a crowd standing on the same few tiles costs a handful of decodes and wave solves a step,
+// not one per agent. Not thread safe, queries come from the simulation phase.
+class SurfaceQuery
+{
+public:
+	// lowest ground there is, returned off the edge of the terrain
+	static const float NO_GROUND;
+
+	struct Sweep
+	{
+		glm::vec3 Position;	// where the sphere ended up, resting on the ground if it touched
+		float Ground;		// lowest height the center can have at Position
+		bool Blocked;		// a slope steeper than maxClimb stopped the move
+	};
+
+	SurfaceQuery();
+
+	///<summary>
+	/// Sets the surfaces to sample. Either may be null: no terrain is NO_GROUND everywhere and
+	/// no water is a surface at NO_GROUND.
+	///</summary>
+	void setSources(const VertexPacking::HeightGridData* terrain, const WaveField* waves);
+
+	///<summary>
+	/// Starts a simulation step at time t. Water tabulated for earlier steps goes stale.
+	///</summary>
+	void beginStep(float time);
+
+	float terrainHeight(float x, float z);
+	float waterHeight(float x);
+
+	///<summary>
+	/// Lowest height the center of a sphere of the given radius can have above (x, z) without
+	/// going into the terrain, from the heights under its footprint.
+	///</summary>
+	float sphereGround(float x, float z, float radius);
+
+	///<summary>
+	/// Moves a sphere from one position to another over the terrain in steps of half a radius.
+	/// Wherever the ground under it rises by more than maxClimb in one step the move stops
+	/// there. The height of the sphere is only raised out of the ground, never lowered.
+	///</summary>
+	Sweep sweepSphere(const glm::vec3& from, const glm::vec3& to, float radius, float maxClimb);
+
+	unsigned long long hits() const { return cacheHits; }
+	unsigned long long misses() const { return cacheMisses; }
+
+private:
+	static const int TILE_CELLS = 16;
+	static const int TILE_SAMPLES = TILE_CELLS + 1;
+	static const int WATER_SUBSAMPLES = 4;
+	static const int WATER_SAMPLES = TILE_CELLS * WATER_SUBSAMPLES + 1;
+	static const int SLOTS = 64;	// per cache, direct mapped by tile key
+
+	struct TerrainTile
+	{
+		int Key = -1;
+		float Heights[TILE_SAMPLES * TILE_SAMPLES];
+	};
+
+	struct WaterColumn
+	{
+		int Key = 0;
+		unsigned int Step = 0;		// 0 is never current
+		float Heights[WATER_SAMPLES];
+	};
+
+	const VertexPacking::HeightGridData* terrain = nullptr;
+	const WaveField* waves = nullptr;
+	float time = 0.0f;
+	unsigned int step = 0;
+
+	std::vector<TerrainTile> terrainTiles;
+	std::vector<WaterColumn> waterColumns;
+	unsigned long long cacheHits = 0;
+	unsigned long long cacheMisses = 0;
+
+	float cellWidth() const { return terrain->Width / (terrain->Columns - 1); }
+	float cellDepth() const { return terrain->Depth / (terrain->Rows - 1); }
+	// width of a water column, the terrain cells or one unit without terrain
+	float waterCell() const { return terrain ? cellWidth() : 1.0f; }
+
+	const TerrainTile& terrainTile(int tileX, int tileZ);
+	const WaterColumn& waterColumn(int column);
+};
+
+#endif // SURFACEQUERY_H
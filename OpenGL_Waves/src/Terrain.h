@@ -4,6 +4,13 @@
 #define TERRAIN_H
 
 #include "GL_Util.h"
+#include "VertexPacking.h"
+#include "ShaderLibrary.h"
+#include "AssetPack.h"
+#include "TerrainStreamer.h"
+#include "JobSystem.h"
+#include "FrameSnapshot.h"
+#include "StreamBuffer.h"
 #include <time.h>
 
 class Terrain
@@ -18,84 +25,222 @@ public:
 	{
 		glDeleteVertexArrays(1, &gridVAO);
 		glDeleteBuffers(1, &gridVBO);
+		glDeleteVertexArrays(1, &floodVAO);
 	}
 
 	void init()
 	{
-		srand(time(NULL));
-		seed = rand();
-
 		//Setup shader program
-		Shader::ShaderCode code;
-		code.vertexCode = vertexShaderSource;
-		//code.fragmentCode = fragmentShaderSource;
-		code.fragmentCode = newFragmentShaderSource;
-		shaderProgram = Shader(code);
-
-		//Create grid
-		GeometryGenerator geoGen;
-		geoGen.CreateGrid(100.0f, 100.0f, 100, 100, grid);
-		generateTerrain();
-
-		// Setup water VAO
+		// the grid is uploaded as heights only, X/Z are rebuilt from gl_VertexID
+		ShaderLibrary::registerModules();
+		litShaders.init("terrain", heightVertexShaderSource, "lit.frag", ShaderLibrary::litFeatures(), ShaderLibrary::litKey(1, false, false));
+
+		// Setup grid VAO
 		glGenVertexArrays(1, &gridVAO);
 		glGenBuffers(1, &gridVBO);
 		glGenBuffers(1, &gridEBO);
 		glBindVertexArray(gridVAO);
-
 		glBindBuffer(GL_ARRAY_BUFFER, gridVBO);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(GeometryGenerator::Vertex) * grid.Vertices.size(), grid.Vertices.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gridEBO);
+
+		// a warm start reuses the terrain of the run that wrote the pack, seed included
+		AssetPack& pack = AssetPack::instance();
+		AssetPack::Section heightSection, indexSection;
+		if (pack.find("terrain/heights", heightSection) && pack.find("terrain/indices", indexSection))
+		{
+			PackInfo info = AssetPack::info<PackInfo>(heightSection);
+			seed = info.Seed;
+			heights.Rows = info.Rows;
+			heights.Columns = info.Columns;
+			heights.Width = info.Width;
+			heights.Depth = info.Depth;
+			heights.MinHeight = info.MinHeight;
+			heights.MaxHeight = info.MaxHeight;
+			const GLushort* first = reinterpret_cast<const GLushort*>(heightSection.Data);
+			heights.Heights.assign(first, first + heightSection.Size / sizeof(GLushort));
+
+			glBufferData(GL_ARRAY_BUFFER, heightSection.Size, heightSection.Data, GL_STATIC_DRAW);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexSection.Size, indexSection.Data, GL_STATIC_DRAW);
+			gridIndexCount = (GLsizei)info.IndexCount;
+			gridIndexType = (indexSection.Size == sizeof(GLushort) * info.IndexCount) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+		}
+		else
+		{
+			srand(time(NULL));
+			seed = rand();
+
+			//Create grid
+			GeometryGenerator::MeshData grid;
+			GeometryGenerator geoGen;
+			geoGen.CreateGrid(100.0f, 100.0f, 100, 100, grid, true);
+			GenerateTerrain(seed, grid);
+			VertexPacking::PackHeightGrid(grid, 100, 100, 100.0f, 100.0f, heights);
+
+			glBufferData(GL_ARRAY_BUFFER, sizeof(GLushort) * heights.Heights.size(), heights.Heights.data(), GL_STATIC_DRAW);
+			grid.UploadIndices();
+			gridIndexCount = (GLsizei)grid.Indices.size();
+			gridIndexType = grid.IndexType();
+
+			PackInfo info;
+			info.Seed = seed;
+			info.Rows = heights.Rows;
+			info.Columns = heights.Columns;
+			info.Width = heights.Width;
+			info.Depth = heights.Depth;
+			info.MinHeight = heights.MinHeight;
+			info.MaxHeight = heights.MaxHeight;
+			info.IndexCount = (unsigned int)gridIndexCount;
+			pack.add("terrain/heights", heights.Heights.data(), sizeof(GLushort) * heights.Heights.size(), &info, sizeof(info));
+
+			std::vector<GLushort> shortIndices;
+			if (gridIndexType == GL_UNSIGNED_SHORT)
+			{
+				grid.NarrowIndices(shortIndices);
+				pack.add("terrain/indices", shortIndices.data(), sizeof(GLushort) * shortIndices.size());
+			}
+			else
+			{
+				pack.add("terrain/indices", grid.Indices.data(), sizeof(GLuint) * grid.Indices.size());
+			}
+		}
 
+		VertexPacking::SetupHeightAttribute();
+		uploadedRange = glm::vec2(heights.MinHeight, heights.MaxHeight);
+
+		// the flood surface is drawn with the same strip, its heights change every frame
+		glGenVertexArrays(1, &floodVAO);
+		glBindVertexArray(floodVAO);
+		floodStream.create(GL_ARRAY_BUFFER, sizeof(GLushort) * heights.Heights.size());
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gridEBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * grid.Indices.size(), grid.Indices.data(), GL_STATIC_DRAW);
-
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)0);
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)(6 * sizeof(GLfloat)));
+		VertexPacking::SetupHeightAttribute();
 		glBindVertexArray(0);
 	}
 
-	void update(GLFWwindow* window, Camera camera, float deltaTime, unsigned int SCR_WIDTH, unsigned int SCR_HEIGHT)
+	///<summary>
+	/// Replaces the generated grid with tiles streamed from a Heightmap tiled file.
+	///</summary>
+	bool streamHeightmap(const std::string& tiledPath)
+	{
+		return streamer.open(tiledPath);
+	}
+
+	bool isStreaming() const
+	{
+		return streamer.isOpen();
+	}
+
+	// the generated grid, CPU side, for height queries
+	const VertexPacking::HeightGridData& heightGrid() const
+	{
+		return heights;
+	}
+
+	int getSeed() const
+	{
+		return seed;
+	}
+
+	///<summary>
+	/// Replaces the heights of the generated grid, CPU side only, one sample per grid vertex.
+	/// The range is recomputed so nothing is clamped. render() uploads a snapshot's
+	/// FrameSnapshot::TerrainHeights with its TerrainRange.
+	///</summary>
+	void setHeights(const std::vector<float>& samples)
+	{
+		if (samples.size() != heights.Heights.size() || samples.empty())
+			return;
+
+		float minHeight = samples[0], maxHeight = samples[0];
+		for (size_t i = 1; i < samples.size(); ++i)
+		{
+			minHeight = glm::min(minHeight, samples[i]);
+			maxHeight = glm::max(maxHeight, samples[i]);
+		}
+		heights.MinHeight = minHeight;
+		heights.MaxHeight = maxHeight;
+
+		float scale = 1.0f / glm::max(maxHeight - minHeight, 1e-6f);
+		for (size_t i = 0; i < samples.size(); ++i)
+			heights.Heights[i] = glm::packUnorm1x16((samples[i] - minHeight) * scale);
+	}
+
+	///<summary>
+	/// Writes the generated grid as a Heightmap tiled file.
+	///</summary>
+	bool exportHeightmap(const std::string& tiledPath) const
+	{
+		std::vector<float> samples(heights.Heights.size());
+		float range = heights.MaxHeight - heights.MinHeight;
+		for (size_t i = 0; i < samples.size(); ++i)
+			samples[i] = heights.MinHeight + range * (heights.Heights[i] / 65535.0f);
+		return Heightmap::ExportTiled(samples.data(), heights.Columns, heights.Rows, tiledPath, heights.Width / (heights.Columns - 1));
+	}
+
+	///<summary>
+	/// Sets the height of every grid vertex from the seeded noise. Vertices are independent,
+	/// so they are spread over the job system.
+	///</summary>
+	static void GenerateTerrain(int seed, GeometryGenerator::MeshData& grid)
+	{
+		JobSystem::instance().parallelFor(grid.Vertices.size(), 1024, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				grid.Vertices[i].Position.y = -2.0f + generateHeight(seed, grid.Vertices[i].Position.x, grid.Vertices[i].Position.z);
+			}
+		});
+	}
+
+	void render(const FrameSnapshot& frame)
 	{
 		// ativate shader program
+		Shader& shaderProgram = litShaders.get(ShaderLibrary::litKey((unsigned int)pointLightPositions.size(), false, false));
 		shaderProgram.use();
 
-		setLightingUniforms(&shaderProgram, pointLightPositions, camera);
-
-		// pass projection matrix to shader (note that in this case it could change every frame)
-		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-		shaderProgram.setMat4("projection", projection);
+		// the range comes with the heights, setHeights() may be changing the grid's right now
+		if (!streamer.isOpen() && frame.TerrainVersion != uploadedVersion && frame.TerrainHeights.size() == heights.Heights.size())
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, gridVBO);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(GLushort) * frame.TerrainHeights.size(), frame.TerrainHeights.data());
+			uploadedVersion = frame.TerrainVersion;
+			uploadedRange = frame.TerrainRange;
+		}
+		VertexPacking::SetHeightGridUniforms(shaderProgram, heights, uploadedRange);
 
-		// pass camera/view transformation matrix to shader 
-		glm::mat4 view = camera.GetViewMatrix();
-		shaderProgram.setMat4("view", view);
+		setLightingUniforms(shaderProgram, pointLightPositions, frame);
 
-		// pass model matrix to shader 
-		glm::mat4 model = glm::mat4();
-		shaderProgram.setMat4("model", model);
+		// pass projection, camera/view and model matrices to shader
+		shaderProgram.setMat4("projection", frame.Projection);
+		shaderProgram.setMat4("view", frame.View);
+		shaderProgram.setMat4("model", glm::mat4());
 
 		shaderProgram.setVec3("objectColor", 0.0f, 0.8f, 0.0f);
 		shaderProgram.setVec3("lightColor", 1.0f, 1.0f, 1.0f);
 		shaderProgram.setVec3("lightPos", lightPos);
-		shaderProgram.setVec3("viewPos", camera.Position);
+		shaderProgram.setVec3("viewPos", frame.CameraPosition);
 
-		// Set Render Mode
-		GLenum GL_RENDER_MODE = GL_LINES; // GL_LINES or GL_TRIANGLES
+		// Set Render Mode (the grid is a strip, so wireframe comes from the polygon mode)
+		GLenum GL_POLYGON_RENDER_MODE = GL_LINE; // GL_LINE or GL_FILL
+
+		if (streamer.isOpen())
+		{
+			// uploads finished tiles, so it belongs to the render phase
+			streamer.update(frame.CameraPosition, frame.DeltaTime, frame.Arena);
+			streamer.draw(shaderProgram, GL_POLYGON_RENDER_MODE);
+			return;
+		}
 
 		// bind and draw grid element buffer
 		glBindVertexArray(gridVAO);
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-		glDrawElements(GL_RENDER_MODE, grid.Indices.size(), GL_UNSIGNED_INT, 0);
+		glPolygonMode(GL_FRONT_AND_BACK, GL_POLYGON_RENDER_MODE);
+		glDrawElements(GL_TRIANGLE_STRIP, gridIndexCount, gridIndexType, 0);
+
+		renderFlood(shaderProgram, frame);
 	}
 
-	void setLightingUniforms(Shader* shader, std::vector<glm::vec3> pointLightPositions, Camera camera)
+	void setLightingUniforms(const Shader& lightingShader, const std::vector<glm::vec3>& pointLightPositions, const FrameSnapshot& frame)
 	{
-		Shader lightingShader = *shader;
-
-		lightingShader.setVec3("viewPos", camera.Position);
+		lightingShader.setVec3("viewPos", frame.CameraPosition);
 		lightingShader.setFloat("material.shininess", 32.0f);
 
 		// directional light
@@ -104,22 +249,19 @@ public:
 		lightingShader.setVec3("dirLight.diffuse", 0.4f, 0.4f, 0.4f);
 		lightingShader.setVec3("dirLight.specular", 0.5f, 0.5f, 0.5f);
 		// point lights
-		for (int i = 0; i < pointLightPositions.size(); i++)
+		for (unsigned int i = 0; i < pointLightPositions.size(); i++)
 		{
-			std::string pointLightNum = "pointLights[" + std::to_string(i);
-			std::string test = std::string(pointLightNum + "].position");
-
-			lightingShader.setVec3(std::string(pointLightNum + "].position"), pointLightPositions[i]);
-			lightingShader.setVec3(std::string(pointLightNum + "].ambient"), 0.05f, 0.05f, 0.05f);
-			lightingShader.setVec3(std::string(pointLightNum + "].diffuse"), 0.8f, 0.8f, 0.8f);
-			lightingShader.setVec3(std::string(pointLightNum + "].specular"), 1.0f, 1.0f, 1.0f);
-			lightingShader.setFloat(std::string(pointLightNum + "].constant"), 1.0f);
-			lightingShader.setFloat(std::string(pointLightNum + "].linear"), 0.09);
-			lightingShader.setFloat(std::string(pointLightNum + "].quadratic"), 0.032);
+			lightingShader.setVec3(ShaderLibrary::pointLightUniform(i, ShaderLibrary::POINT_LIGHT_POSITION), pointLightPositions[i]);
+			lightingShader.setVec3(ShaderLibrary::pointLightUniform(i, ShaderLibrary::POINT_LIGHT_AMBIENT), 0.05f, 0.05f, 0.05f);
+			lightingShader.setVec3(ShaderLibrary::pointLightUniform(i, ShaderLibrary::POINT_LIGHT_DIFFUSE), 0.8f, 0.8f, 0.8f);
+			lightingShader.setVec3(ShaderLibrary::pointLightUniform(i, ShaderLibrary::POINT_LIGHT_SPECULAR), 1.0f, 1.0f, 1.0f);
+			lightingShader.setFloat(ShaderLibrary::pointLightUniform(i, ShaderLibrary::POINT_LIGHT_CONSTANT), 1.0f);
+			lightingShader.setFloat(ShaderLibrary::pointLightUniform(i, ShaderLibrary::POINT_LIGHT_LINEAR), 0.09);
+			lightingShader.setFloat(ShaderLibrary::pointLightUniform(i, ShaderLibrary::POINT_LIGHT_QUADRATIC), 0.032);
 		}
 		// spotLight
-		lightingShader.setVec3("spotLight.position", camera.Position);
-		lightingShader.setVec3("spotLight.direction", camera.Front);
+		lightingShader.setVec3("spotLight.position", frame.CameraPosition);
+		lightingShader.setVec3("spotLight.direction", frame.CameraFront);
 		lightingShader.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
 		lightingShader.setVec3("spotLight.diffuse", 1.0f, 1.0f, 1.0f);
 		lightingShader.setVec3("spotLight.specular", 1.0f, 1.0f, 1.0f);
@@ -131,10 +273,58 @@ public:
 	}
 
 private:
-	Shader shaderProgram;
+	ShaderPermutations litShaders;
+	TerrainStreamer streamer;
 
-	GeometryGenerator::MeshData grid;
+	VertexPacking::HeightGridData heights;
 	GLuint gridVAO, gridVBO, gridEBO;
+	GLsizei gridIndexCount = 0;
+	GLenum gridIndexType = GL_UNSIGNED_SHORT;
+	unsigned int uploadedVersion = 0;	// FrameSnapshot::TerrainVersion in gridVBO
+	glm::vec2 uploadedRange;			// heights gridVBO spans
+
+	GLuint floodVAO = 0;
+	StreamBuffer floodStream;
+
+	void renderFlood(const Shader& shaderProgram, const FrameSnapshot& frame)
+	{
+		if (frame.FloodSurface.size() != heights.Heights.size())
+			return;
+
+		void* mapped = floodStream.map();
+		if (mapped == nullptr)
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			return;
+		}
+		memcpy(mapped, frame.FloodSurface.data(), sizeof(GLushort) * frame.FloodSurface.size());
+		GLintptr offset = floodStream.unmap();
+
+		// point the attribute at this frame's region, a base vertex would shift gl_VertexID
+		glBindVertexArray(floodVAO);
+		glBindBuffer(GL_ARRAY_BUFFER, floodStream.id());
+		glVertexAttribPointer(0, 1, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(GLushort), (GLvoid*)offset);
+
+		// same grid as the terrain, only the packed range differs
+		shaderProgram.setVec2("heightRange", frame.FloodRange.x, frame.FloodRange.y);
+		shaderProgram.setVec3("objectColor", 0.2f, 0.4f, 1.0f);
+		glDrawElements(GL_TRIANGLE_STRIP, gridIndexCount, gridIndexType, 0);
+		floodStream.fence();
+		glBindVertexArray(0);
+	}
+
+	// AssetPack info block of the height section
+	struct PackInfo
+	{
+		int Seed;
+		int Rows;
+		int Columns;
+		float Width;
+		float Depth;
+		float MinHeight;
+		float MaxHeight;
+		unsigned int IndexCount;
+	};
 
 	//lighting
 	glm::vec3 lightPos = glm::vec3(1.2f, 1.0f, 2.0f);
@@ -144,46 +334,38 @@ private:
 		glm::vec3(-15.0f, 1.5f, 0.0f) 
 	};
 
-	void generateTerrain()
-	{
-		for (int i = 0; i < grid.Vertices.size(); i++)
-		{
-			grid.Vertices[i].Position.y = -2.0f + generateHeight(grid.Vertices[i].Position.x, grid.Vertices[i].Position.z);
-		}
-	}
-
 	int seed;
-	const int AMPLITUDE = 1;
+	static const int AMPLITUDE = 1;
 
-	float generateHeight(float x, float z)
+	static float generateHeight(int seed, float x, float z)
 	{
 		//float total = getInterpolatedNoise(x, z) * AMPLITUDE;
 		
-		float total = getInterpolatedNoise(x/4.0f, z/4.0f) * AMPLITUDE;
-		total += getInterpolatedNoise(x/2.0f, z/2.0f) * AMPLITUDE/3.0f;
+		float total = getInterpolatedNoise(seed, x/4.0f, z/4.0f) * AMPLITUDE;
+		total += getInterpolatedNoise(seed, x/2.0f, z/2.0f) * AMPLITUDE/3.0f;
 		//total += getInterpolatedNoise(x, z) * AMPLITUDE / 9.0f;
 		
 		return total;
 	}
 
-	float interpolate(float a, float b, float blend)
+	static float interpolate(float a, float b, float blend)
 	{
 		double theta = blend * glm::pi<float>();
 		float f = (1 - cos(theta)) * 0.5;
 		return a * (1.0f - f) + b * f;
 	}
 
-	float getInterpolatedNoise(float x, float z)
+	static float getInterpolatedNoise(int seed, float x, float z)
 	{
 		int intX = (int)x;
 		int intZ = (int)z;
 		float fracX = x - intX;
 		float fracZ = z - intZ;
 
-		float v1 = generateSmoothNoise(intX, intZ);
-		float v2 = generateSmoothNoise(intX + 1, intZ);
-		float v3 = generateSmoothNoise(intX, intZ + 1);
-		float v4 = generateSmoothNoise(intX + 1, intZ + 1);
+		float v1 = generateSmoothNoise(seed, intX, intZ);
+		float v2 = generateSmoothNoise(seed, intX + 1, intZ);
+		float v3 = generateSmoothNoise(seed, intX, intZ + 1);
+		float v4 = generateSmoothNoise(seed, intX + 1, intZ + 1);
 
 		float i1 = interpolate(v1, v2, fracX);
 		float i2 = interpolate(v3, v4, fracX);
@@ -191,19 +373,26 @@ private:
 		return interpolate(i1, i2, fracZ);
 	}
 
-	float generateSmoothNoise(float x, float z)
+	static float generateSmoothNoise(int seed, float x, float z)
 	{
-		float corners = (generateNoise(x-1, z-1) + generateNoise(x-1, z+1) + generateNoise(x+1, z-1) + generateNoise(x+1, z+1));
-		float sides = (generateNoise(x - 1, z) + generateNoise(x, z - 1) + generateNoise(x + 1, z) + generateNoise(x, z + 1));
-		float center = generateNoise(x, z);
+		float corners = (generateNoise(seed, x-1, z-1) + generateNoise(seed, x-1, z+1) + generateNoise(seed, x+1, z-1) + generateNoise(seed, x+1, z+1));
+		float sides = (generateNoise(seed, x - 1, z) + generateNoise(seed, x, z - 1) + generateNoise(seed, x + 1, z) + generateNoise(seed, x, z + 1));
+		float center = generateNoise(seed, x, z);
 
 		return (corners / 16.0f) + (sides / 8.0f) + (center / 4.0f);
 	}
 
-	float generateNoise(float x, float z)
+	// a hash of the lattice point instead of srand/rand, which share one global state and
+	// cannot be called from several threads
+	static float generateNoise(int seed, float x, float z)
 	{
-		srand(x * 4698 + z * 3253 + seed);
-		return rand() % 3;
+		unsigned int h = (unsigned int)(int)(x * 4698 + z * 3253 + seed);
+		h ^= h >> 16;
+		h *= 0x7feb352du;
+		h ^= h >> 15;
+		h *= 0x846ca68bu;
+		h ^= h >> 16;
+		return (float)(h % 3);
 	}
 
 	const char *vertexShaderSource = "#version 330 core\n"
@@ -224,6 +413,23 @@ private:
 		"	TexCoords = aTexCoord;\n"
 		"}\0";
 
+	const char *heightVertexShaderSource = "#version 330 core\n"
+		"layout (location = 0) in float height;\n"
+		"uniform mat4 model; \n"
+		"uniform mat4 view; \n"
+		"uniform mat4 projection; \n"
+		"out vec3 FragPos; \n"
+		"out vec3 Normal; \n"
+		"out vec2 TexCoords;\n"
+		"#include \"height_grid\"\n"
+		"void main()\n"
+		"{\n"
+		"	FragPos = vec3(model * vec4(gridPosition(height), 1.0)); \n"
+		"	Normal = mat3(transpose(inverse(model))) * vec3(0.0, 1.0, 0.0); \n"
+		"	gl_Position = projection * view * vec4(FragPos, 1.0); \n"
+		"	TexCoords = gridTexCoord();\n"
+		"}\0";
+
 	const char *fragmentShaderSource = "#version 330 core\n"
 		"in vec3 Normal; \n"
 		"in vec3 FragPos; \n"
@@ -252,106 +458,6 @@ private:
 		"	vec3 result = (ambient + diffuse + specular) * objectColor; \n"
 		"	FragColor = vec4(result, 1.0); \n"
 		"}\n\0";
-
-		const char *newFragmentShaderSource = "#version 330 core\n"
-			"out vec4 FragColor;\n"
-
-			"struct Material {\n"
-			"	sampler2D diffuse;\n"
-			"	sampler2D specular;\n"
-			"	float shininess;\n"
-			"};\n"
-
-			"struct DirLight {\n"
-			"	vec3 direction;\n"
-
-			"	vec3 ambient;\n"
-			"	vec3 diffuse;\n"
-			"	vec3 specular;\n"
-			"};\n"
-
-			"struct PointLight {\n"
-			"	vec3 position;\n"
-
-			"	float constant;\n"
-			"	float linear;\n"
-			"	float quadratic;\n"
-
-			"	vec3 ambient;\n"
-			"	vec3 diffuse;\n"
-			"	vec3 specular;\n"
-			"};\n"
-
-			"#define NR_POINT_LIGHTS 3\n"
-
-			"in vec3 FragPos;\n"
-			"in vec3 Normal;\n"
-			"in vec2 TexCoords;\n"
-
-			"uniform vec3 objectColor;\n"
-
-			"uniform vec3 viewPos;\n"
-			"uniform DirLight dirLight;\n"
-			"uniform PointLight pointLights[NR_POINT_LIGHTS];\n"
-			"uniform Material material;\n"
-
-			"// function prototypes\n"
-			"vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);\n"
-			"vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);\n"
-
-			"void main()\n"
-			"{\n"
-			"	// properties\n"
-			"	vec3 norm = normalize(Normal);\n"
-			"	vec3 viewDir = normalize(viewPos - FragPos);\n"
-
-			"	// phase 1: directional lighting\n"
-			"	vec3 result = CalcDirLight(dirLight, norm, viewDir);\n"
-
-			"	// phase 2: point lights\n"
-			"	for (int i = 0; i < NR_POINT_LIGHTS; i++)\n"
-			"		result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);\n"
-
-			"	FragColor = vec4(result, 1.0);\n"
-			"}\n"
-
-			"// calculates the color when using a directional light.\n"
-			"vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)\n"
-			"{\n"
-			"	vec3 lightDir = normalize(-light.direction);\n"
-			"	// diffuse shading\n"
-			"	float diff = max(dot(normal, lightDir), 0.0);\n"
-			"	// specular shading\n"
-			"	vec3 reflectDir = reflect(-lightDir, normal);\n"
-			"	float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);\n"
-			"	// combine results\n"
-			"	vec3 ambient = light.ambient * objectColor;\n"
-			"	vec3 diffuse = light.diffuse * diff * objectColor;\n"
-			"	vec3 specular = light.specular * spec * objectColor;\n"
-			"	return (ambient + diffuse + specular);\n"
-			"}\n"
-
-			"// calculates the color when using a point light.\n"
-			"vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)\n"
-			"{\n"
-			"	vec3 lightDir = normalize(light.position - fragPos);\n"
-			"	// diffuse shading\n"
-			"	float diff = max(dot(normal, lightDir), 0.0); \n"
-			"	// specular shading\n"
-			"	vec3 reflectDir = reflect(-lightDir, normal); \n"
-			"	float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess); \n"
-			"	// attenuation\n"
-			"	float distance = length(light.position - fragPos); \n"
-			"	float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance)); \n"
-			"	// combine results\n"
-			"	vec3 ambient = light.ambient * objectColor; \n"
-			"	vec3 diffuse = light.diffuse * diff * objectColor; \n"
-			"	vec3 specular = light.specular * spec * objectColor;\n"
-			"	ambient *= attenuation; \n"
-			"	diffuse *= attenuation; \n"
-			"	specular *= attenuation; \n"
-			"	return (ambient + diffuse + specular); \n"
-			"}\n\0";
 };
 
 #endif	// TERRAIN_H
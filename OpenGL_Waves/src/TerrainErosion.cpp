@@ -0,0 +1,271 @@
+#include "TerrainErosion.h"
+#include "JobSystem.h"
+
+namespace
+{
+	// droplets, in cells and world units per cell
+	const int DROPLET_LIFETIME = 30;		// moves of one cell before a droplet dries up
+	const float INERTIA = 0.05f;			// how much of its direction a droplet keeps
+	const float SEDIMENT_CAPACITY = 0.1f;	// per unit of drop, speed and water
+	const float MIN_CAPACITY = 0.01f;		// so droplets on flat ground still carry a little
+	const float ERODE_RATE = 0.3f;			// fraction of the free capacity taken per move
+	const float DEPOSIT_RATE = 0.3f;		// fraction of the excess sediment dropped per move
+	const float EVAPORATION = 0.01f;
+	const float DROPLET_GRAVITY = 4.0f;
+
+	// thermal erosion: slopes steeper than this per unit of distance slide
+	const float TALUS_SLOPE = 0.8f;
+	// fraction of the excess moved across each of the four edges per pass, at most 1/8 so
+	// a cell never gives away more than it is above its neighbours
+	const float THERMAL_RATE = 0.1f;
+
+	unsigned int hash(unsigned int h)
+	{
+		h ^= h >> 16;
+		h *= 0x7feb352du;
+		h ^= h >> 15;
+		h *= 0x846ca68bu;
+		h ^= h >> 16;
+		return h;
+	}
+
+	// xorshift, uniform in [0, 1)
+	float nextRandom(unsigned int& state)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return (state >> 8) * (1.0f / 16777216.0f);
+	}
+
+	// material sliding from a down to b, the same expression on both sides keeps it exact
+	float slide(float a, float b, float talus)
+	{
+		return THERMAL_RATE * glm::max(0.0f, a - b - talus);
+	}
+}
+
+void TerrainErosion::init(const VertexPacking::HeightGridData& grid, unsigned int erosionSeed)
+{
+	columns = grid.Columns;
+	rows = grid.Rows;
+	cellSize = grid.Width / (grid.Columns - 1);
+	seed = erosionSeed;
+	batch = 0;
+	droplets = 0;
+
+	float range = grid.MaxHeight - grid.MinHeight;
+	height.resize((size_t)columns * rows);
+	for (size_t i = 0; i < height.size(); ++i)
+		height[i] = grid.MinHeight + range * (grid.Heights[i] / 65535.0f);
+	scratch.assign(height.size(), 0.0f);
+	passTiles.reserve((size_t)(columns / TILE + 2) * (rows / TILE + 2));
+}
+
+void TerrainErosion::step(unsigned int dropletsPerStep)
+{
+	if (!isReady())
+		return;
+
+	unsigned int random = hash(seed ^ hash(batch)) | 1u;
+	int offsetX = (int)(nextRandom(random) * TILE);
+	int offsetZ = (int)(nextRandom(random) * TILE);
+	int tilesX = (columns + offsetX + TILE - 1) / TILE;
+	int tilesZ = (rows + offsetZ + TILE - 1) / TILE;
+	float dropletsPerCell = (float)dropletsPerStep / ((float)columns * rows);
+
+	JobSystem& jobs = JobSystem::instance();
+	for (int pass = 0; pass < 4; ++pass)
+	{
+		// one corner of every 2 x 2 block of tiles, a tile apart from each other
+		passTiles.clear();
+		for (int tz = pass / 2; tz < tilesZ; tz += 2)
+		{
+			for (int tx = pass % 2; tx < tilesX; tx += 2)
+			{
+				// tiles on the edges are cut off by the grid and get fewer droplets
+				int width = glm::min((tx + 1) * TILE - offsetX, columns) - glm::max(tx * TILE - offsetX, 0);
+				int depth = glm::min((tz + 1) * TILE - offsetZ, rows) - glm::max(tz * TILE - offsetZ, 0);
+				PassTile tile;
+				tile.X = tx;
+				tile.Z = tz;
+				tile.Droplets = (unsigned int)(dropletsPerCell * width * depth + 0.5f);
+				passTiles.push_back(tile);
+				droplets += tile.Droplets;
+			}
+		}
+
+		jobs.parallelFor(passTiles.size(), MIN_TILES_PER_JOB, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; ++i)
+				runTile(passTiles[i].X, passTiles[i].Z, offsetX, offsetZ, passTiles[i].Droplets);
+		});
+	}
+
+	jobs.parallelFor(rows, MIN_ROWS_PER_JOB, [&](size_t begin, size_t end)
+	{
+		relaxRows(begin, end);
+	});
+	height.swap(scratch);
+	batch++;
+}
+
+void TerrainErosion::runTile(int tileX, int tileZ, int offsetX, int offsetZ, unsigned int count)
+{
+	int firstX = glm::max(tileX * TILE - offsetX, 0);
+	int firstZ = glm::max(tileZ * TILE - offsetZ, 0);
+	int endX = glm::min((tileX + 1) * TILE - offsetX, columns - 1);
+	int endZ = glm::min((tileZ + 1) * TILE - offsetZ, rows - 1);
+	if (endX <= firstX || endZ <= firstZ)
+		return;
+
+	// droplets stay ROAM cells around the tile, with room for the cell after them
+	int minX = glm::max(firstX - ROAM, 0);
+	int minZ = glm::max(firstZ - ROAM, 0);
+	int maxX = glm::min(endX + ROAM, columns - 1);
+	int maxZ = glm::min(endZ + ROAM, rows - 1);
+
+	unsigned int random = hash(seed ^ hash(batch * 7919u + (unsigned int)(tileZ * 65521 + tileX))) | 1u;
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		float x = firstX + nextRandom(random) * (endX - firstX);
+		float z = firstZ + nextRandom(random) * (endZ - firstZ);
+		runDroplet(x, z, minX, minZ, maxX, maxZ, random);
+	}
+}
+
+void TerrainErosion::runDroplet(float x, float z, int minX, int minZ, int maxX, int maxZ, unsigned int& random)
+{
+	glm::vec2 position(x, z);
+	glm::vec2 direction(0.0f);
+	float speed = 1.0f;
+	float water = 1.0f;
+	float sediment = 0.0f;
+
+	for (int life = 0; life < DROPLET_LIFETIME; ++life)
+	{
+		glm::vec2 gradient;
+		float here = sample(position.x, position.y, gradient);
+
+		direction = direction * INERTIA - gradient * (1.0f - INERTIA);
+		float length = glm::length(direction);
+		if (length < 1e-6f)
+		{
+			float angle = nextRandom(random) * glm::two_pi<float>();
+			direction = glm::vec2(cosf(angle), sinf(angle));
+		}
+		else
+		{
+			direction /= length;
+		}
+
+		glm::vec2 next = position + direction;
+		if (next.x < minX || next.y < minZ || next.x >= maxX || next.y >= maxZ)
+			break;
+
+		glm::vec2 unused;
+		float drop = sample(next.x, next.y, unused) - here;
+		float capacity = glm::max(-drop * speed * water * SEDIMENT_CAPACITY, MIN_CAPACITY);
+		if (drop > 0.0f || sediment > capacity)
+		{
+			// uphill the droplet fills the pit behind it, otherwise it sheds what it cannot carry
+			float amount = (drop > 0.0f) ? glm::min(drop, sediment) : (sediment - capacity) * DEPOSIT_RATE;
+			deposit(position.x, position.y, amount);
+			sediment -= amount;
+		}
+		else
+		{
+			// never dig deeper than the drop, that would leave a hole
+			float amount = glm::min((capacity - sediment) * ERODE_RATE, -drop);
+			erode(position.x, position.y, amount);
+			sediment += amount;
+		}
+
+		speed = sqrtf(glm::max(speed * speed - drop * DROPLET_GRAVITY, 0.0f));
+		water *= 1.0f - EVAPORATION;
+		position = next;
+	}
+
+	// whatever it still carries stays where it stopped
+	deposit(position.x, position.y, sediment);
+}
+
+float TerrainErosion::sample(float x, float z, glm::vec2& gradient) const
+{
+	int column = (int)x;
+	int row = (int)z;
+	float fx = x - column;
+	float fz = z - row;
+	const float* h = &height[row * columns + column];
+
+	gradient.x = (h[1] - h[0]) * (1.0f - fz) + (h[columns + 1] - h[columns]) * fz;
+	gradient.y = (h[columns] - h[0]) * (1.0f - fx) + (h[columns + 1] - h[1]) * fx;
+	return (h[0] * (1.0f - fx) + h[1] * fx) * (1.0f - fz) + (h[columns] * (1.0f - fx) + h[columns + 1] * fx) * fz;
+}
+
+void TerrainErosion::deposit(float x, float z, float amount)
+{
+	int column = (int)x;
+	int row = (int)z;
+	float fx = x - column;
+	float fz = z - row;
+	float* h = &height[row * columns + column];
+
+	h[0] += amount * (1.0f - fx) * (1.0f - fz);
+	h[1] += amount * fx * (1.0f - fz);
+	h[columns] += amount * (1.0f - fx) * fz;
+	h[columns + 1] += amount * fx * fz;
+}
+
+void TerrainErosion::erode(float x, float z, float amount)
+{
+	// a cone of BRUSH_RADIUS cells, normalized over the cells inside the grid
+	int column = (int)x;
+	int row = (int)z;
+	int firstX = glm::max(column - BRUSH_RADIUS, 0), lastX = glm::min(column + BRUSH_RADIUS, columns - 1);
+	int firstZ = glm::max(row - BRUSH_RADIUS, 0), lastZ = glm::min(row + BRUSH_RADIUS, rows - 1);
+
+	float total = 0.0f;
+	for (int r = firstZ; r <= lastZ; ++r)
+		for (int c = firstX; c <= lastX; ++c)
+			total += glm::max(0.0f, BRUSH_RADIUS - glm::length(glm::vec2(c - x, r - z)));
+	if (total <= 0.0f)
+		return;
+
+	float scale = amount / total;
+	for (int r = firstZ; r <= lastZ; ++r)
+		for (int c = firstX; c <= lastX; ++c)
+			height[r * columns + c] -= scale * glm::max(0.0f, BRUSH_RADIUS - glm::length(glm::vec2(c - x, r - z)));
+}
+
+void TerrainErosion::relaxRows(size_t firstRow, size_t endRow)
+{
+	const float talus = TALUS_SLOPE * cellSize;
+	for (size_t r = firstRow; r < endRow; ++r)
+	{
+		const int row = (int)r;
+		for (int column = 0; column < columns; ++column)
+		{
+			int i = row * columns + column;
+			float h = height[i];
+			float change = 0.0f;
+			if (column > 0)
+				change += slide(height[i - 1], h, talus) - slide(h, height[i - 1], talus);
+			if (column < columns - 1)
+				change += slide(height[i + 1], h, talus) - slide(h, height[i + 1], talus);
+			if (row > 0)
+				change += slide(height[i - columns], h, talus) - slide(h, height[i - columns], talus);
+			if (row < rows - 1)
+				change += slide(height[i + columns], h, talus) - slide(h, height[i + columns], talus);
+			scratch[i] = h + change;
+		}
+	}
+}
+
+double TerrainErosion::totalVolume() const
+{
+	double volume = 0.0;
+	for (size_t i = 0; i < height.size(); ++i)
+		volume += height[i];
+	return volume * cellSize * cellSize;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#ifndef TERRAINEROSION_H
+#define TERRAINEROSION_H
+
+#include "GL_Util.h"
+#include "VertexPacking.h"
+
+#include <vector>
+
+// Wears down a generated height grid a little at a time, so the noise hills get gullies and
+// slopes settle, without holding up start up.
+//
+// Hydraulic erosion is particle based: a droplet runs downhill from a random cell, picks up
+// sediment while it speeds up and drops it where it slows down or climbs. Droplets of a batch
+// run in parallel by tile ownership. The grid is cut into TILE x TILE tiles and a droplet
+// may only move within ROAM cells of its own tile, so with the tiles taken in four passes, one
+// per corner of every 2 x 2 block, the tiles of a pass can never touch the same cells. Each
+// batch shifts the tiles by a random offset so their borders do not show in the terrain.
+//
+// Thermal erosion slides material off every slope steeper than the talus angle, all cells at
+// once from a copy of the heights, in stripes of rows on the job system.
+//
+// Random numbers are seeded per batch and tile, so the result does not depend on the number
+// of threads.
+class TerrainErosion
+{
+public:
+	static const int TILE = 32;
+	static const int BRUSH_RADIUS = 3;				// cells a droplet erodes around itself
+	static const int ROAM = TILE / 2 - BRUSH_RADIUS - 2;	// cells a droplet may leave its tile by
+
+	///<summary>
+	/// Takes the heights to erode, with the layout of a Terrain height grid.
+	///</summary>
+	void init(const VertexPacking::HeightGridData& grid, unsigned int seed);
+	bool isReady() const { return columns > 0; }
+
+	///<summary>
+	/// Runs about droplets droplets, spread evenly over the tiles, then one thermal pass.
+	///</summary>
+	void step(unsigned int droplets);
+
+	// heights in world units, row by row like the grid
+	const std::vector<float>& heights() const { return height; }
+	unsigned long long dropletCount() const { return droplets; }
+	double totalVolume() const;
+
+private:
+	// tiles per job in a pass
+	static const size_t MIN_TILES_PER_JOB = 1;
+	// rows per job of a thermal pass
+	static const size_t MIN_ROWS_PER_JOB = 32;
+
+	int columns = 0;
+	int rows = 0;
+	float cellSize = 1.0f;
+	unsigned int seed = 0;
+	unsigned int batch = 0;
+	unsigned long long droplets = 0;
+
+	std::vector<float> height;
+	std::vector<float> scratch;		// thermal pass output
+	struct PassTile
+	{
+		int X;
+		int Z;
+		unsigned int Droplets;
+	};
+	std::vector<PassTile> passTiles;	// tiles of the pass being run
+
+	void runTile(int tileX, int tileZ, int offsetX, int offsetZ, unsigned int count);
+	void runDroplet(float x, float z, int minX, int minZ, int maxX, int maxZ, unsigned int& random);
+	void relaxRows(size_t firstRow, size_t endRow);
+
+	float sample(float x, float z, glm::vec2& gradient) const;
+	void deposit(float x, float z, float amount);
+	void erode(float x, float z, float amount);
+};
+
+#endif // TERRAINEROSION_H
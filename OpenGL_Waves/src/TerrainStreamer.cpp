@@ -0,0 +1,247 @@
+#include "TerrainStreamer.h"
+
+#include <algorithm>
+#include <cmath>
+
+const float TerrainStreamer::READ_AHEAD_SECONDS = 2.0f;
+
+TerrainStreamer::~TerrainStreamer()
+{
+	close();
+}
+
+bool TerrainStreamer::open(const std::string& file)
+{
+	close();
+
+	std::ifstream input(file.c_str(), std::ios::binary);
+	if (!input || !Heightmap::ReadHeader(input, header))
+	{
+		std::cout << "ERROR::TERRAIN_STREAMER::FILE_NOT_SUCCESFULLY_READ " << file << std::endl;
+		return false;
+	}
+	path = file;
+
+	int edge = header.TileSize + 1;
+	grid.Rows = edge;
+	grid.Columns = edge;
+	grid.Width = header.TileSize * header.Spacing;
+	grid.Depth = header.TileSize * header.Spacing;
+	grid.MinHeight = header.MinHeight;
+	grid.MaxHeight = header.MaxHeight;
+
+	// every tile has the same strip layout, so they share one index buffer
+	GeometryGenerator::MeshData mesh;
+	GeometryGenerator geoGen;
+	geoGen.CreateGrid(grid.Width, grid.Depth, edge, edge, mesh, true);
+	indexCount = (GLsizei)mesh.Indices.size();
+	indexType = mesh.IndexType();
+
+	std::vector<GLushort> shortIndices;
+	const void* indexData = mesh.Indices.data();
+	if (indexType == GL_UNSIGNED_SHORT)
+	{
+		mesh.NarrowIndices(shortIndices);
+		indexData = shortIndices.data();
+	}
+	glGenBuffers(1, &indexBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, mesh.IndexBufferSize(), indexData, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	std::cout << "TERRAIN_STREAMER::" << file << " " << header.Width << "x" << header.Height << " samples, "
+		<< header.TilesX << "x" << header.TilesZ << " tiles of " << header.TileSize << std::endl;
+
+	running = true;
+	reader = std::thread(&TerrainStreamer::readerLoop, this);
+	return true;
+}
+
+void TerrainStreamer::close()
+{
+	if (!reader.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		running = false;
+	}
+	wake.notify_all();
+	reader.join();
+
+	requests.clear();
+	inFlight.clear();
+	loaded.clear();
+
+	for (std::map<int, Tile>::iterator it = tiles.begin(); it != tiles.end(); ++it)
+	{
+		glDeleteVertexArrays(1, &it->second.VAO);
+		glDeleteBuffers(1, &it->second.VBO);
+	}
+	tiles.clear();
+	glDeleteBuffers(1, &indexBuffer);
+	indexBuffer = 0;
+	hasLastPosition = false;
+}
+
+glm::vec3 TerrainStreamer::tileCenter(int tileX, int tileZ) const
+{
+	float half = 0.5f * header.TileSize;
+	return glm::vec3(
+		-0.5f * width() + (tileX * header.TileSize + half) * header.Spacing,
+		0.0f,
+		0.5f * depth() - (tileZ * header.TileSize + half) * header.Spacing);
+}
+
+void TerrainStreamer::update(const glm::vec3& cameraPosition, float deltaTime, FrameArena& arena)
+{
+	if (!isOpen())
+		return;
+	frame++;
+
+	// smoothed, so a single jittery frame does not swing the read-ahead around
+	if (hasLastPosition && deltaTime > 0.0f)
+		velocity = glm::mix(velocity, (cameraPosition - lastPosition) / deltaTime, 0.2f);
+	lastPosition = cameraPosition;
+	hasLastPosition = true;
+
+	// wanted tiles as (distance, key); read-ahead tiles are pushed back by one tile so the
+	// ring around the camera always comes first. Rebuilt every frame, so it lives in the arena
+	typedef std::pair<float, int> WantedTile;
+	std::vector<WantedTile, ArenaAllocator<WantedTile> > wanted((ArenaAllocator<WantedTile>(arena)));
+	wanted.reserve((2 * LOAD_RADIUS + 1) * (2 * LOAD_RADIUS + 1) + (2 * READ_AHEAD_RADIUS + 1) * (2 * READ_AHEAD_RADIUS + 1));
+	float tileWorld = header.TileSize * header.Spacing;
+	auto want = [&](const glm::vec3& center, int radius, float penalty)
+	{
+		int centerX = (int)floorf((center.x + 0.5f * width()) / tileWorld);
+		int centerZ = (int)floorf((0.5f * depth() - center.z) / tileWorld);
+		for (int tz = centerZ - radius; tz <= centerZ + radius; ++tz)
+		{
+			for (int tx = centerX - radius; tx <= centerX + radius; ++tx)
+			{
+				if (tx < 0 || tz < 0 || tx >= header.TilesX || tz >= header.TilesZ)
+					continue;
+				glm::vec3 offset = tileCenter(tx, tz) - cameraPosition;
+				wanted.push_back(std::make_pair(glm::length(glm::vec2(offset.x, offset.z)) + penalty, key(tx, tz)));
+			}
+		}
+	};
+	want(cameraPosition, LOAD_RADIUS, 0.0f);
+	want(cameraPosition + velocity * READ_AHEAD_SECONDS, READ_AHEAD_RADIUS, tileWorld);
+
+	// nearest last, the reader takes requests from the back
+	std::sort(wanted.begin(), wanted.end(), [](const std::pair<float, int>& a, const std::pair<float, int>& b) { return a.first > b.first; });
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		requests.clear();
+		for (size_t i = 0; i < wanted.size(); ++i)
+		{
+			std::map<int, Tile>::iterator resident = tiles.find(wanted[i].second);
+			if (resident != tiles.end())
+				resident->second.LastWanted = frame;
+			else if (inFlight.count(wanted[i].second) == 0 && std::find(requests.begin(), requests.end(), wanted[i].second) == requests.end())
+				requests.push_back(wanted[i].second);
+		}
+	}
+	wake.notify_one();
+
+	for (unsigned int i = 0; i < MAX_UPLOADS_PER_FRAME; ++i)
+	{
+		Loaded tile;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (loaded.empty())
+				break;
+			tile.Key = loaded.front().Key;
+			tile.Samples.swap(loaded.front().Samples);
+			loaded.pop_front();
+			inFlight.erase(tile.Key);
+		}
+		upload(tile);
+	}
+
+	// least recently wanted tiles go first, anything wanted this frame stays
+	if (tiles.size() > MAX_RESIDENT_TILES)
+	{
+		std::vector<std::pair<unsigned int, int> > candidates;
+		for (std::map<int, Tile>::const_iterator it = tiles.begin(); it != tiles.end(); ++it)
+		{
+			if (it->second.LastWanted != frame)
+				candidates.push_back(std::make_pair(it->second.LastWanted, it->first));
+		}
+		std::sort(candidates.begin(), candidates.end());
+		for (size_t i = 0; i < candidates.size() && tiles.size() > MAX_RESIDENT_TILES; ++i)
+		{
+			Tile& tile = tiles[candidates[i].second];
+			glDeleteVertexArrays(1, &tile.VAO);
+			glDeleteBuffers(1, &tile.VBO);
+			tiles.erase(candidates[i].second);
+		}
+	}
+}
+
+void TerrainStreamer::upload(Loaded& loadedTile)
+{
+	Tile& tile = tiles[loadedTile.Key];
+	tile.LastWanted = frame;
+
+	glGenVertexArrays(1, &tile.VAO);
+	glGenBuffers(1, &tile.VBO);
+	glBindVertexArray(tile.VAO);
+
+	glBindBuffer(GL_ARRAY_BUFFER, tile.VBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(GLushort) * loadedTile.Samples.size(), loadedTile.Samples.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+
+	VertexPacking::SetupHeightAttribute();
+	glBindVertexArray(0);
+}
+
+void TerrainStreamer::draw(const Shader& shader, GLenum polygonMode) const
+{
+	VertexPacking::SetHeightGridUniforms(shader, grid);
+	glPolygonMode(GL_FRONT_AND_BACK, polygonMode);
+
+	for (std::map<int, Tile>::const_iterator it = tiles.begin(); it != tiles.end(); ++it)
+	{
+		glm::mat4 model = glm::translate(glm::mat4(1.0f), tileCenter(it->first % header.TilesX, it->first / header.TilesX));
+		shader.setMat4("model", model);
+		glBindVertexArray(it->second.VAO);
+		glDrawElements(GL_TRIANGLE_STRIP, indexCount, indexType, 0);
+	}
+}
+
+void TerrainStreamer::readerLoop()
+{
+	std::ifstream file(path.c_str(), std::ios::binary);
+
+	for (;;)
+	{
+		int tileKey;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this] { return !running || !requests.empty(); });
+			if (!running)
+				return;
+			tileKey = requests.back();
+			requests.pop_back();
+			inFlight[tileKey] = true;
+		}
+
+		Loaded tile;
+		tile.Key = tileKey;
+		tile.Samples.resize(header.tileSamples());
+		if (!Heightmap::ReadTile(file, header, tileKey % header.TilesX, tileKey / header.TilesX, tile.Samples.data()))
+		{
+			// left in flight, so the tile is not requested again
+			std::cout << "ERROR::TERRAIN_STREAMER::TILE_NOT_SUCCESFULLY_READ " << tileKey << std::endl;
+			file.clear();
+			continue;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		loaded.push_back(Loaded());
+		loaded.back().Key = tile.Key;
+		loaded.back().Samples.swap(tile.Samples);
+	}
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#ifndef TERRAINSTREAMER_H
+#define TERRAINSTREAMER_H
+
+#include "FrameArena.h"
+#include "GL_Util.h"
+#include "Heightmap.h"
+#include "VertexPacking.h"
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+
+// Streams the tiles of a Heightmap tiled file around the camera. Every frame the tiles
+// within LOAD_RADIUS of the camera, and of the point the camera will reach in
+// READ_AHEAD_SECONDS at its current velocity, are requested nearest first. A reader
+// thread loads them from disk and update() uploads a few per frame. Tiles that are no
+// longer wanted are evicted once more than MAX_RESIDENT_TILES are loaded, so only a
+// window of the map is ever in memory.
+class TerrainStreamer
+{
+public:
+	TerrainStreamer() {}
+	~TerrainStreamer();
+
+	///<summary>
+	/// Opens the tiled file and starts the reader. Must be called with the GL context current.
+	///</summary>
+	bool open(const std::string& path);
+	void close();
+
+	bool isOpen() const { return reader.joinable(); }
+
+	///<summary>
+	/// Requests the tiles around the camera and uploads those the reader has finished.
+	///</summary>
+	void update(const glm::vec3& cameraPosition, float deltaTime, FrameArena& arena);
+
+	///<summary>
+	/// Draws every resident tile with a height_grid shader, which must be in use.
+	///</summary>
+	void draw(const Shader& shader, GLenum polygonMode) const;
+
+	size_t residentCount() const { return tiles.size(); }
+
+	// world space size of the map
+	float width() const { return (header.Width - 1) * header.Spacing; }
+	float depth() const { return (header.Height - 1) * header.Spacing; }
+
+private:
+	enum
+	{
+		LOAD_RADIUS = 2,				// tiles around the camera, in tiles
+		READ_AHEAD_RADIUS = 1,			// tiles around the predicted position
+		MAX_RESIDENT_TILES = 64,
+		MAX_UPLOADS_PER_FRAME = 4
+	};
+	static const float READ_AHEAD_SECONDS;
+
+	struct Tile
+	{
+		GLuint VAO = 0;
+		GLuint VBO = 0;
+		unsigned int LastWanted = 0;	// frame the tile was last in the wanted set
+	};
+
+	struct Loaded
+	{
+		int Key;
+		std::vector<GLushort> Samples;
+	};
+
+	Heightmap::Header header;
+	VertexPacking::HeightGridData grid;	// tile dimensions and height range, shared by all tiles
+	GLuint indexBuffer = 0;
+	GLsizei indexCount = 0;
+	GLenum indexType = GL_UNSIGNED_SHORT;
+
+	std::map<int, Tile> tiles;			// resident, by key
+	unsigned int frame = 0;
+	glm::vec3 lastPosition;
+	glm::vec3 velocity;
+	bool hasLastPosition = false;
+
+	// shared with the reader
+	std::thread reader;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::vector<int> requests;			// nearest last, the reader pops from the back
+	std::map<int, bool> inFlight;
+	std::deque<Loaded> loaded;
+	bool running = false;
+	std::string path;
+
+	int key(int tileX, int tileZ) const { return tileZ * header.TilesX + tileX; }
+	glm::vec3 tileCenter(int tileX, int tileZ) const;
+	void readerLoop();
+	void upload(Loaded& tile);
+
+	// the streamer owns a thread and GL objects
+	TerrainStreamer(const TerrainStreamer&);
+	TerrainStreamer& operator=(const TerrainStreamer&);
+};
+
+#endif // TERRAINSTREAMER_H
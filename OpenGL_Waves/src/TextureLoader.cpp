@@ -0,0 +1,454 @@
+#include "TextureLoader.h"
+#include "AssetPack.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// stb_image is compiled here, with its allocations routed through the staging pool
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_MALLOC(sz) StagingPool::instance().allocate(sz)
+#define STBI_REALLOC(p, newsz) StagingPool::instance().reallocate(p, newsz)
+#define STBI_FREE(p) StagingPool::instance().release(p)
+#include "stb_image.h"
+
+const unsigned int StagingPool::MIN_BUCKET_SHIFT;
+const unsigned int StagingPool::BUCKET_COUNT;
+const size_t StagingPool::MAX_CACHED_BYTES;
+const unsigned int TextureLoader::PBO_COUNT;
+const size_t TextureLoader::BAND_BYTES;
+
+namespace
+{
+	// every block starts with its capacity, padded so the user pointer stays 16 byte aligned
+	struct BlockHeader
+	{
+		size_t Capacity;
+		size_t Padding;
+	};
+
+	BlockHeader* headerOf(void* p)
+	{
+		return reinterpret_cast<BlockHeader*>(p) - 1;
+	}
+}
+
+StagingPool& StagingPool::instance()
+{
+	static StagingPool pool;
+	return pool;
+}
+
+StagingPool::~StagingPool()
+{
+	trim();
+}
+
+unsigned int StagingPool::bucketFor(size_t size)
+{
+	unsigned int bucket = 0;
+	while (bucket < BUCKET_COUNT && (size_t(1) << (MIN_BUCKET_SHIFT + bucket)) < size)
+		bucket++;
+	return bucket;
+}
+
+void* StagingPool::allocate(size_t size)
+{
+	unsigned int bucket = bucketFor(size);
+	size_t capacity = (bucket < BUCKET_COUNT) ? (size_t(1) << (MIN_BUCKET_SHIFT + bucket)) : size;
+
+	if (bucket < BUCKET_COUNT)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!buckets[bucket].empty())
+		{
+			void* p = buckets[bucket].back();
+			buckets[bucket].pop_back();
+			cached -= capacity;
+			return p;
+		}
+	}
+
+	BlockHeader* header = static_cast<BlockHeader*>(malloc(sizeof(BlockHeader) + capacity));
+	if (header == nullptr)
+		return nullptr;
+	header->Capacity = capacity;
+	return header + 1;
+}
+
+void* StagingPool::reallocate(void* p, size_t newSize)
+{
+	if (p == nullptr)
+		return allocate(newSize);
+
+	size_t capacity = headerOf(p)->Capacity;
+	if (newSize <= capacity)
+		return p;
+
+	void* grown = allocate(newSize);
+	if (grown != nullptr)
+	{
+		memcpy(grown, p, capacity);
+		release(p);
+	}
+	return grown;
+}
+
+void StagingPool::release(void* p)
+{
+	if (p == nullptr)
+		return;
+
+	BlockHeader* header = headerOf(p);
+	unsigned int bucket = bucketFor(header->Capacity);
+	if (bucket < BUCKET_COUNT && (size_t(1) << (MIN_BUCKET_SHIFT + bucket)) == header->Capacity)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (cached + header->Capacity <= MAX_CACHED_BYTES)
+		{
+			buckets[bucket].push_back(p);
+			cached += header->Capacity;
+			return;
+		}
+	}
+	free(header);
+}
+
+size_t StagingPool::cachedBytes() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return cached;
+}
+
+void StagingPool::trim()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for (unsigned int b = 0; b < BUCKET_COUNT; ++b)
+	{
+		for (size_t i = 0; i < buckets[b].size(); ++i)
+			free(headerOf(buckets[b][i]));
+		buckets[b].clear();
+	}
+	cached = 0;
+}
+
+TextureLoader::~TextureLoader()
+{
+	shutdown();
+}
+
+void TextureLoader::init(unsigned int workerCount)
+{
+	if (running)
+		return;
+
+	glGenBuffers(PBO_COUNT, pbos);
+
+	// 1x1 white, so untextured draws of a loading material keep their lighting
+	const unsigned char white[4] = { 255, 255, 255, 255 };
+	glGenTextures(1, &fallback);
+	glBindTexture(GL_TEXTURE_2D, fallback);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	if (workerCount == 0)
+	{
+		// hardware_concurrency() may be 0 when it is not known
+		unsigned int cores = std::thread::hardware_concurrency();
+		workerCount = (cores > 1) ? cores - 1 : 1;
+	}
+
+	running = true;
+	for (unsigned int i = 0; i < workerCount; ++i)
+		workers.push_back(std::thread(&TextureLoader::workerLoop, this));
+}
+
+void TextureLoader::shutdown()
+{
+	if (!running)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		running = false;
+	}
+	wake.notify_all();
+	for (size_t i = 0; i < workers.size(); ++i)
+		workers[i].join();
+	workers.clear();
+
+	for (size_t i = 0; i < decoded.size(); ++i)
+		TextureProcessor::Release(decoded[i].Processed);
+	decoded.clear();
+	requests.clear();
+
+	for (unsigned int i = 0; i < PBO_COUNT; ++i)
+	{
+		if (fences[i])
+			glDeleteSync(fences[i]);
+		fences[i] = 0;
+	}
+	glDeleteBuffers(PBO_COUNT, pbos);
+	for (unsigned int i = 0; i < PBO_COUNT; ++i)
+		pboSizes[i] = 0;
+	glDeleteTextures(1, &fallback);
+}
+
+TextureLoader::Handle TextureLoader::load(const std::string& path, const TextureProcessor::Options& options)
+{
+	Request request;
+	request.Path = path;
+	request.Settings = options;
+	request.Target = std::make_shared<Texture>();
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		requests.push_back(request);
+	}
+	wake.notify_one();
+	return request.Target;
+}
+
+void TextureLoader::workerLoop()
+{
+	for (;;)
+	{
+		Request request;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this] { return !running || !requests.empty(); });
+			if (!running)
+				return;
+			request = requests.front();
+			requests.pop_front();
+		}
+
+		// processed textures are looked up in the asset pack first, then in the texture cache,
+		// and only decoded and encoded when neither has them
+		Decoded image;
+		char section[32];
+		snprintf(section, sizeof(section), "texture/%016llx", TextureProcessor::SourceKey(request.Path, request.Settings));
+		AssetPack::Section packed;
+		bool fromPack = false;
+		if (AssetPack::instance().find(section, packed))
+		{
+			PackInfo info = AssetPack::info<PackInfo>(packed);
+			image.Processed.Settings = request.Settings;
+			image.Processed.DataSize = TextureProcessor::LevelLayout(request.Settings.TextureFormat, info.Width, info.Height, image.Processed.Levels);
+			// a section that does not hold the levels it claims is a miss, the upload would read past it
+			fromPack = packed.Size == image.Processed.DataSize;
+			if (fromPack)
+			{
+				image.Processed.Data = const_cast<unsigned char*>(packed.Data);	// only ever read by the upload
+				image.Processed.Mapped = true;
+			}
+			else
+			{
+				std::cout << "ERROR::TEXTURE::PACKED_SIZE_MISMATCH " << request.Path << std::endl;
+				image.Processed = TextureProcessor::Image();
+			}
+		}
+
+		if (!fromPack)
+		{
+			if (!TextureProcessor::LoadCache(request.Path, request.Settings, image.Processed))
+			{
+				int width, height, channels;
+				unsigned char* pixels = stbi_load(request.Path.c_str(), &width, &height, &channels, 4);
+				if (pixels == nullptr)
+				{
+					std::cout << "ERROR::TEXTURE::FILE_NOT_SUCCESFULLY_READ " << request.Path << " (" << stbi_failure_reason() << ")" << std::endl;
+					request.Target->Status = Texture::FAILED;
+					continue;
+				}
+
+				TextureProcessor::Process(pixels, width, height, request.Settings, image.Processed);
+				stbi_image_free(pixels);
+				TextureProcessor::StoreCache(request.Path, image.Processed);
+			}
+
+			PackInfo info;
+			info.Width = image.Processed.Levels[0].Width;
+			info.Height = image.Processed.Levels[0].Height;
+			AssetPack::instance().add(section, image.Processed.Data, image.Processed.DataSize, &info, sizeof(info));
+		}
+
+		image.Source = request;
+		std::lock_guard<std::mutex> lock(mutex);
+		decoded.push_back(image);
+	}
+}
+
+unsigned int TextureLoader::update(double budgetMs)
+{
+	double deadline = glfwGetTime() + budgetMs / 1000.0;
+	unsigned int completed = 0;
+
+	// at least one band goes up every frame, however small the budget
+	do
+	{
+		Decoded* image;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (decoded.empty())
+				break;
+			image = &decoded.front();	// only this thread pops, the reference stays valid
+		}
+
+		if (!uploadBand(*image))
+			break;
+
+		if (image->NextLevel >= image->Processed.Levels.size())
+		{
+			Handle target = image->Source.Target;
+			TextureProcessor::Release(image->Processed);
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				decoded.pop_front();
+			}
+
+			target->Status = Texture::READY;
+			completed++;
+		}
+	} while (glfwGetTime() < deadline);
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	return completed;
+}
+
+bool TextureLoader::uploadBand(Decoded& image)
+{
+	Texture& target = *image.Source.Target;
+	const TextureProcessor::Image& processed = image.Processed;
+	const TextureProcessor::Options& settings = processed.Settings;
+	bool compressed = TextureProcessor::IsCompressed(settings.TextureFormat);
+	GLenum internalFormat = TextureProcessor::InternalFormat(settings);
+
+	// skip the frame rather than stall on a PBO the driver is still reading
+	GLsync& fence = fences[nextPbo];
+	if (fence)
+	{
+		GLenum wait = glClientWaitSync(fence, 0, 0);
+		if (wait != GL_ALREADY_SIGNALED && wait != GL_CONDITION_SATISFIED)
+			return false;
+		glDeleteSync(fence);
+		fence = 0;
+	}
+
+	if (image.NextLevel == 0 && image.NextRow == 0)
+	{
+		glGenTextures(1, &target.ID);
+		glBindTexture(GL_TEXTURE_2D, target.ID);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexStorage2D(GL_TEXTURE_2D, (GLsizei)processed.Levels.size(), internalFormat, processed.Levels[0].Width, processed.Levels[0].Height);
+		target.Width = processed.Levels[0].Width;
+		target.Height = processed.Levels[0].Height;
+	}
+
+	// Levels are stored back to back, so a band is one contiguous range of the image even
+	// when it spans the tail of one level and the small levels after it. Compressed levels
+	// are cut at block rows.
+	struct Piece
+	{
+		size_t Level;
+		int Row;
+		int Rows;
+		size_t Offset;	// into the band
+		size_t Size;
+	};
+	Piece pieces[32];
+	unsigned int pieceCount = 0;
+
+	int rowsPerUnit = compressed ? 4 : 1;
+	auto unitBytesOf = [&](const TextureProcessor::Level& level)
+	{
+		return compressed ? (size_t)((level.Width + 3) / 4) * TextureProcessor::BlockBytes(settings.TextureFormat) : (size_t)level.Width * 4;
+	};
+
+	// a band can start part way down a level, after the rows of the bands before it
+	const TextureProcessor::Level& firstLevel = processed.Levels[image.NextLevel];
+	size_t bandStart = firstLevel.Offset + (size_t)(image.NextRow / rowsPerUnit) * unitBytesOf(firstLevel);
+	size_t bandBytes = 0;
+	while (image.NextLevel < processed.Levels.size() && pieceCount < 32)
+	{
+		const TextureProcessor::Level& level = processed.Levels[image.NextLevel];
+		size_t unitBytes = unitBytesOf(level);
+		int unitsLeft = (level.Height - image.NextRow + rowsPerUnit - 1) / rowsPerUnit;
+
+		size_t room = (bandBytes < BAND_BYTES) ? BAND_BYTES - bandBytes : 0;
+		int units = std::min(unitsLeft, (int)(room / unitBytes));
+		if (units == 0)
+		{
+			// always make progress, even with a row larger than the band
+			if (pieceCount > 0)
+				break;
+			units = 1;
+		}
+
+		Piece& piece = pieces[pieceCount++];
+		piece.Level = image.NextLevel;
+		piece.Row = image.NextRow;
+		piece.Rows = std::min(units * rowsPerUnit, level.Height - image.NextRow);
+		piece.Offset = bandBytes;
+		piece.Size = unitBytes * units;
+		bandBytes += piece.Size;
+
+		image.NextRow += piece.Rows;
+		if (image.NextRow >= level.Height)
+		{
+			image.NextLevel++;
+			image.NextRow = 0;
+		}
+	}
+
+	// the fence above guarantees the driver is done with this PBO, so the map does not need to sync
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos[nextPbo]);
+	if (pboSizes[nextPbo] < bandBytes)
+	{
+		pboSizes[nextPbo] = std::max(bandBytes, BAND_BYTES);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, pboSizes[nextPbo], NULL, GL_STREAM_DRAW);
+	}
+	void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bandBytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if (mapped == nullptr)
+	{
+		// rewind so the band is tried again
+		image.NextLevel = pieces[0].Level;
+		image.NextRow = pieces[0].Row;
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		return false;
+	}
+	memcpy(mapped, processed.Data + bandStart, bandBytes);
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+	glBindTexture(GL_TEXTURE_2D, target.ID);
+	for (unsigned int i = 0; i < pieceCount; ++i)
+	{
+		const Piece& piece = pieces[i];
+		const TextureProcessor::Level& level = processed.Levels[piece.Level];
+		if (compressed)
+			glCompressedTexSubImage2D(GL_TEXTURE_2D, (GLint)piece.Level, 0, piece.Row, level.Width, piece.Rows, internalFormat, (GLsizei)piece.Size, (GLvoid*)piece.Offset);
+		else
+			glTexSubImage2D(GL_TEXTURE_2D, (GLint)piece.Level, 0, piece.Row, level.Width, piece.Rows, GL_RGBA, GL_UNSIGNED_BYTE, (GLvoid*)piece.Offset);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	nextPbo = (nextPbo + 1) % PBO_COUNT;
+	return true;
+}
+
+void TextureLoader::bind(const Handle& texture, unsigned int unit) const
+{
+	glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(GL_TEXTURE_2D, (texture && texture->isReady()) ? texture->ID : fallback);
+}
+
+size_t TextureLoader::pendingCount() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return requests.size() + decoded.size();
+}
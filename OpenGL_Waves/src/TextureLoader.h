@@ -0,0 +1,157 @@
+#pragma once
+
+#ifndef TEXTURELOADER_H
+#define TEXTURELOADER_H
+
+#include "GL_Util.h"
+#include "TextureProcessor.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Size-bucketed free lists for decode and staging memory. stb_image allocates through
+// this pool (see TextureLoader.cpp), so decoding a stream of images of similar size stops
+// hitting the heap once the buckets are warm. Thread safe.
+class StagingPool
+{
+public:
+	static StagingPool& instance();
+
+	void* allocate(size_t size);
+	void* reallocate(void* p, size_t newSize);
+	void release(void* p);
+
+	// bytes currently held in the free lists
+	size_t cachedBytes() const;
+
+	// drops every cached block
+	void trim();
+
+private:
+	// power of two buckets from 4 KB to 64 MB, larger blocks go straight to the heap
+	static const unsigned int MIN_BUCKET_SHIFT = 12;
+	static const unsigned int BUCKET_COUNT = 15;
+	static const size_t MAX_CACHED_BYTES = 256u << 20;
+
+	mutable std::mutex mutex;
+	std::vector<void*> buckets[BUCKET_COUNT];
+	size_t cached = 0;
+
+	StagingPool() {}
+	~StagingPool();
+
+	static unsigned int bucketFor(size_t size);
+};
+
+// Loads image files without blocking the frame: a pool of workers decodes them with
+// stb_image and runs them through TextureProcessor (mip chain + block compression, or a
+// hit in its disk cache), and update() uploads the levels through pixel buffer objects in
+// bands of rows until the per-frame time budget is used up.
+class TextureLoader
+{
+public:
+	struct Texture
+	{
+		enum State { LOADING, READY, FAILED };
+
+		GLuint ID = 0;
+		int Width = 0;
+		int Height = 0;
+		std::atomic<int> Status;
+
+		Texture() : Status(LOADING) {}
+
+		// the last handle has to be dropped on the render thread
+		~Texture()
+		{
+			if (ID != 0)
+				glDeleteTextures(1, &ID);
+		}
+
+		bool isReady() const { return Status == READY; }
+	};
+
+	typedef std::shared_ptr<Texture> Handle;
+
+	TextureLoader() {}
+	~TextureLoader();
+
+	///<summary>
+	/// Creates the PBO ring and the fallback texture and starts the decode workers.
+	/// Must be called with the GL context current. workerCount 0 picks one per spare core.
+	///</summary>
+	void init(unsigned int workerCount = 0);
+
+	void shutdown();
+
+	///<summary>
+	/// Queues a file, the returned texture becomes READY after its last band was uploaded.
+	/// options picks the GPU format and mip filter, the default is sRGB BC1.
+	///</summary>
+	Handle load(const std::string& path, const TextureProcessor::Options& options = TextureProcessor::Options());
+
+	///<summary>
+	/// Uploads decoded images until budgetMs has passed. Call once per frame on the render
+	/// thread. Returns the number of textures that became ready.
+	///</summary>
+	unsigned int update(double budgetMs = 2.0);
+
+	// binds the texture, or the 1x1 fallback while it is still loading
+	void bind(const Handle& texture, unsigned int unit) const;
+
+	size_t pendingCount() const;
+
+private:
+	struct Request
+	{
+		std::string Path;
+		TextureProcessor::Options Settings;
+		Handle Target;
+	};
+
+	struct Decoded
+	{
+		Request Source;
+		TextureProcessor::Image Processed;
+		size_t NextLevel = 0;				// first level not fully uploaded yet
+		int NextRow = 0;					// first texel row of NextLevel not uploaded yet
+	};
+
+	// AssetPack info block of a texture section, the level table follows from the size
+	struct PackInfo
+	{
+		int Width;
+		int Height;
+	};
+
+	// PBOs in the ring are reused round robin; a fence guards each against overwriting a
+	// buffer the driver is still reading from
+	static const unsigned int PBO_COUNT = 4;
+	static const size_t BAND_BYTES = 1u << 20;
+
+	GLuint pbos[PBO_COUNT] = {};
+	size_t pboSizes[PBO_COUNT] = {};
+	GLsync fences[PBO_COUNT] = {};
+	unsigned int nextPbo = 0;
+	GLuint fallback = 0;
+
+	std::vector<std::thread> workers;
+	mutable std::mutex mutex;
+	std::condition_variable wake;
+	std::deque<Request> requests;
+	std::deque<Decoded> decoded;
+	bool running = false;
+
+	// the loader owns threads and GL objects
+	TextureLoader(const TextureLoader&);
+	TextureLoader& operator=(const TextureLoader&);
+
+	void workerLoop();
+	bool uploadBand(Decoded& image);
+};
+
+#endif // TEXTURELOADER_H
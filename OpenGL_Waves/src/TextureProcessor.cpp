@@ -0,0 +1,609 @@
+#include "TextureProcessor.h"
+#include "TextureLoader.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include <emmintrin.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+namespace
+{
+	const float PI = 3.14159265358979f;
+
+	// sRGB <-> linear conversion tables, the reverse table is indexed by linear * 4095
+	struct ColorTables
+	{
+		float SRGBToLinear[256];
+		float UnormToFloat[256];
+		unsigned char LinearToSRGB[4096];
+
+		ColorTables()
+		{
+			for (int i = 0; i < 256; ++i)
+			{
+				float c = i / 255.0f;
+				SRGBToLinear[i] = (c <= 0.04045f) ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+				UnormToFloat[i] = c;
+			}
+			for (int i = 0; i < 4096; ++i)
+			{
+				float l = i / 4095.0f;
+				float c = (l <= 0.0031308f) ? l * 12.92f : 1.055f * powf(l, 1.0f / 2.4f) - 0.055f;
+				LinearToSRGB[i] = (unsigned char)(glm::clamp(c, 0.0f, 1.0f) * 255.0f + 0.5f);
+			}
+		}
+	};
+
+	const ColorTables& Tables()
+	{
+		static ColorTables tables;
+		return tables;
+	}
+
+	inline __m128 LoadTexel(const unsigned char* p, const float* colorTable)
+	{
+		return _mm_set_ps(p[3] * (1.0f / 255.0f), colorTable[p[2]], colorTable[p[1]], colorTable[p[0]]);
+	}
+
+	inline void StoreTexel(__m128 v, unsigned char* p, bool srgb)
+	{
+		v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+
+		float f[4];
+		_mm_storeu_ps(f, v);
+		for (int c = 0; c < 3; ++c)
+			p[c] = srgb ? Tables().LinearToSRGB[(int)(f[c] * 4095.0f + 0.5f)] : (unsigned char)(f[c] * 255.0f + 0.5f);
+		p[3] = (unsigned char)(f[3] * 255.0f + 0.5f);
+	}
+
+	// 6 tap windowed sinc for a 2:1 reduction, the taps sit at 2x-2 .. 2x+3
+	struct KaiserKernel
+	{
+		static const int TAPS = 6;
+		static const int FIRST = -2;
+		float Weights[TAPS];
+
+		KaiserKernel()
+		{
+			const float alpha = 4.0f;
+			const float radius = 3.0f;
+			float sum = 0.0f;
+			for (int k = 0; k < TAPS; ++k)
+			{
+				// distance from the destination texel centre, in source texels
+				float d = (FIRST + k) - 0.5f;
+				float x = d * 0.5f;
+				float sinc = (x == 0.0f) ? 1.0f : sinf(PI * x) / (PI * x);
+				float t = d / radius;
+				float window = besselI0(alpha * sqrtf(glm::max(0.0f, 1.0f - t * t))) / besselI0(alpha);
+				Weights[k] = sinc * window;
+				sum += Weights[k];
+			}
+			for (int k = 0; k < TAPS; ++k)
+				Weights[k] /= sum;
+		}
+
+		static float besselI0(float x)
+		{
+			float sum = 1.0f, term = 1.0f;
+			for (int k = 1; k < 20; ++k)
+			{
+				term *= (x / (2.0f * k)) * (x / (2.0f * k));
+				sum += term;
+			}
+			return sum;
+		}
+	};
+
+	const KaiserKernel& Kaiser()
+	{
+		static KaiserKernel kernel;
+		return kernel;
+	}
+
+	inline unsigned short Pack565(const int c[3])
+	{
+		return (unsigned short)(((c[0] * 31 + 127) / 255) << 11 | ((c[1] * 63 + 127) / 255) << 5 | ((c[2] * 31 + 127) / 255));
+	}
+
+	inline void Unpack565(unsigned short v, int c[3])
+	{
+		int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+		c[0] = (r << 3) | (r >> 2);
+		c[1] = (g << 2) | (g >> 4);
+		c[2] = (b << 3) | (b >> 2);
+	}
+
+	// gathers a 4x4 block, repeating the last row/column at the edges of small levels
+	inline void GatherBlock(const unsigned char* rgba, int width, int height, int bx, int by, unsigned char texels[64])
+	{
+		for (int y = 0; y < 4; ++y)
+		{
+			int sy = glm::min(by * 4 + y, height - 1);
+			for (int x = 0; x < 4; ++x)
+			{
+				int sx = glm::min(bx * 4 + x, width - 1);
+				memcpy(texels + (y * 4 + x) * 4, rgba + ((size_t)sy * width + sx) * 4, 4);
+			}
+		}
+	}
+
+	void EncodeLevel(const unsigned char* rgba, int width, int height, TextureProcessor::Format format, unsigned char* out)
+	{
+		if (format == TextureProcessor::FORMAT_RGBA8)
+		{
+			memcpy(out, rgba, (size_t)width * height * 4);
+			return;
+		}
+
+		int blocksWide = (width + 3) / 4;
+		int blocksHigh = (height + 3) / 4;
+		unsigned int blockBytes = TextureProcessor::BlockBytes(format);
+
+		// blocks are independent, rows of blocks are spread over the cores
+		JobSystem::instance().parallelFor(blocksHigh, 8, [&](size_t begin, size_t end)
+		{
+			unsigned char texels[64];
+			for (size_t by = begin; by < end; ++by)
+			{
+				for (int bx = 0; bx < blocksWide; ++bx)
+				{
+					GatherBlock(rgba, width, height, bx, (int)by, texels);
+					unsigned char* block = out + (by * blocksWide + bx) * blockBytes;
+					if (format == TextureProcessor::FORMAT_BC1)
+						TextureProcessor::EncodeBC1(texels, block);
+					else if (format == TextureProcessor::FORMAT_BC3)
+						TextureProcessor::EncodeBC3(texels, block);
+					else
+						TextureProcessor::EncodeBC5(texels, block);
+				}
+			}
+		});
+	}
+
+	struct CacheHeader
+	{
+		unsigned int Magic;
+		unsigned int Version;
+		unsigned long long Key;
+		int TextureFormat;
+		int Filter;
+		int SRGB;
+		unsigned int LevelCount;
+		unsigned long long DataSize;
+	};
+
+	struct CacheLevel
+	{
+		int Width;
+		int Height;
+		unsigned long long Offset;
+		unsigned long long Size;
+	};
+
+	const unsigned int CACHE_MAGIC = 0x54574F47;	// "GOWT"
+	const unsigned int CACHE_VERSION = 1;
+	const char* CACHE_DIRECTORY = "texturecache";
+
+	std::string CachePath(unsigned long long key)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.tex", key);
+		return std::string(CACHE_DIRECTORY) + "/" + name;
+	}
+}
+
+void TextureProcessor::Process(const unsigned char* rgba, int width, int height, const Options& options, Image& out)
+{
+	out.Settings = options;
+	bool srgb = options.SRGB && options.TextureFormat != FORMAT_BC5;
+
+	// level layout first, so all levels land in one block
+	size_t total = LevelLayout(options.TextureFormat, width, height, out.Levels);
+	out.DataSize = total;
+	out.Data = static_cast<unsigned char*>(StagingPool::instance().allocate(total));
+
+	// only the previous level is kept around while walking down the chain
+	const unsigned char* current = rgba;
+	unsigned char* owned = nullptr;
+	for (size_t l = 0; l < out.Levels.size(); ++l)
+	{
+		const Level& level = out.Levels[l];
+		if (l > 0)
+		{
+			const Level& parent = out.Levels[l - 1];
+			unsigned char* next = static_cast<unsigned char*>(StagingPool::instance().allocate((size_t)level.Width * level.Height * 4));
+			Downsample(current, parent.Width, parent.Height, next, srgb, options.Filter);
+			StagingPool::instance().release(owned);
+			current = owned = next;
+		}
+		EncodeLevel(current, level.Width, level.Height, options.TextureFormat, out.Data + level.Offset);
+	}
+	StagingPool::instance().release(owned);
+}
+
+void TextureProcessor::Release(Image& image)
+{
+	if (!image.Mapped)
+		StagingPool::instance().release(image.Data);
+	image.Data = nullptr;
+	image.DataSize = 0;
+	image.Levels.clear();
+}
+
+void TextureProcessor::Downsample(const unsigned char* src, int width, int height, unsigned char* dst, bool srgb, MipFilter filter)
+{
+	int dstWidth = glm::max(1, width / 2);
+	int dstHeight = glm::max(1, height / 2);
+	const float* colorTable = srgb ? Tables().SRGBToLinear : Tables().UnormToFloat;
+
+	if (filter == FILTER_BOX)
+	{
+		const __m128 quarter = _mm_set1_ps(0.25f);
+		JobSystem::instance().parallelFor(dstHeight, 32, [&](size_t begin, size_t end)
+		{
+			for (size_t y = begin; y < end; ++y)
+			{
+				const unsigned char* row0 = src + (size_t)glm::min(2 * (int)y, height - 1) * width * 4;
+				const unsigned char* row1 = src + (size_t)glm::min(2 * (int)y + 1, height - 1) * width * 4;
+				unsigned char* out = dst + y * dstWidth * 4;
+				for (int x = 0; x < dstWidth; ++x)
+				{
+					int x0 = glm::min(2 * x, width - 1) * 4;
+					int x1 = glm::min(2 * x + 1, width - 1) * 4;
+					__m128 sum = _mm_add_ps(_mm_add_ps(LoadTexel(row0 + x0, colorTable), LoadTexel(row0 + x1, colorTable)),
+						_mm_add_ps(LoadTexel(row1 + x0, colorTable), LoadTexel(row1 + x1, colorTable)));
+					StoreTexel(_mm_mul_ps(sum, quarter), out + x * 4, srgb);
+				}
+			}
+		});
+		return;
+	}
+
+	// separable Kaiser: horizontal into a linear float image, then vertical into dst
+	const KaiserKernel& kernel = Kaiser();
+	std::vector<float> horizontal((size_t)dstWidth * height * 4);
+
+	JobSystem::instance().parallelFor(height, 32, [&](size_t begin, size_t end)
+	{
+		for (size_t y = begin; y < end; ++y)
+		{
+			const unsigned char* row = src + y * width * 4;
+			float* out = &horizontal[y * dstWidth * 4];
+			for (int x = 0; x < dstWidth; ++x)
+			{
+				__m128 sum = _mm_setzero_ps();
+				for (int k = 0; k < KaiserKernel::TAPS; ++k)
+				{
+					int sx = glm::clamp(2 * x + KaiserKernel::FIRST + k, 0, width - 1);
+					sum = _mm_add_ps(sum, _mm_mul_ps(LoadTexel(row + sx * 4, colorTable), _mm_set1_ps(kernel.Weights[k])));
+				}
+				_mm_storeu_ps(out + x * 4, sum);
+			}
+		}
+	});
+
+	JobSystem::instance().parallelFor(dstHeight, 32, [&](size_t begin, size_t end)
+	{
+		for (size_t y = begin; y < end; ++y)
+		{
+			unsigned char* out = dst + y * dstWidth * 4;
+			for (int x = 0; x < dstWidth; ++x)
+			{
+				__m128 sum = _mm_setzero_ps();
+				for (int k = 0; k < KaiserKernel::TAPS; ++k)
+				{
+					int sy = glm::clamp(2 * (int)y + KaiserKernel::FIRST + k, 0, height - 1);
+					sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(&horizontal[((size_t)sy * dstWidth + x) * 4]), _mm_set1_ps(kernel.Weights[k])));
+				}
+				StoreTexel(sum, out + x * 4, srgb);
+			}
+		}
+	});
+}
+
+void TextureProcessor::EncodeBC1(const unsigned char texels[64], unsigned char out[8])
+{
+	int lo[3] = { 255, 255, 255 }, hi[3] = { 0, 0, 0 };
+	int mean[3] = { 0, 0, 0 };
+	for (int i = 0; i < 16; ++i)
+	{
+		for (int c = 0; c < 3; ++c)
+		{
+			int v = texels[i * 4 + c];
+			lo[c] = glm::min(lo[c], v);
+			hi[c] = glm::max(hi[c], v);
+			mean[c] += v;
+		}
+	}
+	for (int c = 0; c < 3; ++c)
+		mean[c] = (mean[c] + 8) / 16;
+
+	// the bounding box diagonal is flipped per channel to follow the covariance with the
+	// widest channel, which approximates the principal axis for most blocks
+	int axis = 0;
+	for (int c = 1; c < 3; ++c)
+	{
+		if (hi[c] - lo[c] > hi[axis] - lo[axis])
+			axis = c;
+	}
+	int e0[3], e1[3];
+	for (int c = 0; c < 3; ++c)
+	{
+		int covariance = 0;
+		for (int i = 0; i < 16; ++i)
+			covariance += (texels[i * 4 + axis] - mean[axis]) * (texels[i * 4 + c] - mean[c]);
+
+		// pull the endpoints in a little, the extremes are rarely worth a palette entry
+		int inset = (hi[c] - lo[c]) >> 4;
+		int a = glm::min(255, lo[c] + inset), b = glm::max(0, hi[c] - inset);
+		e0[c] = (covariance >= 0) ? b : a;
+		e1[c] = (covariance >= 0) ? a : b;
+	}
+
+	unsigned short c0 = Pack565(e0);
+	unsigned short c1 = Pack565(e1);
+	if (c0 < c1)
+		std::swap(c0, c1);
+
+	out[0] = c0 & 0xFF;
+	out[1] = c0 >> 8;
+	out[2] = c1 & 0xFF;
+	out[3] = c1 >> 8;
+
+	unsigned int indices = 0;
+	if (c0 != c1)
+	{
+		// c0 > c1 selects the four colour palette
+		int palette[4][3];
+		Unpack565(c0, palette[0]);
+		Unpack565(c1, palette[1]);
+		for (int c = 0; c < 3; ++c)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+
+		for (int i = 0; i < 16; ++i)
+		{
+			int best = 0, bestError = INT_MAX;
+			for (int p = 0; p < 4; ++p)
+			{
+				int dr = texels[i * 4] - palette[p][0];
+				int dg = texels[i * 4 + 1] - palette[p][1];
+				int db = texels[i * 4 + 2] - palette[p][2];
+				int error = dr * dr + dg * dg + db * db;
+				if (error < bestError)
+				{
+					bestError = error;
+					best = p;
+				}
+			}
+			indices |= (unsigned int)best << (2 * i);
+		}
+	}
+
+	out[4] = indices & 0xFF;
+	out[5] = (indices >> 8) & 0xFF;
+	out[6] = (indices >> 16) & 0xFF;
+	out[7] = (indices >> 24) & 0xFF;
+}
+
+void TextureProcessor::EncodeBC4(const unsigned char texels[64], int channel, unsigned char out[8])
+{
+	int lo = 255, hi = 0;
+	for (int i = 0; i < 16; ++i)
+	{
+		lo = glm::min(lo, (int)texels[i * 4 + channel]);
+		hi = glm::max(hi, (int)texels[i * 4 + channel]);
+	}
+
+	// hi > lo selects the eight value ramp: 0 = hi, 1 = lo, 2..7 step from hi towards lo
+	out[0] = (unsigned char)hi;
+	out[1] = (unsigned char)lo;
+
+	unsigned long long indices = 0;
+	if (hi > lo)
+	{
+		int range = hi - lo;
+		for (int i = 0; i < 16; ++i)
+		{
+			int step = ((hi - texels[i * 4 + channel]) * 7 + range / 2) / range;
+			unsigned long long index = (step == 0) ? 0 : (step == 7) ? 1 : step + 1;
+			indices |= index << (3 * i);
+		}
+	}
+
+	for (int b = 0; b < 6; ++b)
+		out[2 + b] = (unsigned char)((indices >> (8 * b)) & 0xFF);
+}
+
+void TextureProcessor::EncodeBC3(const unsigned char texels[64], unsigned char out[16])
+{
+	EncodeBC4(texels, 3, out);
+	EncodeBC1(texels, out + 8);
+}
+
+void TextureProcessor::EncodeBC5(const unsigned char texels[64], unsigned char out[16])
+{
+	EncodeBC4(texels, 0, out);
+	EncodeBC4(texels, 1, out + 8);
+}
+
+unsigned int TextureProcessor::BlockBytes(Format format)
+{
+	return (format == FORMAT_BC1) ? 8 : 16;
+}
+
+size_t TextureProcessor::LevelSize(Format format, int width, int height)
+{
+	if (!IsCompressed(format))
+		return (size_t)width * height * 4;
+	return (size_t)glm::max(1, (width + 3) / 4) * glm::max(1, (height + 3) / 4) * BlockBytes(format);
+}
+
+size_t TextureProcessor::LevelLayout(Format format, int width, int height, std::vector<Level>& levels)
+{
+	levels.clear();
+	size_t total = 0;
+	for (int w = width, h = height;; w = glm::max(1, w / 2), h = glm::max(1, h / 2))
+	{
+		Level level;
+		level.Width = w;
+		level.Height = h;
+		level.Offset = total;
+		level.Size = LevelSize(format, w, h);
+		levels.push_back(level);
+		total += level.Size;
+		if (w == 1 && h == 1)
+			break;
+	}
+	return total;
+}
+
+GLenum TextureProcessor::InternalFormat(const Options& options)
+{
+	switch (options.TextureFormat)
+	{
+	case FORMAT_BC1:
+		return options.SRGB ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	case FORMAT_BC3:
+		return options.SRGB ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	case FORMAT_BC5:
+		return GL_COMPRESSED_RG_RGTC2;
+	default:
+		return options.SRGB ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+	}
+}
+
+bool TextureProcessor::LoadCache(const std::string& path, const Options& options, Image& out)
+{
+	unsigned long long key = SourceKey(path, options);
+	std::ifstream file(CachePath(key).c_str(), std::ios::binary);
+	if (!file)
+		return false;
+
+	CacheHeader header;
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!file || header.Magic != CACHE_MAGIC || header.Version != CACHE_VERSION || header.Key != key)
+		return false;
+
+	// a full chain of a 2^31 texture has 32 levels, anything longer is not a cache file of ours
+	if (header.LevelCount == 0 || header.LevelCount > 32)
+		return false;
+
+	std::vector<CacheLevel> levels(header.LevelCount);
+	file.read(reinterpret_cast<char*>(levels.data()), sizeof(CacheLevel) * levels.size());
+	if (!file || levels[0].Width < 1 || levels[0].Height < 1)
+		return false;
+
+	// a truncated or stale file is a miss: the levels must be the layout of the top level
+	// exactly, and the file must hold all of their data
+	std::vector<Level> layout;
+	size_t layoutSize = LevelLayout(options.TextureFormat, levels[0].Width, levels[0].Height, layout);
+	if (layout.size() != levels.size() || layoutSize != header.DataSize)
+		return false;
+	for (size_t i = 0; i < levels.size(); ++i)
+	{
+		if (levels[i].Width != layout[i].Width || levels[i].Height != layout[i].Height
+			|| levels[i].Offset != layout[i].Offset || levels[i].Size != layout[i].Size)
+			return false;
+	}
+	std::streamoff dataStart = file.tellg();
+	file.seekg(0, std::ios::end);
+	if (file.tellg() - dataStart < (std::streamoff)header.DataSize)
+		return false;
+	file.seekg(dataStart);
+
+	out.Settings = options;
+	out.DataSize = layoutSize;
+	out.Data = static_cast<unsigned char*>(StagingPool::instance().allocate(out.DataSize));
+	file.read(reinterpret_cast<char*>(out.Data), out.DataSize);
+	if (!file)
+	{
+		Release(out);
+		return false;
+	}
+
+	out.Levels.swap(layout);
+	return true;
+}
+
+void TextureProcessor::StoreCache(const std::string& path, const Image& image)
+{
+	unsigned long long key = SourceKey(path, image.Settings);
+
+#ifdef _WIN32
+	_mkdir(CACHE_DIRECTORY);
+#else
+	mkdir(CACHE_DIRECTORY, 0755);
+#endif
+
+	std::ofstream file(CachePath(key).c_str(), std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		std::cout << "ERROR::TEXTURE_CACHE::FILE_NOT_SUCCESFULLY_WRITTEN " << CachePath(key) << std::endl;
+		return;
+	}
+
+	CacheHeader header;
+	header.Magic = CACHE_MAGIC;
+	header.Version = CACHE_VERSION;
+	header.Key = key;
+	header.TextureFormat = (int)image.Settings.TextureFormat;
+	header.Filter = (int)image.Settings.Filter;
+	header.SRGB = image.Settings.SRGB ? 1 : 0;
+	header.LevelCount = (unsigned int)image.Levels.size();
+	header.DataSize = image.DataSize;
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	for (size_t i = 0; i < image.Levels.size(); ++i)
+	{
+		CacheLevel level;
+		level.Width = image.Levels[i].Width;
+		level.Height = image.Levels[i].Height;
+		level.Offset = image.Levels[i].Offset;
+		level.Size = image.Levels[i].Size;
+		file.write(reinterpret_cast<const char*>(&level), sizeof(level));
+	}
+	file.write(reinterpret_cast<const char*>(image.Data), image.DataSize);
+}
+
+unsigned long long TextureProcessor::SourceKey(const std::string& path, const Options& options)
+{
+	struct stat info;
+	long long fileSize = -1, fileTime = -1;
+	if (stat(path.c_str(), &info) == 0)
+	{
+		fileSize = (long long)info.st_size;
+		fileTime = (long long)info.st_mtime;
+	}
+
+	unsigned long long hash = 14695981039346656037ULL;
+	auto mix = [&hash](const void* data, size_t size)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; ++i)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ULL;
+		}
+	};
+	int settings[3] = { (int)options.TextureFormat, (int)options.Filter, options.SRGB ? 1 : 0 };
+	mix(path.data(), path.size());
+	mix(&fileSize, sizeof(fileSize));
+	mix(&fileTime, sizeof(fileTime));
+	mix(settings, sizeof(settings));
+	mix(&CACHE_VERSION, sizeof(CACHE_VERSION));
+	return hash;
+}
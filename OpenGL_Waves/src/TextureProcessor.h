@@ -0,0 +1,107 @@
+#pragma once
+
+#ifndef TEXTUREPROCESSOR_H
+#define TEXTUREPROCESSOR_H
+
+#include "GL_Util.h"
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+// Offline style texture preparation done at load time: a full mip chain built on the CPU
+// (gamma correct for sRGB data) and block compression, so the GPU gets 4-8x less data
+// than uncompressed RGBA8. Results can be cached on disk next to the shader cache.
+class TextureProcessor
+{
+public:
+	enum Format
+	{
+		FORMAT_RGBA8,	// uncompressed, 4 bytes per texel
+		FORMAT_BC1,		// opaque colour, 0.5 bytes per texel
+		FORMAT_BC3,		// colour + alpha, 1 byte per texel
+		FORMAT_BC5		// two channels (tangent space normals), 1 byte per texel
+	};
+
+	enum MipFilter
+	{
+		FILTER_BOX,		// 2x2 average
+		FILTER_KAISER	// windowed sinc over 6 taps, sharper distant mips
+	};
+
+	struct Options
+	{
+		Format TextureFormat = FORMAT_BC1;
+		MipFilter Filter = FILTER_BOX;
+		bool SRGB = true;	// colour data, filtered in linear space; ignored for BC5
+	};
+
+	struct Level
+	{
+		int Width = 0;
+		int Height = 0;
+		size_t Offset = 0;	// into Image::Data
+		size_t Size = 0;
+	};
+
+	// every level of a processed texture in one StagingPool block
+	struct Image
+	{
+		Options Settings;
+		std::vector<Level> Levels;
+		unsigned char* Data = nullptr;
+		size_t DataSize = 0;
+		bool Mapped = false;	// Data points into the AssetPack and is not released
+	};
+
+	///<summary>
+	/// Builds the mip chain of an RGBA8 image and encodes every level. out.Data comes from
+	/// StagingPool and has to be returned with Release().
+	///</summary>
+	static void Process(const unsigned char* rgba, int width, int height, const Options& options, Image& out);
+
+	static void Release(Image& image);
+
+	///<summary>
+	/// Halves an RGBA8 image (rounding odd sizes down, never below 1). sRGB colour is
+	/// converted to linear before filtering, alpha is always linear.
+	///</summary>
+	static void Downsample(const unsigned char* src, int width, int height, unsigned char* dst, bool srgb, MipFilter filter);
+
+	// single 4x4 blocks, texels are RGBA8 in row order
+	static void EncodeBC1(const unsigned char texels[64], unsigned char out[8]);
+	static void EncodeBC3(const unsigned char texels[64], unsigned char out[16]);
+	static void EncodeBC5(const unsigned char texels[64], unsigned char out[16]);
+
+	// channel is 0..3, 8 byte BC4 block
+	static void EncodeBC4(const unsigned char texels[64], int channel, unsigned char out[8]);
+
+	static size_t LevelSize(Format format, int width, int height);
+
+	// fills in the level table of a full chain, returns the total size
+	static size_t LevelLayout(Format format, int width, int height, std::vector<Level>& levels);
+	static unsigned int BlockBytes(Format format);
+	static bool IsCompressed(Format format) { return format != FORMAT_RGBA8; }
+	static GLenum InternalFormat(const Options& options);
+
+	///<summary>
+	/// Disk cache in texturecache/, keyed by the file path, its size and modification time
+	/// and the options. Load returns false when there is no matching entry.
+	///</summary>
+	static bool LoadCache(const std::string& path, const Options& options, Image& out);
+	static void StoreCache(const std::string& path, const Image& image);
+
+	// the cache key, also used to name the texture's AssetPack section
+	static unsigned long long SourceKey(const std::string& path, const Options& options);
+};
+
+#endif // TEXTUREPROCESSOR_H
@@ -0,0 +1,245 @@
+#pragma once
+
+#ifndef VERTEXPACKING_H
+#define VERTEXPACKING_H
+
+#include "GL_Util.h"
+#include <glm/gtc/packing.hpp>
+
+// Compact alternatives to the 32 byte GeometryGenerator::Vertex.
+//
+//  PackedVertex (16 bytes)	- 16-bit positions (half float or UNORM16 in the mesh bounds),
+//							  octahedral 2x16-bit SNORM normal, 2x16-bit UNORM texture coordinates
+//  Height only  (2 bytes)	- UNORM16 height per grid vertex, X/Z and UV are rebuilt from gl_VertexID
+class VertexPacking
+{
+public:
+	enum PositionEncoding {
+		POSITION_HALF,		// half floats, no decode needed in the shader
+		POSITION_UNORM16	// normalised to the mesh bounds, decode with positionBias + positionScale * p
+	};
+
+	struct PackedVertex
+	{
+		GLushort Position[4];	// xyz + padding to keep the normal 4 byte aligned
+		GLshort Normal[2];
+		GLushort TexC[2];
+	};
+
+	struct PackedMeshData
+	{
+		std::vector<PackedVertex> Vertices;
+		PositionEncoding Encoding = POSITION_HALF;
+		glm::vec3 PositionBias = glm::vec3(0.0f);
+		glm::vec3 PositionScale = glm::vec3(1.0f);
+	};
+
+	struct HeightGridData
+	{
+		std::vector<GLushort> Heights;
+		int Rows = 0;		// m
+		int Columns = 0;	// n
+		float Width = 0.0f;
+		float Depth = 0.0f;
+		float MinHeight = 0.0f;
+		float MaxHeight = 0.0f;
+	};
+
+	// Octahedral normal encoding (Meyer et al.), result in [-1, 1]^2
+	// ------------------------------------------------------------------------
+	static glm::vec2 EncodeOctahedral(const glm::vec3& n)
+	{
+		glm::vec3 p = n / (fabsf(n.x) + fabsf(n.y) + fabsf(n.z));
+		glm::vec2 e(p.x, p.z);
+		if (p.y < 0.0f)
+		{
+			e = glm::vec2((1.0f - fabsf(p.z)) * signNotZero(p.x), (1.0f - fabsf(p.x)) * signNotZero(p.z));
+		}
+		return e;
+	}
+
+	static glm::vec3 DecodeOctahedral(const glm::vec2& e)
+	{
+		glm::vec3 n(e.x, 1.0f - fabsf(e.x) - fabsf(e.y), e.y);
+		if (n.y < 0.0f)
+		{
+			float x = n.x;
+			n.x = (1.0f - fabsf(n.z)) * signNotZero(x);
+			n.z = (1.0f - fabsf(x)) * signNotZero(n.z);
+		}
+		return glm::normalize(n);
+	}
+
+	// Mesh packing
+	// ------------------------------------------------------------------------
+	static void PackMesh(const GeometryGenerator::MeshData& mesh, PositionEncoding encoding, PackedMeshData& packed)
+	{
+		packed.Encoding = encoding;
+		packed.PositionBias = glm::vec3(0.0f);
+		packed.PositionScale = glm::vec3(1.0f);
+
+		if (encoding == POSITION_UNORM16 && !mesh.Vertices.empty())
+		{
+			glm::vec3 vMin = mesh.Vertices[0].Position;
+			glm::vec3 vMax = mesh.Vertices[0].Position;
+			for (size_t i = 1; i < mesh.Vertices.size(); ++i)
+			{
+				vMin = glm::min(vMin, mesh.Vertices[i].Position);
+				vMax = glm::max(vMax, mesh.Vertices[i].Position);
+			}
+			packed.PositionBias = vMin;
+			// avoid a zero scale on flat axes so decoding stays well defined
+			packed.PositionScale = glm::max(vMax - vMin, glm::vec3(1e-6f));
+		}
+
+		packed.Vertices.resize(mesh.Vertices.size());
+		for (size_t i = 0; i < mesh.Vertices.size(); ++i)
+		{
+			const GeometryGenerator::Vertex& v = mesh.Vertices[i];
+			PackedVertex& p = packed.Vertices[i];
+
+			for (int c = 0; c < 3; ++c)
+			{
+				if (encoding == POSITION_HALF)
+					p.Position[c] = glm::packHalf1x16(v.Position[c]);
+				else
+					p.Position[c] = glm::packUnorm1x16((v.Position[c] - packed.PositionBias[c]) / packed.PositionScale[c]);
+			}
+			p.Position[3] = 0;
+
+			glm::vec2 oct = EncodeOctahedral(v.Normal);
+			p.Normal[0] = (GLshort)glm::packSnorm1x16(oct.x);
+			p.Normal[1] = (GLshort)glm::packSnorm1x16(oct.y);
+
+			// texture coordinates outside [0,1] are clamped, only used by the generated primitives
+			p.TexC[0] = glm::packUnorm1x16(v.TexC.x);
+			p.TexC[1] = glm::packUnorm1x16(v.TexC.y);
+		}
+	}
+
+	static GeometryGenerator::Vertex UnpackVertex(const PackedVertex& p, const PackedMeshData& packed)
+	{
+		GeometryGenerator::Vertex v;
+		for (int c = 0; c < 3; ++c)
+		{
+			if (packed.Encoding == POSITION_HALF)
+				v.Position[c] = glm::unpackHalf1x16(p.Position[c]);
+			else
+				v.Position[c] = packed.PositionBias[c] + packed.PositionScale[c] * glm::unpackUnorm1x16(p.Position[c]);
+		}
+		v.Normal = DecodeOctahedral(glm::vec2(glm::unpackSnorm1x16((glm::uint16)p.Normal[0]), glm::unpackSnorm1x16((glm::uint16)p.Normal[1])));
+		v.TexC = glm::vec2(glm::unpackUnorm1x16(p.TexC[0]), glm::unpackUnorm1x16(p.TexC[1]));
+		return v;
+	}
+
+	// Height only grids. The grid must come from GeometryGenerator::CreateGrid so that
+	// the vertex at index i*n + j sits at row i, column j.
+	// ------------------------------------------------------------------------
+	static void PackHeightGrid(const GeometryGenerator::MeshData& grid, int m, int n, float width, float depth, HeightGridData& packed)
+	{
+		packed.Rows = m;
+		packed.Columns = n;
+		packed.Width = width;
+		packed.Depth = depth;
+		packed.MinHeight = 0.0f;
+		packed.MaxHeight = 0.0f;
+
+		if (!grid.Vertices.empty())
+		{
+			packed.MinHeight = packed.MaxHeight = grid.Vertices[0].Position.y;
+			for (size_t i = 1; i < grid.Vertices.size(); ++i)
+			{
+				packed.MinHeight = glm::min(packed.MinHeight, grid.Vertices[i].Position.y);
+				packed.MaxHeight = glm::max(packed.MaxHeight, grid.Vertices[i].Position.y);
+			}
+		}
+
+		float range = glm::max(packed.MaxHeight - packed.MinHeight, 1e-6f);
+		packed.Heights.resize(grid.Vertices.size());
+		for (size_t i = 0; i < grid.Vertices.size(); ++i)
+			packed.Heights[i] = glm::packUnorm1x16((grid.Vertices[i].Position.y - packed.MinHeight) / range);
+	}
+
+	static glm::vec3 UnpackHeightGridPosition(const HeightGridData& packed, int vertexId)
+	{
+		int row = vertexId / packed.Columns;
+		int col = vertexId % packed.Columns;
+		float range = glm::max(packed.MaxHeight - packed.MinHeight, 1e-6f);
+
+		return glm::vec3(
+			-0.5f * packed.Width + col * (packed.Width / (packed.Columns - 1)),
+			packed.MinHeight + range * glm::unpackUnorm1x16(packed.Heights[vertexId]),
+			0.5f * packed.Depth - row * (packed.Depth / (packed.Rows - 1)));
+	}
+
+	// Attribute setup, the VAO and GL_ARRAY_BUFFER must be bound
+	// ------------------------------------------------------------------------
+	static void SetupPackedAttributes(PositionEncoding encoding)
+	{
+		GLsizei stride = sizeof(PackedVertex);
+		glEnableVertexAttribArray(0);
+		if (encoding == POSITION_HALF)
+			glVertexAttribPointer(0, 3, GL_HALF_FLOAT, GL_FALSE, stride, (GLvoid*)0);
+		else
+			glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (GLvoid*)0);
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride, (GLvoid*)(4 * sizeof(GLushort)));
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride, (GLvoid*)(6 * sizeof(GLushort)));
+	}
+
+	static void SetupHeightAttribute()
+	{
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 1, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(GLushort), (GLvoid*)0);
+	}
+
+	static void SetHeightGridUniforms(const Shader& shader, const HeightGridData& packed)
+	{
+		SetHeightGridUniforms(shader, packed, glm::vec2(packed.MinHeight, packed.MaxHeight));
+	}
+
+	// for heights in the buffer packed over another range than the grid's
+	static void SetHeightGridUniforms(const Shader& shader, const HeightGridData& packed, const glm::vec2& heightRange)
+	{
+		shader.setVec2("gridSize", packed.Width, packed.Depth);
+		shader.setVec2("gridStep", packed.Width / (packed.Columns - 1), packed.Depth / (packed.Rows - 1));
+		glUniform2i(glGetUniformLocation(shader.ID, "gridDims"), packed.Columns, packed.Rows);
+		shader.setVec2("heightRange", heightRange.x, heightRange.y);
+	}
+
+	// GLSL helpers matching the CPU decode above, for shaders that need the packed normal.
+	static constexpr const char* OctahedralDecodeSource =
+		"vec3 decodeOctahedral(vec2 e)\n"
+		"{\n"
+		"	vec3 n = vec3(e.x, 1.0 - abs(e.x) - abs(e.y), e.y);\n"
+		"	if (n.y < 0.0)\n"
+		"		n.xz = (1.0 - abs(n.zx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.z >= 0.0 ? 1.0 : -1.0);\n"
+		"	return normalize(n);\n"
+		"}\n";
+
+	// Rebuilds the grid vertex from gl_VertexID, the layout matches GeometryGenerator::CreateGrid.
+	static constexpr const char* HeightGridDecodeSource =
+		"uniform ivec2 gridDims;\n"
+		"uniform vec2 gridSize;\n"
+		"uniform vec2 gridStep;\n"
+		"uniform vec2 heightRange;\n"
+		"vec3 gridPosition(float height)\n"
+		"{\n"
+		"	int col = gl_VertexID % gridDims.x;\n"
+		"	int row = gl_VertexID / gridDims.x;\n"
+		"	return vec3(-0.5 * gridSize.x + col * gridStep.x, mix(heightRange.x, heightRange.y, height), 0.5 * gridSize.y - row * gridStep.y);\n"
+		"}\n"
+		"vec2 gridTexCoord()\n"
+		"{\n"
+		"	return vec2(gl_VertexID % gridDims.x, gl_VertexID / gridDims.x) / vec2(gridDims - 1);\n"
+		"}\n";
+
+private:
+	static float signNotZero(float v)
+	{
+		return (v >= 0.0f) ? 1.0f : -1.0f;
+	}
+};
+
+#endif // VERTEXPACKING_H
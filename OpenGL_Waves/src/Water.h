@@ -4,22 +4,32 @@
 #define WATER_H
 
 #include "GL_Util.h"
+#include "ShaderHotReload.h"
+#include "FrameSnapshot.h"
+#include "WaveField.h"
+#include "RippleSolver.h"
+#include "StreamBuffer.h"
+
+#include <cstring>
 
 class Water
 {
 public:
 	Water()
 	{
-		//Setup shader program
-		Shader::ShaderCode code;
-		code.vertexCode = waveVertexShaderSource;
-		code.fragmentCode = waveFragmentShaderSource;
-		shaderProgram = Shader(code);
+		//Setup shader program (rebuilt whenever the files are saved, built in without them)
+		if (!ShaderHotReload::instance().watch(&shaderProgram, "shaders/water.vert", "shaders/water.frag"))
+		{
+			Shader::ShaderCode code;
+			code.vertexCode = fallbackVertexSource;
+			code.fragmentCode = fallbackFragmentSource;
+			shaderProgram = Shader(code);
+		}
 
 		//Create grid
 		//GeometryGenerator::MeshData grid;
 		GeometryGenerator geoGen;
-		geoGen.CreateGrid(50.0f, 50.0f, 300, 200, grid);
+		geoGen.CreateGrid(50.0f, 50.0f, 300, 200, grid, true);
 
 		// Setup water VAO
 		//GLuint waterVAO, waterVBO, waterEBO;
@@ -32,7 +42,7 @@ public:
 		glBufferData(GL_ARRAY_BUFFER, sizeof(GeometryGenerator::Vertex)*grid.Vertices.size(), grid.Vertices.data(), GL_STATIC_DRAW);
 
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, waterEBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * grid.Indices.size(), grid.Indices.data(), GL_STATIC_DRAW);
+		grid.UploadIndices();
 
 		glEnableVertexAttribArray(0);
 		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)0);
@@ -41,95 +51,143 @@ public:
 		glEnableVertexAttribArray(2);
 		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)(6 * sizeof(GLfloat)));
 		glBindVertexArray(0);
+
+		// ripple heights, rewritten every frame through a pixel buffer ring
+		glGenTextures(1, &rippleTexture);
+		glBindTexture(GL_TEXTURE_2D, rippleTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, RippleSolver::SIZE, RippleSolver::SIZE, 0, GL_RED, GL_FLOAT, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		rippleStream.create(GL_PIXEL_UNPACK_BUFFER, sizeof(float) * RippleSolver::SIZE * RippleSolver::SIZE);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 	}
 
 	~Water()
 	{
+		ShaderHotReload::instance().unwatch(&shaderProgram);
 		glDeleteVertexArrays(1, &waterVAO);
 		glDeleteBuffers(1, &waterVBO);
+		glDeleteTextures(1, &rippleTexture);
 	}
 
-	void update(Camera camera, unsigned int SCR_WIDTH, unsigned int SCR_HEIGHT)
+	///<summary>
+	/// Draws the surface of the waves, the same ones the simulation samples on the CPU.
+	///</summary>
+	void render(const FrameSnapshot& frame, const WaveField& waves)
 	{
+		// nothing to draw with when even the built in shader failed
+		if (shaderProgram.ID == 0)
+			return;
+
 		// ativate shader program
 		shaderProgram.use();
 
-		// pass current time to shader for wave calculations
-		GLfloat time = (float)glfwGetTime();
-		shaderProgram.setFloat("time", time);
-
-		// specify a wavelength of 4
-		GLfloat wavelength = 4.0f;
-		shaderProgram.setFloat("wavelength", wavelength);
+		// pass the simulated time to shader for wave calculations
+		shaderProgram.setFloat("time", frame.WaveTime);
 
-		// set maxmimum wave height at 1
-		GLfloat peak = 1.0f;
-		shaderProgram.setFloat("peak", peak);
+		// wave shape, the shader only uses the sign of the direction
+		shaderProgram.setFloat("wavelength", waves.Wavelength);
+		shaderProgram.setFloat("peak", waves.Peak);
+		shaderProgram.setFloat("waveDir", waves.Direction);
 
-		// set wave direction to be a random float
-		GLfloat waveDir = static_cast <float> (rand()) / (static_cast <float> (255.0f / 0.5f));
-		shaderProgram.setFloat("waveDir", waveDir);
+		// ripples go on top of the waves wherever the grid covers them
+		uploadRipples(frame);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, rippleTexture);
+		shaderProgram.setInt("ripples", 0);
+		shaderProgram.setVec3("rippleArea", frame.RippleOrigin.x, frame.RippleOrigin.y, (frame.RippleExtent > 0.0f) ? frame.RippleExtent : 1.0f);
 
-		// pass projection matrix to shader (note that in this case it could change every frame)
-		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-		shaderProgram.setMat4("projection", projection);
+		// pass projection, camera/view and model matrices to shader
+		shaderProgram.setMat4("projection", frame.Projection);
+		shaderProgram.setMat4("view", frame.View);
+		shaderProgram.setMat4("model", glm::translate(glm::mat4(), glm::vec3(0.0f, waves.Level, 0.0f)));
 
-		// pass camera/view transformation matrix to shader 
-		glm::mat4 view = camera.GetViewMatrix();
-		shaderProgram.setMat4("view", view);
-
-		// pass model matrix to shader 
-		glm::mat4 model = glm::mat4();
-		shaderProgram.setMat4("model", model);
-
-		// Set Render Mode
-		GLenum GL_RENDER_MODE = GL_LINES; // GL_LINES or GL_TRIANGLES
+		// Set Render Mode (the grid is a strip, so wireframe comes from the polygon mode)
+		GLenum GL_POLYGON_RENDER_MODE = GL_LINE; // GL_LINE or GL_FILL
 										  
 		// bind and draw water element buffer
 		glBindVertexArray(waterVAO);
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-		glDrawElements(GL_RENDER_MODE, 3 * grid.Indices.size(), GL_UNSIGNED_INT, 0);
+		glPolygonMode(GL_FRONT_AND_BACK, GL_POLYGON_RENDER_MODE);
+		glDrawElements(grid.Topology, grid.Indices.size(), grid.IndexType(), 0);
 	}
 
 private:
 	Shader shaderProgram;
 
-	GeometryGenerator::MeshData grid;
-	GLuint waterVAO, waterVBO, waterEBO;
-	
-	const char *waveVertexShaderSource = "#version 330 core\n"
-		"layout(location = 0) in vec3 position; \n"
-		"layout(location = 1) in vec3 normal; \n"
-		"layout(location = 2) in vec2 aTexCoord; \n"
-		"out vec2 TexCoord; \n"
-		"const float pi = 3.14159265; \n"
-		"uniform mat4 model; \n"
-		"uniform mat4 view; \n"
-		"uniform mat4 projection; \n"
-		"uniform float waveDir; \n"
-		"uniform float wavelength; \n"
-		"uniform float peak; \n"
-		"uniform float time; \n"
+	// copy of shaders/water.vert, used when the file is not found
+	static constexpr const char* fallbackVertexSource =
+		"#version 330 core\n"
+		"layout(location = 0) in vec3 position;\n"
+		"layout(location = 1) in vec3 normal;\n"
+		"layout(location = 2) in vec2 aTexCoord;\n"
+		"out vec2 TexCoord;\n"
+		"const float pi = 3.14159265;\n"
+		"uniform mat4 model;\n"
+		"uniform mat4 view;\n"
+		"uniform mat4 projection;\n"
+		"uniform float waveDir;\n"
+		"uniform float wavelength;\n"
+		"uniform float peak;\n"
+		"uniform float time;\n"
+		"uniform sampler2D ripples;\n"
+		"uniform vec3 rippleArea;\t// world x, z of the ripple grid's corner and its size\n"
 		"void main()\n"
 		"{\n"
-		"	float a = dot(position.x, normalize(waveDir)); \n"
-		"	float b = peak - 1.0f; \n"
-		"	float k = (2.0f * pi) / wavelength; \n"
-		"	float c = sqrt(9.81f / k); \n"
-		"	float wave_dx = (exp(k * b) / k) * sin(k * (a + c * time)); \n"
-		"	float wave_dy = -(exp(k * b) / k) * cos(k * (a + c * time)); \n"
-		"	gl_Position = projection * view * model * vec4((position.x + wave_dx), (position.y + wave_dy), (position.z), 1.0f); \n"
-		"	TexCoord = vec2(aTexCoord.x, 1.0 - aTexCoord.y); \n"
-		"}\0";
-
-	const char *waveFragmentShaderSource = "#version 330 core \n"
-		"out vec4 FragColor; \n"
-		"uniform sampler2D texture1; \n"
-		"uniform sampler2D texture2; \n"
+		"\tfloat a = dot(position.x, normalize(waveDir));\n"
+		"\tfloat b = peak - 1.0f;\n"
+		"\tfloat k = (2.0f * pi) / wavelength;\n"
+		"\tfloat c = sqrt(9.81f / k);\n"
+		"\tfloat wave_dx = (exp(k * b) / k) * sin(k * (a + c * time));\n"
+		"\tfloat wave_dy = -(exp(k * b) / k) * cos(k * (a + c * time));\n"
+		"\tvec4 displaced = model * vec4((position.x + wave_dx), (position.y + wave_dy), (position.z), 1.0f);\n"
+		"\tvec2 rippleCoord = (displaced.xz - rippleArea.xy) / rippleArea.z;\n"
+		"\tif (all(greaterThanEqual(rippleCoord, vec2(0.0))) && all(lessThanEqual(rippleCoord, vec2(1.0))))\n"
+		"\t\tdisplaced.y += textureLod(ripples, rippleCoord, 0.0).r;\n"
+		"\tgl_Position = projection * view * displaced;\n"
+		"\tTexCoord = vec2(aTexCoord.x, 1.0 - aTexCoord.y);\n"
+		"}\n";
+
+	// copy of shaders/water.frag, used when the file is not found
+	static constexpr const char* fallbackFragmentSource =
+		"#version 330 core\n"
+		"out vec4 FragColor;\n"
+		"uniform sampler2D texture1;\n"
+		"uniform sampler2D texture2;\n"
 		"void main()\n"
 		"{\n"
-		"	FragColor = vec4(0.0, 0.0, 0.8, 0.2); \n"
-		"}\0";
+		"\tFragColor = vec4(0.0, 0.0, 0.8, 0.2);\n"
+		"}\n";
+
+	GeometryGenerator::MeshData grid;
+	GLuint waterVAO, waterVBO, waterEBO;
+
+	GLuint rippleTexture = 0;
+	StreamBuffer rippleStream;
+
+	void uploadRipples(const FrameSnapshot& frame)
+	{
+		if (frame.Ripples.size() != (size_t)RippleSolver::SIZE * RippleSolver::SIZE)
+			return;
+
+		void* mapped = rippleStream.map();
+		if (mapped == nullptr)
+		{
+			// keep the ripples of the last frame
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			return;
+		}
+		memcpy(mapped, frame.Ripples.data(), sizeof(float) * frame.Ripples.size());
+		GLintptr offset = rippleStream.unmap();
+		glBindTexture(GL_TEXTURE_2D, rippleTexture);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, rippleStream.id());
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, RippleSolver::SIZE, RippleSolver::SIZE, GL_RED, GL_FLOAT, (GLvoid*)offset);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		// the upload is the only reader of the region
+		rippleStream.fence();
+	}
 };
 
 #endif	// WATER_H
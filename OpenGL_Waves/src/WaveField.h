@@ -0,0 +1,144 @@
+#pragma once
+
+#ifndef WAVEFIELD_H
+#define WAVEFIELD_H
+
+#include "GL_Util.h"
+
+#include <cmath>
+#include <emmintrin.h>
+
+// CPU copy of the wave in shaders/water.vert, so the simulation can ask where the surface is.
+// The shader moves every grid point at rest position x0 around a circle:
+//
+//     theta = k * (dir * x0 + c * t)
+//     x = x0 + A * sin(theta),  y = -A * cos(theta)
+//
+// with k = 2 pi / wavelength, c = sqrt(g / k) and A = exp(k * (peak - 1)) / k. The surface only
+// varies along x. To find the height above a world x the rest position has to be solved for,
+// with Newton steps on x0 + A * sin(theta) - x. Its slope 1 + A * k * cos(theta) goes to zero at
+// the crest of the steepest wave, so it is clamped, which keeps the steps from overshooting.
+class WaveField
+{
+public:
+	float Wavelength = 4.0f;
+	float Peak = 1.0f;			// 1 is the steepest wave, a cusp at the crest
+	float Direction = 1.0f;		// sign of the direction of travel along x
+	float Gravity = 9.81f;
+	float Level = 0.0f;			// height of the still water
+
+	// Newton steps to find the rest position under a point
+	static const int SOLVE_ITERATIONS = 4;
+	static constexpr float MIN_SLOPE = 0.3f;
+
+	float waveNumber() const { return 2.0f * glm::pi<float>() / Wavelength; }
+	float phaseSpeed() const { return sqrtf(Gravity / waveNumber()); }
+	float amplitude() const { return expf(waveNumber() * (Peak - 1.0f)) / waveNumber(); }
+
+	///<summary>
+	/// Surface height above world x at time t.
+	///</summary>
+	float height(float x, float time) const
+	{
+		float s, c;
+		solve(x, time, s, c);
+		return Level - amplitude() * c;
+	}
+
+	///<summary>
+	/// Surface height and the velocity of the water at the surface above world x, as (x, y).
+	///</summary>
+	float sample(float x, float time, glm::vec2& velocity) const
+	{
+		float s, c;
+		solve(x, time, s, c);
+		float orbit = amplitude() * waveNumber() * phaseSpeed();
+		velocity = glm::vec2(orbit * c, orbit * s);
+		return Level - amplitude() * c;
+	}
+
+	///<summary>
+	/// sample() for four points at once.
+	///</summary>
+	void sample4(__m128 x, float time, __m128& height, __m128& velocityX, __m128& velocityY) const
+	{
+		const float k = waveNumber();
+		const float a = amplitude();
+		const __m128 amp = _mm_set1_ps(a);
+		const __m128 kd = _mm_set1_ps(k * Direction);
+		const __m128 phase = _mm_set1_ps(k * phaseSpeed() * time);
+		const __m128 ampK = _mm_set1_ps(a * k * Direction);
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 minSlope = _mm_set1_ps(MIN_SLOPE);
+
+		__m128 s, c;
+		__m128 x0 = x;
+		for (int i = 0; i < SOLVE_ITERATIONS; ++i)
+		{
+			SinCos4(_mm_add_ps(_mm_mul_ps(kd, x0), phase), s, c);
+			__m128 error = _mm_sub_ps(_mm_add_ps(x0, _mm_mul_ps(amp, s)), x);
+			__m128 slope = _mm_max_ps(_mm_add_ps(one, _mm_mul_ps(ampK, c)), minSlope);
+			x0 = _mm_sub_ps(x0, _mm_div_ps(error, slope));
+		}
+		SinCos4(_mm_add_ps(_mm_mul_ps(kd, x0), phase), s, c);
+
+		const __m128 orbit = _mm_set1_ps(a * k * phaseSpeed());
+		height = _mm_sub_ps(_mm_set1_ps(Level), _mm_mul_ps(amp, c));
+		velocityX = _mm_mul_ps(orbit, c);
+		velocityY = _mm_mul_ps(orbit, s);
+	}
+
+	///<summary>
+	/// Sine and cosine of four angles. Cody-Waite reduction to a quarter turn and the minimax
+	/// polynomials of cephes: about 1e-7 off near zero, and no worse than the float angle itself
+	/// further out.
+	///</summary>
+	static void SinCos4(__m128 x, __m128& sine, __m128& cosine)
+	{
+		// x = q * pi/2 + r with |r| <= pi/4
+		__m128i q = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(0.63661977236f)));
+		__m128 qf = _mm_cvtepi32_ps(q);
+		__m128 r = _mm_sub_ps(x, _mm_mul_ps(qf, _mm_set1_ps(1.5707963705062866f)));
+		r = _mm_sub_ps(r, _mm_mul_ps(qf, _mm_set1_ps(-4.3711390001862426e-8f)));
+		__m128 r2 = _mm_mul_ps(r, r);
+
+		__m128 sr = _mm_add_ps(_mm_set1_ps(8.3321608736e-3f), _mm_mul_ps(r2, _mm_set1_ps(-1.9515295891e-4f)));
+		sr = _mm_add_ps(_mm_set1_ps(-1.6666654611e-1f), _mm_mul_ps(r2, sr));
+		sr = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, r2), sr));
+
+		__m128 cr = _mm_add_ps(_mm_set1_ps(-1.388731625493765e-3f), _mm_mul_ps(r2, _mm_set1_ps(2.443315711809948e-5f)));
+		cr = _mm_add_ps(_mm_set1_ps(4.166664568298827e-2f), _mm_mul_ps(r2, cr));
+		cr = _mm_add_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_set1_ps(0.5f), r2)), _mm_mul_ps(_mm_mul_ps(r2, r2), cr));
+
+		// odd quadrants swap sine and cosine, the sign follows the quadrant
+		__m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(q, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+		__m128 s = _mm_or_ps(_mm_and_ps(swap, cr), _mm_andnot_ps(swap, sr));
+		__m128 c = _mm_or_ps(_mm_and_ps(swap, sr), _mm_andnot_ps(swap, cr));
+		__m128 sineSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(q, _mm_set1_epi32(2)), 30));
+		__m128 cosineSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(q, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30));
+		sine = _mm_xor_ps(s, sineSign);
+		cosine = _mm_xor_ps(c, cosineSign);
+	}
+
+private:
+	// rest position under world x, returned as the sine and cosine of its phase
+	void solve(float x, float time, float& s, float& c) const
+	{
+		const float k = waveNumber();
+		const float a = amplitude();
+		const float phase = k * phaseSpeed() * time;
+
+		float x0 = x;
+		for (int i = 0; i < SOLVE_ITERATIONS; ++i)
+		{
+			float theta = k * Direction * x0 + phase;
+			float slope = glm::max(1.0f + a * k * Direction * cosf(theta), MIN_SLOPE);
+			x0 -= (x0 + a * sinf(theta) - x) / slope;
+		}
+		float theta = k * Direction * x0 + phase;
+		s = sinf(theta);
+		c = cosf(theta);
+	}
+};
+
+#endif // WAVEFIELD_H
@@ -6,6 +6,19 @@
 #include "GL_Util.h"
 #include "Terrain.h"
 #include "Light.h"
+#include "MeshLOD.h"
+#include "ShaderLibrary.h"
+#include "FrameSnapshot.h"
+#include "WaveField.h"
+#include "BuoyancySolver.h"
+#include "SurfaceQuery.h"
+#include "RippleSolver.h"
+#include "Water.h"
+#include "ShallowWaterSolver.h"
+#include "TerrainErosion.h"
+#include "SpatialHashGrid.h"
+
+#include <algorithm>
 
 class World
 {
@@ -16,59 +29,55 @@ public:
 		light.init(lightPos);
 		
 		//Setup shader program
-		Shader::ShaderCode code;
-		code.vertexCode = vertexShaderSource;
-		//code.fragmentCode = fragmentShaderSource;
-		code.fragmentCode = newFragmentShaderSource;
-		shaderProgram = Shader(code);
-
-		//Create grid
-		GeometryGenerator geoGen;
-		//Create cylinder
-		geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, 20, 20, cylinder);
-
-		// Setup water VAO
-		glGenVertexArrays(1, &cylinderVAO);
-		glGenBuffers(1, &cylinderVBO);
-		glGenBuffers(1, &cylinderEBO);
-		glBindVertexArray(cylinderVAO);
-
-		glBindBuffer(GL_ARRAY_BUFFER, cylinderVBO);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(GeometryGenerator::Vertex) * cylinder.Vertices.size(), cylinder.Vertices.data(), GL_STATIC_DRAW);
+		// the single light flat permutation is ready at once, the others compile in the background
+		ShaderLibrary::registerModules();
+		litShaders.init("world", vertexShaderSource, "lit.frag", ShaderLibrary::litFeatures(), ShaderLibrary::litKey(1, false, false));
+		// the lights in range change as the camera moves, every count of them is compiled ahead
+		unsigned int maxLights = glm::min((unsigned int)pointLightPositions.size(), (unsigned int)ShaderLibrary::MAX_POINT_LIGHTS);
+		for (unsigned int lights = 0; lights <= maxLights; lights++)
+			litShaders.prewarm(ShaderLibrary::litKey(lights, false, false));
+
+		// Create pillar and sphere LOD chains (slices x stacks per level)
+		pillarLOD.init("pillar", { 150.0f, 60.0f, 20.0f, 0.0f }, [](unsigned int level, GeometryGenerator::MeshData& mesh)
+		{
+			const unsigned int slices[] = { 20, 12, 8, 5 };
+			const unsigned int stacks[] = { 20, 6, 2, 1 };
+			GeometryGenerator geoGen;
+			geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, slices[level], stacks[level], mesh);
+		}, false);
 
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cylinderEBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * cylinder.Indices.size(), cylinder.Indices.data(), GL_STATIC_DRAW);
+		sphereLOD.init("sphere", { 60.0f, 25.0f, 8.0f, 0.0f }, [](unsigned int level, GeometryGenerator::MeshData& mesh)
+		{
+			const unsigned int slices[] = { 20, 14, 8, 5 };
+			const unsigned int stacks[] = { 20, 10, 6, 4 };
+			GeometryGenerator geoGen;
+			geoGen.CreateSphere(0.5f, slices[level], stacks[level], mesh);
+		}, false);
 
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)0);
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)(6 * sizeof(GLfloat)));
-		glBindVertexArray(0);
+		// a row of buoys across the water, light enough to float half out of it
+		for (unsigned int i = 0; i < FLOATING_BODIES; i++)
+			floats.addBody(glm::vec3(-14.0f + 4.0f * i, waves.Level, 5.0f), 0.5f, 500.0f);
 
-		//Create sphere
-		geoGen.CreateSphere(0.5f, 20, 20, sphere);
+		// everything placed in the scene goes into the grid, the pillar spheres reach up to 4
+		for (unsigned int i = 0; i < 5; i++)
+			scene.insert(glm::vec3(pillarPositions[i].x, 2.0f, pillarPositions[i].z), PILLAR_BOUNDS, LAYER_PILLAR, i);
+		for (unsigned int i = 0; i < pointLightPositions.size(); i++)
+			scene.insert(pointLightPositions[i], 0.0f, LAYER_LIGHT, i);
+		for (size_t i = 0; i < floats.bodyCount(); i++)
+			floatHandles.push_back(scene.insert(floats.position(i), floats.radius(i), LAYER_FLOAT, (unsigned int)i));
 
-		// Setup water VAO
-		glGenVertexArrays(1, &sphereVAO);
-		glGenBuffers(1, &sphereVBO);
-		glGenBuffers(1, &sphereEBO);
-		glBindVertexArray(sphereVAO);
+		surface.setSources(&earth.heightGrid(), &waves);
 
-		glBindBuffer(GL_ARRAY_BUFFER, sphereVBO);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(GeometryGenerator::Vertex) * sphere.Vertices.size(), sphere.Vertices.data(), GL_STATIC_DRAW);
+		// a spring on the highest point of the terrain, its water runs down into the valleys
+		const VertexPacking::HeightGridData& grid = earth.heightGrid();
+		flood.init(grid);
+		size_t peak = std::max_element(grid.Heights.begin(), grid.Heights.end()) - grid.Heights.begin();
+		float cell = grid.Width / (grid.Columns - 1);
+		flood.addSource(-0.5f * grid.Width + cell * (peak % grid.Columns), 0.5f * grid.Depth - cell * (peak / grid.Columns), SPRING_RATE);
 
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphereEBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * sphere.Indices.size(), sphere.Indices.data(), GL_STATIC_DRAW);
-
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)0);
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)(6 * sizeof(GLfloat)));
-		glBindVertexArray(0);
+		// the noise is worn down over the first steps rather than before the first frame
+		erosion.init(grid, (unsigned int)earth.getSeed());
+		erosionBudget = (unsigned long long)(EROSION_DROPLETS_PER_CELL * grid.Heights.size());
 
 		/*
 		
@@ -111,36 +120,206 @@ public:
 
 	~World()
 	{
-		glDeleteVertexArrays(1, &sphereVAO);
-		glDeleteBuffers(1, &sphereVBO);
 	}
 
-	void update(GLFWwindow* window, Camera camera, float deltaTime, unsigned int SCR_WIDTH, unsigned int SCR_HEIGHT)
+	bool streamTerrain(const std::string& tiledPath)
 	{
-		earth.update(window, camera, deltaTime, SCR_WIDTH, SCR_HEIGHT);
-		light.update(window, camera, deltaTime, SCR_WIDTH, SCR_HEIGHT);
+		if (!earth.streamHeightmap(tiledPath))
+			return false;
+		// streamed tiles only live on the GPU, so queries see the water alone and nothing floods
+		surface.setSources(nullptr, &waves);
+		flood = ShallowWaterSolver();
+		erosion = TerrainErosion();
+		return true;
+	}
 
-		// ativate shader program
-		shaderProgram.use();
+	bool exportTerrain(const std::string& tiledPath) const
+	{
+		return earth.exportHeightmap(tiledPath);
+	}
+
+	const WaveField& waveField() const
+	{
+		return waves;
+	}
+
+	// terrain and water heights for whatever moves over them, valid for the current step
+	SurfaceQuery& surfaceQuery()
+	{
+		return surface;
+	}
+
+	///<summary>
+	/// Moves the ripple grid along with the point of view, before the steps of a frame.
+	///</summary>
+	void setFocus(const glm::vec3& position)
+	{
+		ripples.follow(position);
+	}
+
+	///<summary>
+	/// One fixed step of everything that moves on its own, with the waves at simulated time t.
+	///</summary>
+	void step(float time, float stepSeconds)
+	{
+		if (erosion.isReady() && erosion.dropletCount() < erosionBudget)
+		{
+			erosion.step(EROSION_DROPLETS_PER_STEP);
+			earth.setHeights(erosion.heights());
+			flood.setGround(earth.heightGrid());
+			surface.setSources(&earth.heightGrid(), &waves);
+			terrainVersion++;
+		}
+
+		surface.beginStep(time);
+		floats.step(waves, time, stepSeconds);
+		for (size_t i = 0; i < floats.bodyCount(); i++)
+			scene.move(floatHandles[i], floats.position(i));
+
+		// bodies bobbing up and down make rings
+		for (size_t i = 0; i < floats.bodyCount(); i++)
+		{
+			glm::vec3 position = floats.position(i);
+			ripples.disturb(position.x, position.z, floats.radius(i), -RIPPLE_STRENGTH * floats.velocity(i).y * stepSeconds);
+		}
+		ripples.step(stepSeconds);
+		flood.step(stepSeconds);
+	}
+
+	///<summary>
+	/// Ripples behind a sphere that moved from one position to another, if it is in the water.
+	///</summary>
+	void disturbWater(const glm::vec3& from, const glm::vec3& to, float radius)
+	{
+		if (fabsf(to.y - surface.waterHeight(to.x)) > radius)
+			return;
+		glm::vec3 moved = to - from;
+		ripples.disturb(to.x, to.z, radius, RIPPLE_STRENGTH * glm::length(glm::vec2(moved.x, moved.z)));
+	}
+
+	const RippleSolver& rippleSolver() const
+	{
+		return ripples;
+	}
+
+	const ShallowWaterSolver& floodSolver() const
+	{
+		return flood;
+	}
+
+	const TerrainErosion& terrainErosion() const
+	{
+		return erosion;
+	}
+
+	// pillars, lights and floats by position
+	const SpatialHashGrid& sceneGrid() const
+	{
+		return scene;
+	}
+
+	///<summary>
+	/// Simulation phase: writes the lights, transforms and LOD levels of this frame into the
+	/// snapshot. Runs on the job system and must not touch GL.
+	///</summary>
+	void simulate(const Camera& camera, FrameSnapshot& frame) const
+	{
+		frame.LightPosition = lightPos;
+		light.simulate(camera, frame);
+
+		// the lights that reach the camera, nearest first as far as the shader takes them
+		glm::vec3 eye = camera.Position;
+		frame.PointLights.clear();
+		scene.forEachInRadius(eye, LIGHT_RANGE, LAYER_LIGHT, [&](SpatialHashGrid::Handle handle)
+		{
+			frame.PointLights.push_back(scene.position(handle));
+		});
+		std::sort(frame.PointLights.begin(), frame.PointLights.end(), [&](const glm::vec3& a, const glm::vec3& b)
+		{
+			return glm::dot(a - eye, a - eye) < glm::dot(b - eye, b - eye);
+		});
+		if (frame.PointLights.size() > ShaderLibrary::MAX_POINT_LIGHTS)
+			frame.PointLights.resize(ShaderLibrary::MAX_POINT_LIGHTS);
+
+		// pillars within the far plane
+		frame.Pillars.clear();
+		frame.Spheres.clear();
+		scene.forEachInRadius(eye, DRAW_DISTANCE, LAYER_PILLAR, [&](SpatialHashGrid::Handle handle)
+		{
+			// offset each pillar by positions, the spheres sit on top of them
+			unsigned int i = scene.userData(handle);
+			FrameSnapshot::Instance pillar;
+			pillar.Model = glm::translate(glm::mat4(1.0f), pillarPositions[i]);
+			pillar.Level = pillarLOD.selectLevel(pillarPositions[i], camera, frame.ScreenHeight);
+			frame.Pillars.push_back(pillar);
+
+			glm::vec3 spherePosition = glm::vec3(pillarPositions[i].x, 3.5f, pillarPositions[i].z);
+			FrameSnapshot::Instance sphere;
+			sphere.Model = glm::translate(glm::mat4(1.0f), spherePosition);
+			sphere.Level = sphereLOD.selectLevel(spherePosition, camera, frame.ScreenHeight);
+			frame.Spheres.push_back(sphere);
+		});
+
+		const float* rippleHeights = ripples.heights();
+		frame.Ripples.assign(rippleHeights, rippleHeights + RippleSolver::SIZE * RippleSolver::SIZE);
+		frame.RippleOrigin = ripples.origin();
+		frame.RippleExtent = ripples.extent();
+
+		if (frame.TerrainVersion != terrainVersion)
+		{
+			frame.TerrainHeights.assign(earth.heightGrid().Heights.begin(), earth.heightGrid().Heights.end());
+			frame.TerrainRange = glm::vec2(earth.heightGrid().MinHeight, earth.heightGrid().MaxHeight);
+			frame.TerrainVersion = terrainVersion;
+		}
+
+		if (flood.isReady())
+		{
+			// room for the water to stand a few meters over the highest ground
+			const VertexPacking::HeightGridData& grid = earth.heightGrid();
+			frame.FloodRange = glm::vec2(grid.MinHeight - 1.0f, grid.MaxHeight + 4.0f);
+			flood.packSurface(frame.FloodSurface, frame.FloodRange.x, frame.FloodRange.y);
+		}
+		else
+		{
+			frame.FloodSurface.clear();
+		}
 
-		light.setLightingUniforms(&shaderProgram, pointLightPositions, camera);
+		frame.Floats.clear();
+		scene.forEachInRadius(eye, DRAW_DISTANCE, LAYER_FLOAT, [&](SpatialHashGrid::Handle handle)
+		{
+			size_t i = scene.userData(handle);
+			glm::vec3 position = glm::mix(floats.previousPosition(i), floats.position(i), frame.Interpolation);
+			FrameSnapshot::Instance body;
+			body.Model = glm::translate(glm::mat4(1.0f), position);
+			body.Level = sphereLOD.selectLevel(position, camera, frame.ScreenHeight);
+			frame.Floats.push_back(body);
+		});
+	}
 
-		// pass projection matrix to shader (note that in this case it could change every frame)
-		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-		shaderProgram.setMat4("projection", projection);
+	///<summary>
+	/// Render phase: issues the GL calls for a snapshot written by simulate().
+	///</summary>
+	void render(const FrameSnapshot& frame)
+	{
+		earth.render(frame);
+		water.render(frame, waves);
+		light.render(frame);
+
+		// ativate shader program
+		Shader& shaderProgram = litShaders.get(ShaderLibrary::litKey((unsigned int)frame.PointLights.size(), false, false));
+		shaderProgram.use();
 
-		// pass camera/view transformation matrix to shader 
-		glm::mat4 view = camera.GetViewMatrix();
-		shaderProgram.setMat4("view", view);
+		light.setLightingUniforms(shaderProgram, frame);
 
-		// pass model matrix to shader 
-		glm::mat4 model = glm::mat4();
-		shaderProgram.setMat4("model", model);
+		// pass projection, camera/view and model matrices to shader
+		shaderProgram.setMat4("projection", frame.Projection);
+		shaderProgram.setMat4("view", frame.View);
+		shaderProgram.setMat4("model", glm::mat4());
 
 		//shaderProgram.setVec3("objectColor", 1.0f, 0.5f, 0.31f);
 		shaderProgram.setVec3("lightColor", 1.0f, 1.0f, 1.0f);
-		shaderProgram.setVec3("lightPos", lightPos);
-		shaderProgram.setVec3("viewPos", camera.Position);
+		shaderProgram.setVec3("lightPos", frame.LightPosition);
+		shaderProgram.setVec3("viewPos", frame.CameraPosition);
 
 		// Set Render Mode
 		GLenum GL_RENDER_MODE = GL_LINES; // GL_LINES or GL_TRIANGLES		
@@ -149,36 +328,30 @@ public:
 		glm::vec3 blue = glm::vec3(0.5, 0.5, 1);
 		shaderProgram.setVec3("objectColor", blue);
 
-		// bind and draw cylinder element buffer
-		glBindVertexArray(cylinderVAO);
-		
-		// offset each pillar by positions
-		for (unsigned int i = 0; i < 5; i++)
+		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		for (size_t i = 0; i < frame.Pillars.size(); i++)
 		{
-			// calculate the model matrix for each object and pass it to shader before drawing
-			model = glm::mat4(1.0f);
-			model = glm::translate(model, pillarPositions[i]);
-			shaderProgram.setMat4("model", model);
-
-			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-			glDrawElements(GL_RENDER_MODE, cylinder.Indices.size(), GL_UNSIGNED_INT, 0);
+			// bind and draw the cylinder level matching its size on screen
+			shaderProgram.setMat4("model", frame.Pillars[i].Model);
+			pillarLOD.draw(frame.Pillars[i].Level, GL_RENDER_MODE);
 		}
 
 		glm::vec3 red = glm::vec3(1, 0.5, 0.5);
 		shaderProgram.setVec3("objectColor", red);
 
-		// bind and draw sphere element buffer
-		glBindVertexArray(sphereVAO);
-
-		for (unsigned int i = 0; i < 5; i++)
+		for (size_t i = 0; i < frame.Spheres.size(); i++)
 		{
-			// calculate the model matrix for each object and pass it to shader before drawing
-			model = glm::mat4(1.0f);
-			model = glm::translate(model, glm::vec3(pillarPositions[i].x, 3.5f, pillarPositions[i].z));
-			shaderProgram.setMat4("model", model);
+			shaderProgram.setMat4("model", frame.Spheres[i].Model);
+			sphereLOD.draw(frame.Spheres[i].Level, GL_RENDER_MODE);
+		}
+
+		glm::vec3 orange = glm::vec3(1, 0.7, 0.3);
+		shaderProgram.setVec3("objectColor", orange);
 
-			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-			glDrawElements(GL_RENDER_MODE, cylinder.Indices.size(), GL_UNSIGNED_INT, 0);
+		for (size_t i = 0; i < frame.Floats.size(); i++)
+		{
+			shaderProgram.setMat4("model", frame.Floats[i].Model);
+			sphereLOD.draw(frame.Floats[i].Level, GL_RENDER_MODE);
 		}
 	}
 
@@ -186,13 +359,41 @@ private:
 	Terrain earth;
 	Light light;
 
-	Shader shaderProgram;
-
-	GeometryGenerator::MeshData cylinder;
-	GLuint cylinderVAO, cylinderVBO, cylinderEBO;
-
-	GeometryGenerator::MeshData sphere;
-	GLuint sphereVAO, sphereVBO, sphereEBO;
+	ShaderPermutations litShaders;
+
+	MeshLOD pillarLOD;
+	MeshLOD sphereLOD;
+
+	// the water surface, on the CPU, and what floats on it
+	static const unsigned int FLOATING_BODIES = 8;
+	WaveField waves;
+	BuoyancySolver floats;
+	SurfaceQuery surface;
+	RippleSolver ripples;
+	Water water;
+	const float RIPPLE_STRENGTH = 0.05f;	// ripple depth per unit of movement through the water
+	ShallowWaterSolver flood;				// rivers over the terrain
+	const float SPRING_RATE = 2.0f;			// m^3/s
+
+	// erosion of the generated terrain, a batch of droplets a step until the budget is spent
+	TerrainErosion erosion;
+	unsigned long long erosionBudget = 0;
+	unsigned int terrainVersion = 0;
+	const float EROSION_DROPLETS_PER_CELL = 2.0f;
+	const unsigned int EROSION_DROPLETS_PER_STEP = 256;
+
+	// scene objects by position
+	enum SceneLayer
+	{
+		LAYER_PILLAR = 1 << 0,
+		LAYER_LIGHT = 1 << 1,
+		LAYER_FLOAT = 1 << 2
+	};
+	SpatialHashGrid scene{16.0f};	// cells of about a sixth of the light and draw queries, 7 x 7 to 13 x 13 cells each
+	std::vector<SpatialHashGrid::Handle> floatHandles;
+	const float PILLAR_BOUNDS = 2.1f;		// sphere around a pillar and the ball on it
+	const float LIGHT_RANGE = 50.0f;		// past this the point light attenuation is under 1.5%
+	const float DRAW_DISTANCE = 100.0f;		// far plane of FrameSnapshot::setCamera
 
 	// lighting
 	glm::vec3 lightPos = glm::vec3(1.2f, 1.0f, 2.0f);
@@ -226,7 +427,7 @@ private:
 		glBufferData(GL_ARRAY_BUFFER, sizeof(GeometryGenerator::Vertex) * mesh.Vertices.size(), mesh.Vertices.data(), GL_STATIC_DRAW);
 
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * mesh.Indices.size(), mesh.Indices.data(), GL_STATIC_DRAW);
+		mesh.UploadIndices();
 
 		glEnableVertexAttribArray(0);
 		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)0);
@@ -283,254 +484,6 @@ private:
 		"	vec3 result = (ambient + diffuse + specular) * objectColor; \n"
 		"	FragColor = vec4(result, 1.0); \n"
 		"}\n\0";
-
-	const char *newFragmentShaderSource = "#version 330 core\n"
-		"out vec4 FragColor;\n"
-
-		"struct Material {\n"
-		"	sampler2D diffuse;\n"
-		"	sampler2D specular;\n"
-		"	float shininess;\n"
-		"};\n"
-
-		"struct DirLight {\n"
-		"	vec3 direction;\n"
-
-		"	vec3 ambient;\n"
-		"	vec3 diffuse;\n"
-		"	vec3 specular;\n"
-		"};\n"
-
-		"struct PointLight {\n"
-		"	vec3 position;\n"
-
-		"	float constant;\n"
-		"	float linear;\n"
-		"	float quadratic;\n"
-
-		"	vec3 ambient;\n"
-		"	vec3 diffuse;\n"
-		"	vec3 specular;\n"
-		"};\n"
-
-		"#define NR_POINT_LIGHTS 3\n"
-
-		"in vec3 FragPos;\n"
-		"in vec3 Normal;\n"
-		"in vec2 TexCoords;\n"
-
-		"uniform vec3 objectColor;\n"
-
-		"uniform vec3 viewPos;\n"
-		"uniform DirLight dirLight;\n"
-		"uniform PointLight pointLights[NR_POINT_LIGHTS];\n"
-		"uniform Material material;\n"
-
-		"// function prototypes\n"
-		"vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);\n"
-		"vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);\n"
-
-		"void main()\n"
-		"{\n"
-		"	// properties\n"
-		"	vec3 norm = normalize(Normal);\n"
-		"	vec3 viewDir = normalize(viewPos - FragPos);\n"
-
-		"	// phase 1: directional lighting\n"
-		"	vec3 result = CalcDirLight(dirLight, norm, viewDir);\n"
-
-		"	// phase 2: point lights\n"
-		"	for (int i = 0; i < NR_POINT_LIGHTS; i++)\n"
-		"		result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);\n"
-
-		"	FragColor = vec4(result, 1.0);\n"
-		"}\n"
-
-		"// calculates the color when using a directional light.\n"
-		"vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)\n"
-		"{\n"
-		"	vec3 lightDir = normalize(-light.direction);\n"
-		"	// diffuse shading\n"
-		"	float diff = max(dot(normal, lightDir), 0.0);\n"
-		"	// specular shading\n"
-		"	vec3 reflectDir = reflect(-lightDir, normal);\n"
-		"	float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);\n"
-		"	// combine results\n"
-		"	vec3 ambient = light.ambient * objectColor;\n"
-		"	vec3 diffuse = light.diffuse * diff * objectColor;\n"
-		"	vec3 specular = light.specular * spec * objectColor;\n"
-		"	return (ambient + diffuse + specular);\n"
-		"}\n"
-
-		"// calculates the color when using a point light.\n"
-		"vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)\n"
-		"{\n"
-		"	vec3 lightDir = normalize(light.position - fragPos);\n"
-		"	// diffuse shading\n"
-		"	float diff = max(dot(normal, lightDir), 0.0); \n"
-		"	// specular shading\n"
-		"	vec3 reflectDir = reflect(-lightDir, normal); \n"
-		"	float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess); \n"
-		"	// attenuation\n"
-		"	float distance = length(light.position - fragPos); \n"
-		"	float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance)); \n"
-		"	// combine results\n"
-		"	vec3 ambient = light.ambient * objectColor; \n"
-		"	vec3 diffuse = light.diffuse * diff * objectColor; \n"
-		"	vec3 specular = light.specular * spec * objectColor;\n"
-		"	ambient *= attenuation; \n"
-		"	diffuse *= attenuation; \n"
-		"	specular *= attenuation; \n"
-		"	return (ambient + diffuse + specular); \n"
-		"}\n\0";
-
-	const char *texFragmentShaderSource = "#version 330 core\n"
-		"out vec4 FragColor;\n"
-
-		"struct Material {\n"
-		"	sampler2D diffuse;\n"
-		"	sampler2D specular;\n"
-		"	float shininess;\n"
-		"};\n"
-
-		"struct DirLight {\n"
-		"	vec3 direction;\n"
-
-		"	vec3 ambient;\n"
-		"	vec3 diffuse;\n"
-		"	vec3 specular;\n"
-		"};\n"
-
-		"struct PointLight {\n"
-		"	vec3 position;\n"
-
-		"	float constant;\n"
-		"	float linear;\n"
-		"	float quadratic;\n"
-
-		"	vec3 ambient;\n"
-		"	vec3 diffuse;\n"
-		"	vec3 specular;\n"
-		"};\n"
-
-		"struct SpotLight {\n"
-		"	vec3 position;\n"
-		"	vec3 direction;\n"
-		"	float cutOff;\n"
-		"	float outerCutOff;\n"
-
-		"	float constant;\n"
-		"	float linear;\n"
-		"	float quadratic;\n"
-
-		"	vec3 ambient;\n"
-		"	vec3 diffuse;\n"
-		"	vec3 specular;\n"
-		"};\n"
-
-		"#define NR_POINT_LIGHTS 4\n"
-
-		"in vec3 FragPos;\n"
-		"in vec3 Normal;\n"
-		"in vec2 TexCoords;\n"
-
-		"uniform vec3 viewPos;\n"
-		"uniform DirLight dirLight;\n"
-		"uniform PointLight pointLights[NR_POINT_LIGHTS];\n"
-		"uniform SpotLight spotLight;\n"
-		"uniform Material material;\n"
-
-		"// function prototypes\n"
-		"vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);\n"
-		"vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);\n"
-		"vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);\n"
-
-		"void main()\n"
-		"{\n"
-		"	// properties\n"
-		"	vec3 norm = normalize(Normal);\n"
-		"	vec3 viewDir = normalize(viewPos - FragPos);\n"
-
-		"	// == =====================================================\n"
-		"	// Our lighting is set up in 3 phases: directional, point lights and an optional flashlight\n"
-		"	// For each phase, a calculate function is defined that calculates the corresponding color\n"
-		"	// per lamp. In the main() function we take all the calculated colors and sum them up for\n"
-		"	// this fragment's final color.\n"
-		"	// == =====================================================\n"
-		"	// phase 1: directional lighting\n"
-		"	vec3 result = CalcDirLight(dirLight, norm, viewDir);\n"
-		"	// phase 2: point lights\n"
-		"	for (int i = 0; i < NR_POINT_LIGHTS; i++)\n"
-		"		result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);\n"
-		"	// phase 3: spot light\n"
-		"	result += CalcSpotLight(spotLight, norm, FragPos, viewDir);\n"
-
-		"	FragColor = vec4(result, 1.0);\n"
-		"}\n"
-
-		"// calculates the color when using a directional light.\n"
-		"vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)\n"
-		"{\n"
-		"	vec3 lightDir = normalize(-light.direction);\n"
-		"	// diffuse shading\n"
-		"	float diff = max(dot(normal, lightDir), 0.0);\n"
-		"	// specular shading\n"
-		"	vec3 reflectDir = reflect(-lightDir, normal);\n"
-		"	float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);\n"
-		"	// combine results\n"
-		"	vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));\n"
-		"	vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));\n"
-		"	vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));\n"
-		"	return (ambient + diffuse + specular);\n"
-		"}\n"
-
-		"// calculates the color when using a point light.\n"
-		"vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)\n"
-		"{\n"
-		"	vec3 lightDir = normalize(light.position - fragPos);\n"
-		"	// diffuse shading\n"
-		"	float diff = max(dot(normal, lightDir), 0.0); \n"
-		"	// specular shading\n"
-		"	vec3 reflectDir = reflect(-lightDir, normal); \n"
-		"	float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess); \n"
-		"	// attenuation\n"
-		"	float distance = length(light.position - fragPos); \n"
-		"	float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance)); \n"
-		"	// combine results\n"
-		"	vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords)); \n"
-		"	vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords)); \n"
-		"	vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));\n"
-		"	ambient *= attenuation; \n"
-		"	diffuse *= attenuation; \n"
-		"	specular *= attenuation; \n"
-		"	return (ambient + diffuse + specular); \n"
-		"}\n"
-
-		"// calculates the color when using a spot light.\n"
-		"vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)\n"
-		"{\n"
-		"	vec3 lightDir = normalize(light.position - fragPos);\n"
-		"	// diffuse shading\n"
-		"	float diff = max(dot(normal, lightDir), 0.0);\n"
-		"	// specular shading\n"
-		"	vec3 reflectDir = reflect(-lightDir, normal);\n"
-		"	float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);\n"
-		"	// attenuation\n"
-		"	float distance = length(light.position - fragPos);\n"
-		"	float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));\n"
-		"	// spotlight intensity\n"
-		"	float theta = dot(lightDir, normalize(-light.direction));\n"
-		"	float epsilon = light.cutOff - light.outerCutOff;\n"
-		"	float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);\n"
-		"	// combine results\n"
-		"	vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));\n"
-		"	vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));\n"
-		"	vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));\n"
-		"	ambient *= attenuation * intensity;\n"
-		"	diffuse *= attenuation * intensity;\n"
-		"	specular *= attenuation * intensity;\n"
-		"	return (ambient + diffuse + specular);\n"
-		"}\n\0";
 };
 
 #endif	// WORLD_H
@@ -12,15 +12,51 @@
 #include "World.h"
 #include "Player.h"
 #include "LightingHandler.h"
+#include "TextureLoader.h"
+#include "AssetPack.h"
+#include "Heightmap.h"
+#include "JobSystem.h"
+#include "FrameSnapshot.h"
+#include "SimClock.h"
+#include "AllocationCounter.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <set>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow *window);
+int runJobBenchmark(int gridSize);
+int runBuoyancyBenchmark(int bodies);
+int runRippleBenchmark();
+int runFloodBenchmark(int gridSize);
+int runErosionBenchmark(int gridSize);
+int runSpatialBenchmark(int entities);
+bool checkSpatialQueries();
+int runPackingTest();
+int runMeshOptimizerTest();
 
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
+const char* SHADER_WARMUP_LIST = "shadercache/warmup.txt";
+const double TEXTURE_UPLOAD_BUDGET_MS = 2.0;
+const char* ASSET_PACK = "assets.pack";
+const unsigned int ASSET_CONTENT_VERSION = 1;	// bump when generated assets change
+const float HEIGHTMAP_SPACING = 1.0f;			// world units between imported samples
+const float HEIGHTMAP_SCALE = 40.0f;			// world height of a full scale 16-bit sample
+const int JOB_BENCHMARK_GRID = 1024;			// vertices per side of the --bench-jobs terrain
+const int BUOYANCY_BENCHMARK_BODIES = 65536;	// floating bodies in --bench-buoyancy
+const int FLOOD_BENCHMARK_GRID = 512;			// vertices per side of the --bench-flood terrain
+const int EROSION_BENCHMARK_GRID = 512;			// vertices per side of the --bench-erosion terrain
+const int SPATIAL_BENCHMARK_ENTITIES = 131072;	// spheres in --bench-spatial
+const double SIM_STEP = 1.0 / 60.0;				// fixed simulation step in seconds
+const unsigned int SIM_MAX_STEPS = 5;			// steps per frame before the clock drops time
+const unsigned long long ALLOCATION_WARMUP_FRAMES = 120;	// frames before heap allocations are counted
 
 // camera
 Camera camera(glm::vec3(0.0f, 1.0f, 3.0f));
@@ -29,13 +65,106 @@ float lastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
 
 // timing
-float deltaTime = 0.0f;	// time between current frame and last frame
+float deltaTime = 0.0f;	// time between current frame and last frame, moves the camera
 float lastFrame = 0.0f;
+SimClock simClock(SIM_STEP, SIM_MAX_STEPS);	// drives everything that is simulated
 
 static Player player;
+static TextureLoader textureLoader;
 
-int main(void)
+int main(int argc, char** argv)
 {
+	// --cold-shaders ignores the program binary cache and --cold-assets the asset pack, to measure a cold start
+	// --heightmap <tiles> streams the terrain from a tiled heightmap, --save-terrain <tiles> writes the generated one
+	// --import-heightmap <png|r16|r32> <tiles> [width height] and --export-heightmap <tiles> <r16|r32> convert and exit
+	// --bench-jobs [grid] times terrain generation on 1 to N job system threads and exits
+	// --bench-buoyancy [bodies] times the buoyancy solver the same way and exits
+	// --bench-ripples times steps of the ripple grid the same way and exits
+	// --bench-flood [grid] times the shallow water solver for a river and for a flood of the whole grid and exits
+	// --bench-erosion [grid] reports the droplets per second of terrain erosion the same way and exits
+	// --bench-spatial [entities] times rebuilding, moving and querying the spatial hash grid and exits
+	// --test-packing packs and unpacks the generated meshes, checks the error of every attribute and exits
+	// --test-mesh-optimizer welds and reorders the generated meshes, checks the triangles, vertex counts and ACMR and exits
+	// --lockstep runs exactly one simulation step per frame, so runs can be compared
+	// --frames <n> closes the window after n frames, with the heap allocations per frame printed at exit,
+	//   and fails if a frame after the warm-up allocated
+	bool coldShaders = false;
+	bool coldAssets = false;
+	unsigned long long frameLimit = 0;
+	std::string heightmapPath, saveTerrainPath;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--cold-shaders")
+			coldShaders = true;
+		else if (arg == "--cold-assets")
+			coldAssets = true;
+		else if (arg == "--lockstep")
+			simClock.setLockstep(true);
+		else if (arg == "--frames" && i + 1 < argc)
+			frameLimit = strtoull(argv[++i], nullptr, 10);
+		else if (arg == "--heightmap" && i + 1 < argc)
+			heightmapPath = argv[++i];
+		else if (arg == "--save-terrain" && i + 1 < argc)
+			saveTerrainPath = argv[++i];
+		else if (arg == "--import-heightmap" && i + 2 < argc)
+		{
+			std::string input = argv[i + 1], output = argv[i + 2];
+			Heightmap::RawFormat format;
+			bool ok;
+			if (i + 4 < argc && Heightmap::FormatFromPath(input, format))
+				ok = Heightmap::ImportRaw(input, atoi(argv[i + 3]), atoi(argv[i + 4]), format, output, HEIGHTMAP_SPACING, HEIGHTMAP_SCALE);
+			else
+				ok = Heightmap::ImportPNG(input, output, HEIGHTMAP_SPACING, HEIGHTMAP_SCALE);
+			return ok ? 0 : -1;
+		}
+		else if (arg == "--export-heightmap" && i + 2 < argc)
+		{
+			Heightmap::RawFormat format;
+			if (!Heightmap::FormatFromPath(argv[i + 2], format))
+			{
+				std::cout << "ERROR::HEIGHTMAP::UNKNOWN_FORMAT " << argv[i + 2] << std::endl;
+				return -1;
+			}
+			return Heightmap::ExportRaw(argv[i + 1], argv[i + 2], format) ? 0 : -1;
+		}
+		else if (arg == "--bench-buoyancy")
+		{
+			return runBuoyancyBenchmark((i + 1 < argc) ? atoi(argv[i + 1]) : BUOYANCY_BENCHMARK_BODIES);
+		}
+		else if (arg == "--bench-ripples")
+		{
+			return runRippleBenchmark();
+		}
+		else if (arg == "--bench-flood")
+		{
+			return runFloodBenchmark((i + 1 < argc) ? atoi(argv[i + 1]) : FLOOD_BENCHMARK_GRID);
+		}
+		else if (arg == "--bench-erosion")
+		{
+			return runErosionBenchmark((i + 1 < argc) ? atoi(argv[i + 1]) : EROSION_BENCHMARK_GRID);
+		}
+		else if (arg == "--bench-spatial")
+		{
+			return runSpatialBenchmark((i + 1 < argc) ? atoi(argv[i + 1]) : SPATIAL_BENCHMARK_ENTITIES);
+		}
+		else if (arg == "--test-packing")
+		{
+			return runPackingTest();
+		}
+		else if (arg == "--test-mesh-optimizer")
+		{
+			return runMeshOptimizerTest();
+		}
+		else if (arg == "--bench-jobs")
+		{
+			return runJobBenchmark((i + 1 < argc) ? atoi(argv[i + 1]) : JOB_BENCHMARK_GRID);
+		}
+	}
+
+	// one worker per core besides this thread, which joins in whenever it waits on a job
+	JobSystem::instance().init();
+
 	GLFWwindow* window;
 
 	// Initialize the library
@@ -72,45 +201,776 @@ int main(void)
 		std::cout << "Failed to initialize GLAD" << std::endl;
 		return -1;
 	}
+	LoadGLExtensions((GLADloadproc)glfwGetProcAddress);
 
 	// configure global opengl state
 	glEnable(GL_DEPTH_TEST);
+	// grids are drawn as strips split by the maximum index value
+	glEnable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+
+	// generated meshes, terrain and processed textures of the last run, rebuilt on a miss
+	AssetPack::instance().open(ASSET_PACK, ASSET_CONTENT_VERSION);
+	AssetPack::instance().setReadEnabled(!coldAssets);
+
+	// shader permutations used by the last run are compiled at load time, new ones in the background
+	ShaderPermutations::loadWarmupList(SHADER_WARMUP_LIST);
+	ShaderCompileThread::instance().start(window);
+	textureLoader.init();
 
 	// Create world objects
+	ShaderCache::instance().setReadEnabled(!coldShaders);
+	double startupBegin = glfwGetTime();
+
+	// every program is submitted before the first status query so the driver can compile them in parallel
+	ShaderBatch shaderBatch;
+	shaderBatch.begin();
+
 	World world;
 	player.init();
 
+	// shader files are only watched once every shader of the world and the player is loaded
+	ShaderHotReload::instance().start();
+
+	shaderBatch.finish();
+
+	if (!saveTerrainPath.empty())
+		world.exportTerrain(saveTerrainPath);
+	if (!heightmapPath.empty())
+		world.streamTerrain(heightmapPath);
+	glFinish();
+	std::cout << "STARTUP::" << ((coldShaders || coldAssets) ? "COLD" : "WARM") << " " << (glfwGetTime() - startupBegin) * 1000.0 << " ms, shader cache hits "
+		<< ShaderCache::instance().getHits() << " misses " << ShaderCache::instance().getMisses() << ", asset pack hits "
+		<< AssetPack::instance().getHits() << " misses " << AssetPack::instance().getMisses() << std::endl;
+
+	// The frame is split in two phases. Simulation runs the fixed steps that are due and writes a
+	// FrameSnapshot on the job system while the main thread renders the previous one, so frames
+	// are drawn one frame behind the input.
+	FrameSnapshots snapshots;
+	auto simulate = [&world](FrameSnapshot& frame, const Camera& view, float dt, unsigned int steps, double firstStepTime, float alpha, float waveTime, unsigned long long number)
+	{
+		world.setFocus(view.Position);
+		for (unsigned int i = 0; i < steps; ++i)
+		{
+			world.step((float)(firstStepTime + i * SIM_STEP), (float)SIM_STEP);
+			player.step((float)SIM_STEP, world.surfaceQuery());
+			world.disturbWater(player.lastPosition(), player.position(), player.radius());
+		}
+
+		frame.Arena.reset();
+		frame.Frame = number;
+		frame.DeltaTime = dt;
+		frame.WaveTime = waveTime;
+		frame.Interpolation = alpha;
+		frame.setCamera(view, SCR_WIDTH, SCR_HEIGHT);
+		world.simulate(view, frame);
+		player.simulate(view, frame);
+	};
+	unsigned long long frameNumber = 0;
+	lastFrame = (float)glfwGetTime();
+	simClock.reset(glfwGetTime());
+	simulate(snapshots.write(), camera, 0.0f, 0, 0.0, 1.0f, 0.0f, frameNumber++);
+	snapshots.publish();
+
+	// the simulation job reads its input from here; capturing it by reference keeps the job
+	// small enough for std::function to store without a heap allocation
+	struct SimulationInput
+	{
+		FrameSnapshot* Target;
+		Camera View;
+		float DeltaTime;
+		unsigned int Steps;
+		double FirstStepTime;
+		float Alpha;
+		float WaveTime;
+		unsigned long long Number;
+	} input;
+
+	// heap allocations of the frames after the warm-up, the first frames fill caches and pools
+	unsigned long long allocationsBefore = 0;
+	unsigned long long countedFrames = 0, countedAllocations = 0, worstFrameAllocations = 0;
+
 	// Loop until the user closes the window
 	while (!glfwWindowShouldClose(window))
 	{
+		unsigned long long frameAllocations = AllocationCounter::allocations() - allocationsBefore;
+		allocationsBefore = AllocationCounter::allocations();
+		if (frameNumber > ALLOCATION_WARMUP_FRAMES)
+		{
+			countedFrames++;
+			countedAllocations += frameAllocations;
+			worstFrameAllocations = glm::max(worstFrameAllocations, frameAllocations);
+		}
+		if (frameLimit != 0 && frameNumber > frameLimit)
+			glfwSetWindowShouldClose(window, true);
+
 		processInput(window);
+
+		// swap in shaders rebuilt since the last frame and upload a slice of the decoded textures
+		ShaderHotReload::instance().update();
+		textureLoader.update(TEXTURE_UPLOAD_BUDGET_MS);
 		
 		float currentFrame = glfwGetTime();
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
+		unsigned int steps = simClock.advance(glfwGetTime());
+
+		// the job gets its own copy of the camera, input and callbacks keep changing the original
+		JobSystem::Counter simulation;
+		input.Target = &snapshots.write();
+		input.View = camera;
+		input.DeltaTime = deltaTime;
+		input.Steps = steps;
+		input.FirstStepTime = simClock.time() - steps * SIM_STEP;
+		input.Alpha = simClock.alpha();
+		input.WaveTime = (float)simClock.interpolatedTime();
+		input.Number = frameNumber++;
+		JobSystem::instance().run([&simulate, &input]()
+		{
+			simulate(*input.Target, input.View, input.DeltaTime, input.Steps, input.FirstStepTime, input.Alpha, input.WaveTime, input.Number);
+		}, &simulation);
 
 		// Clear the colorbuffer
 		glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		// update water every frame...
-		world.update(window, camera, deltaTime, SCR_WIDTH, SCR_HEIGHT);
-		player.update(window, camera, deltaTime, SCR_WIDTH, SCR_HEIGHT);
+		// draw the frame simulated during the last iteration
+		const FrameSnapshot& frame = snapshots.read();
+		world.render(frame);
+		player.render(frame);
 
 		// Swap front and back buffers
 		glfwSwapBuffers(window);
 
+		// the simulation must be done before the input of the next frame changes the player
+		JobSystem::instance().wait(simulation);
+		snapshots.publish();
+
 		// Poll for and process events
 		glfwPollEvents();
 	}
 
+	std::cout << "SIM_CLOCK::" << simClock.steps() << " steps of " << SIM_STEP * 1000.0 << " ms, "
+		<< simClock.droppedSeconds() * 1000.0 << " ms dropped by the catch-up cap" << std::endl;
+	std::cout << "RIPPLES::" << RippleSolver::SIZE << "x" << RippleSolver::SIZE << " average step " << world.rippleSolver().averageStepMs() << " ms" << std::endl;
+	std::cout << "FLOOD::" << world.floodSolver().activeTileCount() << " of " << world.floodSolver().tileCount() << " tiles active, "
+		<< world.floodSolver().totalVolume() << " m^3 of water" << std::endl;
+	std::cout << "EROSION::" << world.terrainErosion().dropletCount() << " droplets" << std::endl;
+	std::cout << "SURFACE_QUERY::cache hits " << world.surfaceQuery().hits() << " misses " << world.surfaceQuery().misses() << std::endl;
+	if (countedFrames > 0)
+		std::cout << "FRAME_ALLOCATIONS::" << (double)countedAllocations / countedFrames << " per frame over " << countedFrames
+			<< " frames, worst frame " << worstFrameAllocations << ", arena peak " << snapshots.read().Arena.peakBytes() << " bytes" << std::endl;
+
+	// a steady state frame must not touch the heap, so a timed run fails when one did
+	int result = 0;
+	if (frameLimit != 0 && countedAllocations > 0)
+	{
+		std::cout << "ERROR::FRAME_ALLOCATIONS::STEADY_STATE_FRAMES_ALLOCATED " << countedAllocations << std::endl;
+		result = -1;
+	}
+
 	// delete array and element buffers when finished with them
+	textureLoader.shutdown();
+	AssetPack::instance().save();
+	ShaderHotReload::instance().stop();
+	ShaderCompileThread::instance().stop();
+	ShaderPermutations::saveWarmupList(SHADER_WARMUP_LIST);
+	JobSystem::instance().shutdown();
 
 	glfwTerminate();
+	return result;
+}
+
+// 1, 2, 4 ... and all hardware threads, the thread counts every benchmark is run with
+std::vector<unsigned int> benchmarkThreadCounts()
+{
+	unsigned int maxThreads = glm::max(1u, std::thread::hardware_concurrency());
+	std::vector<unsigned int> threadCounts;
+	for (unsigned int threads = 1; threads < maxThreads; threads *= 2)
+		threadCounts.push_back(threads);
+	threadCounts.push_back(maxThreads);
+	return threadCounts;
+}
+
+// Calls run(index, threads) for each of benchmarkThreadCounts() with the job system running on
+// that many threads, this one included, and shuts it down after the last. A single thread
+// leaves it stopped so jobs run inline, init(0) would start one worker per core instead.
+template<typename Run>
+void forEachThreadCount(Run run)
+{
+	std::vector<unsigned int> threadCounts = benchmarkThreadCounts();
+	for (size_t t = 0; t < threadCounts.size(); ++t)
+	{
+		if (threadCounts[t] > 1)
+			JobSystem::instance().init(threadCounts[t] - 1);
+		else
+			JobSystem::instance().shutdown();
+		run(t, threadCounts[t]);
+	}
+	JobSystem::instance().shutdown();
+}
+
+// Terrain generation on a gridSize x gridSize grid with 1, 2, 4 ... and all hardware threads.
+// Every run is the best of a few so thread start up and a cold cache do not count.
+int runJobBenchmark(int gridSize)
+{
+	const int REPEATS = 3;
+	if (gridSize < 2)
+		gridSize = JOB_BENCHMARK_GRID;
+
+	GeometryGenerator::MeshData grid;
+	GeometryGenerator geoGen;
+	geoGen.CreateGrid((float)gridSize, (float)gridSize, gridSize, gridSize, grid, true);
+
+	double baseline = 0.0;
+	forEachThreadCount([&](size_t t, unsigned int threads)
+	{
+		double best = 0.0;
+		for (int r = 0; r < REPEATS; ++r)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			Terrain::GenerateTerrain(12345, grid);
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			if (r == 0 || ms < best)
+				best = ms;
+		}
+		if (t == 0)
+			baseline = best;
+
+		std::cout << "JOB_BENCHMARK::terrain " << gridSize << "x" << gridSize << " threads " << threads << ": "
+			<< best << " ms, speedup " << baseline / best << "x" << std::endl;
+	});
+	return 0;
+}
+
+
+// Buoyancy solver steps over a field of bodies with 1, 2, 4 ... and all hardware threads,
+// reported as bodies simulated per millisecond.
+int runBuoyancyBenchmark(int bodies)
+{
+	const int STEPS = 120;
+	const int REPEATS = 3;
+	if (bodies < 1)
+		bodies = BUOYANCY_BENCHMARK_BODIES;
+
+	// a square of bodies with mixed sizes and densities, dropped from just above the surface
+	WaveField waves;
+	BuoyancySolver solver;
+	int side = (int)ceilf(sqrtf((float)bodies));
+	for (int i = 0; i < bodies; ++i)
+	{
+		glm::vec3 position(-0.5f * side + (i % side), 0.5f, -0.5f * side + (i / side));
+		solver.addBody(position, 0.3f + 0.1f * (i % 5), 300.0f + 100.0f * (i % 7));
+	}
+
+	double time = 0.0;
+	forEachThreadCount([&](size_t, unsigned int threads)
+	{
+		double best = 0.0;
+		for (int r = 0; r < REPEATS; ++r)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for (int s = 0; s < STEPS; ++s, time += SIM_STEP)
+				solver.step(waves, (float)time, (float)SIM_STEP);
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			if (r == 0 || ms < best)
+				best = ms;
+		}
+
+		std::cout << "BUOYANCY_BENCHMARK::" << bodies << " bodies x " << BuoyancySolver::HULL_POINTS << " hull points, threads " << threads
+			<< ": " << best / STEPS << " ms per step, " << (double)bodies * STEPS / best << " bodies/ms" << std::endl;
+	});
+	return 0;
+}
+
+
+// Ripple grid steps with 1, 2, 4 ... and all hardware threads, with a ring of disturbances
+// kept going so the whole grid is busy.
+int runRippleBenchmark()
+{
+	const int STEPS = 600;
+
+	forEachThreadCount([&](size_t, unsigned int threads)
+	{
+		RippleSolver ripples;
+		for (int s = 0; s < STEPS; ++s)
+		{
+			float angle = s * 0.1f;
+			ripples.disturb(10.0f * cosf(angle), 10.0f * sinf(angle), 0.5f, 0.05f);
+			ripples.step((float)SIM_STEP);
+		}
+
+		std::cout << "RIPPLE_BENCHMARK::" << RippleSolver::SIZE << "x" << RippleSolver::SIZE << " threads " << threads << ": "
+			<< ripples.averageStepMs() << " ms per step" << std::endl;
+	});
 	return 0;
 }
 
 
+// Shallow water steps over a generated gridSize x gridSize terrain with 1, 2, 4 ... and all
+// hardware threads: once for a single spring, where only the tiles along the river are
+// active, and once with springs all over the grid, where every tile is.
+int runFloodBenchmark(int gridSize)
+{
+	const int STEPS = 300;
+	const int FLOOD_SPACING = 8;	// cells between the springs of the flood
+	if (gridSize < 2)
+		gridSize = FLOOD_BENCHMARK_GRID;
+
+	GeometryGenerator::MeshData grid;
+	GeometryGenerator geoGen;
+	geoGen.CreateGrid((float)gridSize, (float)gridSize, gridSize, gridSize, grid, true);
+	Terrain::GenerateTerrain(12345, grid);
+	VertexPacking::HeightGridData heights;
+	VertexPacking::PackHeightGrid(grid, gridSize, gridSize, (float)gridSize, (float)gridSize, heights);
+
+	const char* scenarios[] = { "river", "flood" };
+	for (int scenario = 0; scenario < 2; ++scenario)
+	{
+		forEachThreadCount([&](size_t, unsigned int threads)
+		{
+			ShallowWaterSolver water;
+			water.init(heights);
+			if (scenario == 0)
+			{
+				water.addSource(0.0f, 0.0f, 2.0f);
+			}
+			else
+			{
+				for (int z = 0; z < gridSize; z += FLOOD_SPACING)
+					for (int x = 0; x < gridSize; x += FLOOD_SPACING)
+						water.addSource(x - 0.5f * gridSize, 0.5f * gridSize - z, 2.0f);
+			}
+
+			size_t activeTiles = 0;
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for (int s = 0; s < STEPS; ++s)
+			{
+				water.step((float)SIM_STEP);
+				activeTiles += water.activeTileCount();
+			}
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+			std::cout << "FLOOD_BENCHMARK::" << scenarios[scenario] << " " << gridSize << "x" << gridSize << " threads " << threads << ": "
+				<< ms / STEPS << " ms per step, " << activeTiles / STEPS << " of " << water.tileCount() << " tiles active" << std::endl;
+		});
+	}
+	return 0;
+}
+
+
+// Erosion steps over a generated gridSize x gridSize terrain with 1, 2, 4 ... and all hardware
+// threads, a droplet per 16 cells a step, reported as droplets per second. Every thread count
+// starts from the same terrain.
+int runErosionBenchmark(int gridSize)
+{
+	const int STEPS = 60;
+	const int CELLS_PER_DROPLET = 16;
+	if (gridSize < 2)
+		gridSize = EROSION_BENCHMARK_GRID;
+
+	GeometryGenerator::MeshData grid;
+	GeometryGenerator geoGen;
+	geoGen.CreateGrid((float)gridSize, (float)gridSize, gridSize, gridSize, grid, true);
+	Terrain::GenerateTerrain(12345, grid);
+	VertexPacking::HeightGridData heights;
+	VertexPacking::PackHeightGrid(grid, gridSize, gridSize, (float)gridSize, (float)gridSize, heights);
+
+	unsigned int dropletsPerStep = (unsigned int)(gridSize * gridSize / CELLS_PER_DROPLET);
+	double baseline = 0.0;
+	forEachThreadCount([&](size_t t, unsigned int threads)
+	{
+		TerrainErosion erosion;
+		erosion.init(heights, 12345);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int s = 0; s < STEPS; ++s)
+			erosion.step(dropletsPerStep);
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		double rate = erosion.dropletCount() / seconds;
+		if (t == 0)
+			baseline = rate;
+
+		std::cout << "EROSION_BENCHMARK::" << gridSize << "x" << gridSize << " threads " << threads << ": "
+			<< rate << " droplets/s, " << seconds * 1000.0 / STEPS << " ms per step with the thermal pass, speedup " << rate / baseline << "x" << std::endl;
+	});
+	return 0;
+}
+
+
+// Radius and box queries of a grid of SPATIAL_CHECK_ENTITIES entities, inserted, moved and
+// partly removed, against testing every entity. Query sizes go from a fraction of a cell to
+// most of the square, so both the per cell walk and the walk over all buckets are covered.
+bool checkSpatialQueries()
+{
+	const int SPATIAL_CHECK_ENTITIES = 20000;
+	const int CHECK_QUERIES = 2000;
+
+	unsigned int random = 54321u;
+	auto nextRandom = [&random]()
+	{
+		random = random * 1664525u + 1013904223u;
+		return (random >> 8) * (1.0f / 16777216.0f);
+	};
+
+	float side = 2.0f * sqrtf((float)SPATIAL_CHECK_ENTITIES);
+	SpatialHashGrid grid(4.0f, 1024);
+	std::vector<glm::vec3> positions(SPATIAL_CHECK_ENTITIES);
+	std::vector<float> radii(SPATIAL_CHECK_ENTITIES);
+	std::vector<unsigned int> layers(SPATIAL_CHECK_ENTITIES);
+	std::vector<SpatialHashGrid::Handle> handles(SPATIAL_CHECK_ENTITIES);
+	std::vector<bool> alive(SPATIAL_CHECK_ENTITIES, true);
+	for (int i = 0; i < SPATIAL_CHECK_ENTITIES; ++i)
+	{
+		positions[i] = glm::vec3((nextRandom() - 0.5f) * side, nextRandom() * 4.0f, (nextRandom() - 0.5f) * side);
+		radii[i] = (i % 100 == 0) ? 8.0f * nextRandom() : nextRandom();
+		layers[i] = 1u << (i % 3);
+		handles[i] = grid.insert(positions[i], radii[i], layers[i], (unsigned int)i);
+	}
+	for (int i = 0; i < SPATIAL_CHECK_ENTITIES; ++i)
+	{
+		if (i % 7 == 0)
+		{
+			grid.remove(handles[i]);
+			alive[i] = false;
+		}
+		else if (i % 2 == 0)
+		{
+			positions[i] += glm::vec3((nextRandom() - 0.5f) * 20.0f, 0.0f, (nextRandom() - 0.5f) * 20.0f);
+			grid.move(handles[i], positions[i]);
+		}
+	}
+
+	size_t mismatches = 0;
+	std::vector<SpatialHashGrid::Handle> found;
+	std::vector<unsigned int> foundUsers, expected;
+	for (int q = 0; q < CHECK_QUERIES; ++q)
+	{
+		glm::vec3 center((nextRandom() - 0.5f) * side, 2.0f, (nextRandom() - 0.5f) * side);
+		float size = (q % 10 == 0) ? nextRandom() * side : nextRandom() * 8.0f;
+		unsigned int queryLayers = (q % 4 == 0) ? SpatialHashGrid::ALL_LAYERS : 1u << (q % 3);
+		bool box = (q % 2) == 1;
+		glm::vec3 boxMin = center - glm::vec3(size, 1.0f, size), boxMax = center + glm::vec3(size, 1.0f, size);
+
+		found.clear();
+		if (box)
+			grid.queryBox(boxMin, boxMax, queryLayers, found);
+		else
+			grid.queryRadius(center, size, queryLayers, found);
+		foundUsers.clear();
+		for (size_t f = 0; f < found.size(); ++f)
+			foundUsers.push_back(grid.userData(found[f]));
+
+		expected.clear();
+		for (int i = 0; i < SPATIAL_CHECK_ENTITIES; ++i)
+		{
+			if (!alive[i] || !(layers[i] & queryLayers))
+				continue;
+			glm::vec3 offset = box ? positions[i] - glm::clamp(positions[i], boxMin, boxMax) : positions[i] - center;
+			float reach = box ? radii[i] : size + radii[i];
+			if (glm::dot(offset, offset) <= reach * reach)
+				expected.push_back((unsigned int)i);
+		}
+
+		std::sort(foundUsers.begin(), foundUsers.end());
+		if (foundUsers != expected)
+		{
+			if (mismatches == 0)
+				std::cout << "ERROR::SPATIAL::QUERY_MISMATCH " << (box ? "box" : "radius") << " of " << size << " m found " << foundUsers.size()
+					<< ", brute force " << expected.size() << std::endl;
+			mismatches++;
+		}
+	}
+
+	std::cout << "SPATIAL_BENCHMARK::check " << CHECK_QUERIES << " queries over " << SPATIAL_CHECK_ENTITIES << " entities against brute force: "
+		<< mismatches << " mismatches" << std::endl;
+	return mismatches == 0;
+}
+
+
+// Spatial hash grid over a square of entities, about one per 4 m^2: a parallel rebuild with 1,
+// 2, 4 ... and all hardware threads, then moving every entity and radius queries, which run
+// on this thread alone. Before the timings the queries are checked against a brute force
+// scan, and the benchmark fails if they disagree.
+int runSpatialBenchmark(int entities)
+{
+	const int REPEATS = 3;
+	const int QUERIES = 100000;
+	const float QUERY_RADIUS = 4.0f;
+	if (entities < 1)
+		entities = SPATIAL_BENCHMARK_ENTITIES;
+
+	if (!checkSpatialQueries())
+		return -1;
+
+	// a fixed scatter of spheres of 0.25 to 1 m
+	float side = 2.0f * sqrtf((float)entities);
+	std::vector<glm::vec3> positions(entities);
+	std::vector<float> radii(entities);
+	unsigned int random = 12345u;
+	auto nextRandom = [&random]()
+	{
+		random = random * 1664525u + 1013904223u;
+		return (random >> 8) * (1.0f / 16777216.0f);
+	};
+	for (int i = 0; i < entities; ++i)
+	{
+		positions[i] = glm::vec3((nextRandom() - 0.5f) * side, nextRandom() * 4.0f, (nextRandom() - 0.5f) * side);
+		radii[i] = 0.25f + 0.75f * nextRandom();
+	}
+
+	SpatialHashGrid grid(4.0f, (unsigned int)entities);
+	forEachThreadCount([&](size_t, unsigned int threads)
+	{
+		double best = 0.0;
+		for (int r = 0; r < REPEATS; ++r)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			grid.rebuild(positions.data(), radii.data(), entities);
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			if (r == 0 || ms < best)
+				best = ms;
+		}
+
+		std::cout << "SPATIAL_BENCHMARK::rebuild " << entities << " entities threads " << threads << ": " << best << " ms" << std::endl;
+	});
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < entities; ++i)
+		grid.move((SpatialHashGrid::Handle)i, positions[i] + glm::vec3(nextRandom() - 0.5f, 0.0f, nextRandom() - 0.5f));
+	double moveMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	size_t found = 0;
+	start = std::chrono::steady_clock::now();
+	for (int q = 0; q < QUERIES; ++q)
+	{
+		glm::vec3 center((nextRandom() - 0.5f) * side, 2.0f, (nextRandom() - 0.5f) * side);
+		grid.forEachInRadius(center, QUERY_RADIUS, SpatialHashGrid::ALL_LAYERS, [&found](SpatialHashGrid::Handle) { found++; });
+	}
+	double queryMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << "SPATIAL_BENCHMARK::move " << entities << " entities: " << moveMs << " ms, " << entities / moveMs << " moves/ms" << std::endl;
+	std::cout << "SPATIAL_BENCHMARK::" << QUERIES << " queries of " << QUERY_RADIUS << " m: " << queryMs * 1000.0 / QUERIES << " us per query, "
+		<< (double)found / QUERIES << " found per query" << std::endl;
+	return 0;
+}
+
+
+// Packs every generated primitive with both position encodings and the terrain as a height
+// grid, unpacks them again and checks each attribute against what its encoding can hold:
+//  half float positions	- half a unit in the last place, 2^-11 relative
+//  UNORM16 positions		- half a step of the mesh bounds over 65535
+//  octahedral normals		- within PACKING_NORMAL_ERROR of the unit normal
+//  texture coordinates		- half a step of 1 / 65535 from the clamped input
+// Prints the worst error of each and returns non-zero if any bound is broken.
+int runPackingTest()
+{
+	const float PACKING_NORMAL_ERROR = 1e-4f;
+	const float SLACK = 1e-6f;	// float rounding of the decode itself, relative and absolute
+
+	struct NamedMesh
+	{
+		const char* Name;
+		GeometryGenerator::MeshData Mesh;
+	};
+	std::vector<NamedMesh> meshes(6);
+	GeometryGenerator geoGen;
+	meshes[0].Name = "box";
+	geoGen.CreateBox(2.0f, 3.0f, 4.0f, meshes[0].Mesh);
+	meshes[1].Name = "sphere";
+	geoGen.CreateSphere(0.5f, 20, 20, meshes[1].Mesh);
+	meshes[2].Name = "geosphere";
+	geoGen.CreateGeosphere(0.5f, 3, meshes[2].Mesh);
+	meshes[3].Name = "cylinder";
+	geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, 20, 20, meshes[3].Mesh);
+	meshes[4].Name = "water";
+	geoGen.CreateGrid(50.0f, 50.0f, 300, 200, meshes[4].Mesh, true);
+	meshes[5].Name = "terrain";
+	geoGen.CreateGrid(100.0f, 100.0f, 100, 100, meshes[5].Mesh, true);
+	Terrain::GenerateTerrain(12345, meshes[5].Mesh);
+
+	bool ok = true;
+	const char* encodings[] = { "half", "unorm16" };
+	for (size_t m = 0; m < meshes.size(); ++m)
+	{
+		const GeometryGenerator::MeshData& mesh = meshes[m].Mesh;
+		for (int e = 0; e < 2; ++e)
+		{
+			VertexPacking::PackedMeshData packed;
+			VertexPacking::PackMesh(mesh, (e == 0) ? VertexPacking::POSITION_HALF : VertexPacking::POSITION_UNORM16, packed);
+
+			float positionError = 0.0f, normalError = 0.0f, texCError = 0.0f;
+			size_t failures = 0;
+			for (size_t i = 0; i < mesh.Vertices.size(); ++i)
+			{
+				const GeometryGenerator::Vertex& v = mesh.Vertices[i];
+				GeometryGenerator::Vertex u = VertexPacking::UnpackVertex(packed.Vertices[i], packed);
+
+				glm::vec3 positionBound = (e == 0) ? glm::abs(v.Position) * (1.0f / 2048.0f) : packed.PositionScale * (0.5f / 65535.0f);
+				glm::vec3 positionDelta = glm::abs(u.Position - v.Position);
+				float normalDelta = glm::length(u.Normal - glm::normalize(v.Normal));
+				glm::vec2 texCDelta = glm::abs(u.TexC - glm::clamp(v.TexC, 0.0f, 1.0f));
+
+				positionError = glm::max(positionError, glm::max(positionDelta.x, glm::max(positionDelta.y, positionDelta.z)));
+				normalError = glm::max(normalError, normalDelta);
+				texCError = glm::max(texCError, glm::max(texCDelta.x, texCDelta.y));
+
+				if (glm::any(glm::greaterThan(positionDelta, positionBound + (glm::abs(v.Position) + 1.0f) * SLACK)) || normalDelta > PACKING_NORMAL_ERROR
+					|| glm::any(glm::greaterThan(texCDelta, glm::vec2(0.5f / 65535.0f + SLACK))))
+				{
+					if (failures == 0)
+						std::cout << "ERROR::PACKING::" << meshes[m].Name << " " << encodings[e] << " vertex " << i << " out of bounds" << std::endl;
+					failures++;
+				}
+			}
+			ok = ok && failures == 0;
+
+			std::cout << "PACKING::" << meshes[m].Name << " " << encodings[e] << " " << mesh.Vertices.size() << " vertices: position "
+				<< positionError << ", normal " << normalError << ", texture coordinate " << texCError << ", " << failures << " out of bounds" << std::endl;
+		}
+	}
+
+	// the terrain once more as heights only, positions rebuilt from the vertex index
+	VertexPacking::HeightGridData heights;
+	VertexPacking::PackHeightGrid(meshes[5].Mesh, 100, 100, 100.0f, 100.0f, heights);
+	float heightBound = (heights.MaxHeight - heights.MinHeight) * (0.5f / 65535.0f) + SLACK;
+	float heightError = 0.0f;
+	size_t failures = 0;
+	for (size_t i = 0; i < meshes[5].Mesh.Vertices.size(); ++i)
+	{
+		glm::vec3 delta = glm::abs(VertexPacking::UnpackHeightGridPosition(heights, (int)i) - meshes[5].Mesh.Vertices[i].Position);
+		heightError = glm::max(heightError, delta.y);
+		if (delta.y > heightBound || delta.x > 1e-4f || delta.z > 1e-4f)
+		{
+			if (failures == 0)
+				std::cout << "ERROR::PACKING::terrain height grid vertex " << i << " out of bounds" << std::endl;
+			failures++;
+		}
+	}
+	ok = ok && failures == 0;
+	std::cout << "PACKING::terrain height grid " << heights.Heights.size() << " vertices: height " << heightError << ", "
+		<< failures << " out of bounds" << std::endl;
+
+	std::cout << (ok ? "PACKING::PASSED" : "ERROR::PACKING::FAILED") << std::endl;
+	return ok ? 0 : -1;
+}
+
+// Runs the mesh optimizer over every generated primitive and over a sphere with one vertex per
+// index (nothing shared, so welding has to rebuild the indexed mesh) and checks:
+//  triangles		- the same multiset of triangles with the same winding after welding and after the full pass
+//  welding			- exactly the distinct vertices are left, counted by brute force
+//  vertex fetch	- exactly the distinct referenced vertices are left after the full pass
+//  Tipsify			- the ACMR of the welded mesh does not get worse
+// Returns non-zero if any check fails.
+int runMeshOptimizerTest()
+{
+	typedef std::array<float, 8> VertexValue;
+	typedef std::array<float, 24> TriangleValue;
+
+	// float compare, so -0.0 and 0.0 are the same vertex as in WeldVertices
+	auto vertexValue = [](const GeometryGenerator::Vertex& v)
+	{
+		VertexValue value = { { v.Position.x, v.Position.y, v.Position.z, v.Normal.x, v.Normal.y, v.Normal.z, v.TexC.x, v.TexC.y } };
+		return value;
+	};
+
+	// triangles by value, each rotated to start at its smallest vertex so the winding is kept
+	auto triangles = [&vertexValue](const GeometryGenerator::MeshData& mesh)
+	{
+		std::vector<TriangleValue> result(mesh.Indices.size() / 3);
+		for (size_t t = 0; t < result.size(); ++t)
+		{
+			VertexValue corners[3];
+			for (int c = 0; c < 3; ++c)
+				corners[c] = vertexValue(mesh.Vertices[mesh.Indices[t * 3 + c]]);
+
+			int first = 0;
+			for (int c = 1; c < 3; ++c)
+			{
+				if (corners[c] < corners[first])
+					first = c;
+			}
+			for (int c = 0; c < 3; ++c)
+				std::copy(corners[(first + c) % 3].begin(), corners[(first + c) % 3].end(), result[t].begin() + c * 8);
+		}
+		std::sort(result.begin(), result.end());
+		return result;
+	};
+
+	struct NamedMesh
+	{
+		const char* Name;
+		GeometryGenerator::MeshData Mesh;
+	};
+	std::vector<NamedMesh> meshes(6);
+	GeometryGenerator geoGen;
+	meshes[0].Name = "box";
+	geoGen.CreateBox(2.0f, 3.0f, 4.0f, meshes[0].Mesh);
+	meshes[1].Name = "sphere";
+	geoGen.CreateSphere(0.5f, 20, 20, meshes[1].Mesh);
+	meshes[2].Name = "geosphere";
+	geoGen.CreateGeosphere(0.5f, 3, meshes[2].Mesh);
+	meshes[3].Name = "cylinder";
+	geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, 20, 20, meshes[3].Mesh);
+	meshes[4].Name = "grid";
+	geoGen.CreateGrid(50.0f, 50.0f, 60, 40, meshes[4].Mesh);
+	meshes[5].Name = "unindexed sphere";
+	meshes[5].Mesh.Topology = meshes[1].Mesh.Topology;
+	for (size_t i = 0; i < meshes[1].Mesh.Indices.size(); ++i)
+	{
+		meshes[5].Mesh.Vertices.push_back(meshes[1].Mesh.Vertices[meshes[1].Mesh.Indices[i]]);
+		meshes[5].Mesh.Indices.push_back((GLuint)i);
+	}
+
+	MeshOptimizer meshOptimizer;
+	bool ok = true;
+	for (size_t m = 0; m < meshes.size(); ++m)
+	{
+		const GeometryGenerator::MeshData& mesh = meshes[m].Mesh;
+		std::string name = meshes[m].Name;
+		std::vector<TriangleValue> expectedTriangles = triangles(mesh);
+
+		std::set<VertexValue> distinct, referenced;
+		for (size_t i = 0; i < mesh.Vertices.size(); ++i)
+			distinct.insert(vertexValue(mesh.Vertices[i]));
+		for (size_t i = 0; i < mesh.Indices.size(); ++i)
+			referenced.insert(vertexValue(mesh.Vertices[mesh.Indices[i]]));
+
+		bool meshOk = true;
+		auto check = [&meshOk, &name](bool condition, const char* what)
+		{
+			if (!condition && meshOk)
+				std::cout << "ERROR::MESH_OPTIMIZER::" << name << " " << what << std::endl;
+			meshOk = meshOk && condition;
+		};
+
+		GeometryGenerator::MeshData welded = mesh;
+		size_t removed = meshOptimizer.WeldVertices(welded);
+		check(welded.Vertices.size() == distinct.size() && removed == mesh.Vertices.size() - distinct.size(), "weld left duplicate or merged distinct vertices");
+		check(triangles(welded) == expectedTriangles, "weld changed the triangles");
+
+		std::vector<unsigned int> clusters;
+		MeshOptimizer::CacheStats beforeTipsify = meshOptimizer.AnalyzeVertexCache(welded);
+		meshOptimizer.OptimizeVertexCache(welded, clusters);
+		MeshOptimizer::CacheStats afterTipsify = meshOptimizer.AnalyzeVertexCache(welded);
+		check(afterTipsify.ACMR <= beforeTipsify.ACMR, "Tipsify made the ACMR worse");
+		check(triangles(welded) == expectedTriangles, "Tipsify changed the triangles");
+
+		GeometryGenerator::MeshData optimized = mesh;
+		MeshOptimizer::Report report;
+		meshOptimizer.Optimize(optimized, &report);
+		check(optimized.Vertices.size() == referenced.size(), "full pass left duplicate or unreferenced vertices");
+		check(triangles(optimized) == expectedTriangles, "full pass changed the triangles");
+
+		ok = ok && meshOk;
+		std::cout << "MESH_OPTIMIZER::" << name << " vertices " << mesh.Vertices.size() << " -> welded " << welded.Vertices.size() << " (" << distinct.size()
+			<< " distinct) -> " << optimized.Vertices.size() << " (" << referenced.size() << " referenced), Tipsify ACMR " << beforeTipsify.ACMR
+			<< " -> " << afterTipsify.ACMR << ", " << expectedTriangles.size() << " triangles " << (meshOk ? "preserved" : "FAILED") << std::endl;
+	}
+
+	std::cout << (ok ? "MESH_OPTIMIZER::PASSED" : "ERROR::MESH_OPTIMIZER::FAILED") << std::endl;
+	return ok ? 0 : -1;
+}
+
+
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 // ---------------------------------------------------------------------------------------------------------
 void processInput(GLFWwindow *window)
@@ -139,14 +999,8 @@ void processInput(GLFWwindow *window)
 		//player.doMovement(player.RIGHT, deltaTime);
 	}
 
-	if (glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS)
-		player.doMovement(player.FORWARD, deltaTime);
-	if (glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS)
-		player.doMovement(player.BACKWARD, deltaTime);
-	if (glfwGetKey(window, GLFW_KEY_J) == GLFW_PRESS)
-		player.doMovement(player.LEFT, deltaTime);
-	if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS)
-		player.doMovement(player.RIGHT, deltaTime);
+	// the player moves in the fixed simulation steps, only the held keys are read here
+	player.processInput(window);
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes